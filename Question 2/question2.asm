@@ -1,8 +1,15 @@
-; question2.asm - Assembly program to count lines in sensor_log.txt
+; question2.asm - Assembly program to count lines in a sensor log
 ; Compliation and execution: (using NASM and LD on Linux)
 ;   nasm -f elf64 question2.asm -o question2.o
 ;   ld question2.o -o question2
-;   ./question2
+;   ./question2 [log_file]        (default: sensor_log.txt)
+;
+; The log is streamed through a 256 KiB buffer, so files of any size are counted
+; in full. The counting itself lives in line_count.inc: besides every line, the
+; program counts the readings that are not blank. To count many logs at once,
+; across every core, see question2_scan.asm.
+
+%include "line_count.inc"
 
 section .data
     ; Constants for system calls
@@ -20,160 +27,112 @@ section .data
     STDOUT      equ 1
     STDERR      equ 2
 
-    ; Filename for sensor data
-    filename db "sensor_log.txt", 0
-    filename_len equ $ - filename
-
-    ; Message to display the total count
-    msg db "Total sensor readings: ", 0
-    msg_len equ $ - msg
+    ; Bytes read per sys_read, a whole number of blocks
+    BUFFER_SIZE equ 256 * 1024
 
-    ; Buffer to store file contents (increased size)
-    file_buffer_size equ 4096
-    file_buffer resb file_buffer_size
+    ; Filename used when none is given on the command line
+    default_filename db "sensor_log.txt", 0
 
-    ; Buffer for converting number to string
-    num_buffer resb 20
+    ; Messages to display the counts
+    msg db "Total sensor readings: "
+    msg_len equ $ - msg
+    readings_msg db "Non-empty sensor readings: "
+    readings_msg_len equ $ - readings_msg
+
+    ; Error messages
+    open_error_msg db "Error: cannot open the sensor log", 0xA
+    open_error_msg_len equ $ - open_error_msg
+    read_error_msg db "Error: cannot read the sensor log", 0xA
+    read_error_msg_len equ $ - read_error_msg
+
+section .bss
+    ; Buffer to stream the file through, with room to pad the last block
+    alignb 64
+    file_buffer resb BUFFER_SIZE + BLOCK_SIZE
+
+    ; Buffer for converting a number to a string and its newline
+    num_buffer resb 24
     num_buffer_len equ $ - num_buffer
 
 section .text
     global _start
 
 _start:
-    ; --- File Handling: Open sensor_log.txt ---
+    ; --- Choose the Log File ---
+    ; On entry [rsp] = argc and [rsp + 8] = argv[0], [rsp + 16] = argv[1], ...
+    ; Use argv[1] if given, else sensor_log.txt
+    lea rdi, [rel default_filename]
+    cmp qword [rsp], 2
+    jb open_file
+    mov rdi, [rsp + 16]
+
+open_file:
+    ; --- File Handling: Open the log ---
     ; rax = SYS_OPEN (2)
-    ; rdi = filename (pointer to "sensor_log.txt")
+    ; rdi = filename
     ; rsi = O_RDONLY (0)
     mov rax, SYS_OPEN
-    mov rdi, filename
     mov rsi, O_RDONLY
     syscall
     mov r12, rax          ; Store file descriptor in r12
 
     ; Check for file open error (fd < 0)
     cmp r12, 0
-    jl exit_error         ; If fd is negative, an error occurred
+    jl open_error         ; If fd is negative, an error occurred
+
+    call select_kernel
+    call line_count_start
 
-    ; --- Load File Contents into Memory ---
+read_loop:
+    ; --- Load the Next Chunk of the File ---
     ; rax = SYS_READ (0)
     ; rdi = file_descriptor (r12)
-    ; rsi = file_buffer (address of buffer)
-    ; rdx = file_buffer_size (max bytes to read)
+    ; rsi = file_buffer, after the bytes carried over
+    ; rdx = room left in the buffer
     mov rax, SYS_READ
-    mov rdi, r12          ; file descriptor
-    mov rsi, file_buffer  ; buffer to read into
-    mov rdx, file_buffer_size ; max bytes to read
+    mov rdi, r12
+    lea rsi, [rel file_buffer]
+    add rsi, rbp
+    mov rdx, BUFFER_SIZE
+    sub rdx, rbp
     syscall
-    mov r13, rax          ; Store bytes_read in r13
 
-    ; Check for read error (bytes_read < 0)
-    cmp r13, 0
-    jl exit_error         ; If bytes_read is negative, an error occurred
+    ; Check for read error (bytes_read < 0) or end of file (bytes_read = 0)
+    cmp rax, 0
+    jl read_error
+    je end_of_file
 
-    ; --- File Handling: Close sensor_log.txt ---
+    ; --- Count Every Whole Block in the Buffer ---
+    lea rsi, [rel file_buffer]
+    call line_count_buffer
+    jmp read_loop
+
+end_of_file:
+    ; Count the leftover bytes and a last line without a newline
+    lea rsi, [rel file_buffer]
+    call line_count_finish
+
+close_file:
+    ; --- File Handling: Close the log ---
     ; rax = SYS_CLOSE (3)
     ; rdi = file_descriptor (r12)
     mov rax, SYS_CLOSE
     mov rdi, r12
     syscall
 
-    ; --- String Traversal and Line Counting Logic ---
-    ; Initialize line_count = 0
-    ; rbx will hold the line count
-    xor rbx, rbx          ; rbx = 0
-    
-    ; Pointer to current position in buffer
-    ; rsi will serve as our buffer pointer
-    mov rsi, file_buffer
-
-    ; Loop through the buffer until bytes_read (r13) are processed
-    ; rcx will be our loop counter (current byte index)
-    xor rcx, rcx          ; rcx = 0
-
-count_loop:
-    cmp rcx, r13          ; Compare current index with total bytes read
-    jae end_count_loop    ; If rcx >= r13, we've processed all bytes
-
-    ; Check if current character is a newline (0xA)
-    mov al, byte [rsi + rcx]
-    cmp al, 0xA
-    jne next_char
-
-    ; If it's a newline, increment line_count
-    inc rbx
-
-next_char:
-    inc rcx               ; Move to the next character
-    jmp count_loop        ; Continue loop
-
-end_count_loop:
-    ; If the file is not empty and the last character is NOT a newline,
-    ; we need to count the last line.
-    cmp r13, 0            ; Check if file was empty
-    je display_count      ; If empty, no need for extra check
-
-    ; Check the last character of the buffer
-    mov al, byte [rsi + r13 - 1] ; rsi is file_buffer, r13 is bytes_read
-    cmp al, 0xA
-    je display_count      ; If last char is newline, all lines counted
-
-    ; If last char is not newline and file is not empty, increment count for last line
-    inc rbx
-
 display_count:
-    ; --- Convert Count to String and Display ---
-    ; Convert rbx (line_count) to ASCII string in num_buffer
-    ; r8 will be a pointer to the end of num_buffer for writing digits backwards
-    mov r8, num_buffer + num_buffer_len - 1 ; Point to end of num_buffer
-    mov byte [r8], 0        ; Null-terminate the string
-    mov rax, rbx            ; Move line_count to rax for division
-    mov r9, 10              ; Divisor (10)
-
-    cmp rax, 0              ; Handle case where count is 0
-    jne convert_loop_start
-    dec r8                  ; Move pointer back for '0'
-    mov byte [r8], '0'      ; Place '0' in buffer
-    jmp print_result
-
-convert_loop_start:
-    xor rdx, rdx            ; Clear rdx for division
-    div r9                  ; rax = rax / 10, rdx = rax % 10
-    add dl, '0'             ; Convert remainder to ASCII digit
-    dec r8                  ; Move pointer back
-    mov byte [r8], dl       ; Store digit
-    cmp rax, 0              ; Check if quotient is 0
-    jne convert_loop_start  ; Continue if quotient is not 0
-
-print_result:
-    ; --- Display "Total sensor readings: " ---
-    ; rax = SYS_WRITE (1)
-    ; rdi = STDOUT (1)
-    ; rsi = msg (pointer to message string)
-    ; rdx = msg_len
-    mov rax, SYS_WRITE
-    mov rdi, STDOUT
-    mov rsi, msg
+    ; --- Display "Total sensor readings: <lines>" ---
+    lea rsi, [rel msg]
     mov rdx, msg_len
-    syscall
-
-    ; --- Display the converted count (number_string) ---
-    ; rax = SYS_WRITE (1)
-    ; rdi = STDOUT (1)
-    ; rsi = r8 (pointer to the start of the number string)
-    ; rdx = length of the number string
-    mov rax, SYS_WRITE
-    mov rdi, STDOUT
-    mov rsi, r8             ; Start of number string
-    mov rdx, num_buffer + num_buffer_len - 1 ; End of num_buffer
-    sub rdx, r8             ; Calculate length
-    syscall
+    mov rax, r13
+    call print_count
 
-    ; --- Display a newline character ---
-    mov rax, SYS_WRITE
-    mov rdi, STDOUT
-    mov rsi, newline_char
-    mov rdx, 1
-    syscall
+    ; --- Display "Non-empty sensor readings: <lines that are not blank>" ---
+    lea rsi, [rel readings_msg]
+    mov rdx, readings_msg_len
+    mov rax, r13
+    sub rax, r14
+    call print_count
 
     ; --- Program Termination (Exit Success) ---
     ; rax = SYS_EXIT (60)
@@ -182,13 +141,59 @@ print_result:
     xor rdi, rdi
     syscall
 
+open_error:
+    lea rsi, [rel open_error_msg]
+    mov rdx, open_error_msg_len
+    jmp exit_error
+
+read_error:
+    lea rsi, [rel read_error_msg]
+    mov rdx, read_error_msg_len
+
 exit_error:
     ; --- Program Termination (Exit Error) ---
+    ; Write the message in rsi, rdx to stderr
+    mov rax, SYS_WRITE
+    mov rdi, STDERR
+    syscall
     ; rax = SYS_EXIT (60)
     ; rdi = 1 (exit code for error)
     mov rax, SYS_EXIT
     mov rdi, 1
     syscall
 
-section .data
-    newline_char db 0xA
+; --- Display a Message Followed by a Number ---
+; In:  rsi = message, rdx = its length, rax = number
+; Clobbers rax, rcx, rdx, rdi, rsi, r8 and r11
+print_count:
+    push rax
+    mov rax, SYS_WRITE
+    mov rdi, STDOUT
+    syscall
+    pop rax
+
+    ; Convert rax to ASCII digits in num_buffer, backwards from its end, which
+    ; holds the newline
+    lea r8, [rel num_buffer + num_buffer_len - 1]
+    mov byte [r8], 0xA
+    mov rcx, 10             ; Divisor (10)
+.convert:
+    xor rdx, rdx            ; Clear rdx for division
+    div rcx                 ; rax = rax / 10, rdx = rax % 10
+    add dl, '0'             ; Convert remainder to ASCII digit
+    dec r8                  ; Move pointer back
+    mov byte [r8], dl       ; Store digit
+    test rax, rax           ; Continue if quotient is not 0
+    jnz .convert
+
+    ; rax = SYS_WRITE (1)
+    ; rdi = STDOUT (1)
+    ; rsi = r8 (start of the number string)
+    ; rdx = length of the number string and its newline
+    mov rax, SYS_WRITE
+    mov rdi, STDOUT
+    mov rsi, r8
+    lea rdx, [rel num_buffer + num_buffer_len]
+    sub rdx, r8
+    syscall
+    ret
@@ -0,0 +1,1104 @@
+; question2_scan.asm - Count the lines in many sensor logs at once, on every core
+; Compliation and execution: (using NASM and LD on Linux)
+;   nasm -f elf64 question2_scan.asm -o question2_scan.o
+;   ld question2_scan.o -o question2_scan
+;   ./question2_scan [-t threads] [file_or_directory ...]   (default: sensor_log.txt)
+;
+; Every file named on the command line is counted, and every regular file in
+; every directory named (not its subdirectories). Like question2.asm it uses no
+; C library, only system calls, and the same SIMD counting (line_count.inc).
+;
+; Each file is split into chunks of about 16 MiB that end just after a newline,
+; so a chunk starts at the beginning of a line and counts exactly like a file of
+; its own. A pool of threads (one per CPU unless -t says otherwise) takes chunks
+; from a shared list with one atomic add each and reads them with pread, which
+; needs no shared file offset. The kernel is told each file is read sequentially
+; and, as a thread takes a chunk, to start reading all of it ahead.
+;
+; Output: one line per file, "<path>: <N> readings, <M> non-empty", in the order
+; the files were found, then the totals.
+
+%include "line_count.inc"
+
+section .data
+    ; Constants for system calls
+    SYS_READ    equ 0       ; sys_read system call number
+    SYS_WRITE   equ 1       ; sys_write system call number
+    SYS_OPEN    equ 2       ; sys_open system call number
+    SYS_CLOSE   equ 3       ; sys_close system call number
+    SYS_FSTAT   equ 5       ; sys_fstat system call number
+    SYS_MMAP    equ 9       ; sys_mmap system call number
+    SYS_PREAD64 equ 17      ; sys_pread64 system call number
+    SYS_CLONE   equ 56      ; sys_clone system call number
+    SYS_EXIT    equ 60      ; sys_exit system call number (ends one thread)
+    SYS_FUTEX   equ 202     ; sys_futex system call number
+    SYS_SCHED_GETAFFINITY equ 204 ; sys_sched_getaffinity system call number
+    SYS_GETDENTS64 equ 217  ; sys_getdents64 system call number
+    SYS_FADVISE64 equ 221   ; sys_fadvise64 system call number
+    SYS_EXIT_GROUP equ 231  ; sys_exit_group system call number (ends every thread)
+    SYS_OPENAT  equ 257     ; sys_openat system call number
+    SYS_PRLIMIT64 equ 302   ; sys_prlimit64 system call number
+
+    ; File open flags. O_NONBLOCK keeps a FIFO in a log directory from hanging
+    ; the open; it changes nothing for regular files.
+    O_RDONLY    equ 0       ; Read-only access
+    O_NONBLOCK  equ 0x800
+
+    ; struct stat fields and file types
+    ST_MODE     equ 24
+    ST_SIZE     equ 48
+    STAT_SIZE   equ 144
+    S_IFMT      equ 0xF000
+    S_IFDIR     equ 0x4000
+    S_IFREG     equ 0x8000
+
+    ; struct linux_dirent64 fields and the entry types worth opening
+    DIRENT_RECLEN equ 16
+    DIRENT_TYPE equ 18
+    DIRENT_NAME equ 19
+    DT_UNKNOWN  equ 0
+    DT_REG      equ 8
+    DT_LNK      equ 10
+
+    ; posix_fadvise advice
+    POSIX_FADV_SEQUENTIAL equ 2
+    POSIX_FADV_WILLNEED equ 3
+
+    ; mmap arguments
+    PROT_READ_WRITE equ 3
+    MAP_PRIVATE_ANONYMOUS equ 0x22
+    MAP_NORESERVE equ 0x4000   ; reserve address space, back it only when touched
+
+    ; Threads share memory, files and signal handlers. The kernel stores the
+    ; thread ID in its worker record at start and clears it, waking a futex
+    ; waiter, when the thread exits.
+    CLONE_VM    equ 0x100
+    CLONE_FS    equ 0x200
+    CLONE_FILES equ 0x400
+    CLONE_SIGHAND equ 0x800
+    CLONE_THREAD equ 0x10000
+    CLONE_SYSVSEM equ 0x40000
+    CLONE_PARENT_SETTID equ 0x100000
+    CLONE_CHILD_CLEARTID equ 0x200000
+    CLONE_FLAGS equ CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID
+
+    FUTEX_WAIT  equ 0
+    RLIMIT_NOFILE equ 7
+
+    ; Standard file descriptors
+    STDOUT      equ 1
+    STDERR      equ 2
+
+    ; Sizes
+    CHUNK_SIZE  equ 16 * 1024 * 1024 ; bytes per chunk of a file, before moving its end to a line boundary
+    BUFFER_SIZE equ 256 * 1024  ; bytes read per sys_pread64, a whole number of blocks
+    SCAN_SIZE   equ 4096        ; bytes searched at a time for the end of a chunk's last line
+    STACK_SIZE  equ 64 * 1024   ; stack of each thread
+    DIRENT_BUFFER_SIZE equ 64 * 1024
+    OUTPUT_SIZE equ 64 * 1024
+    MAX_THREADS equ 256
+    MAX_FILES   equ 1024 * 1024
+    MAX_CHUNKS  equ 4 * 1024 * 1024
+    NAMES_SIZE  equ 64 * 1024 * 1024 ; names of the files found in directories
+
+    ; File record: one per log, in the order found
+    FILE_DIR    equ 0       ; directory it was found in, or 0 if named itself
+    FILE_NAME   equ 8
+    FILE_FD     equ 16
+    FILE_LENGTH equ 24      ; bytes, when it was opened
+    FILE_FIRST_CHUNK equ 32
+    FILE_CHUNKS equ 40
+    FILE_RECORD equ 64
+
+    ; Chunk record: a range of one file, filled in with its counts by the thread
+    ; that takes it. A cache line each, so threads never write the same line.
+    CHUNK_FD    equ 0
+    CHUNK_START equ 8       ; offset of the first byte, the start of a line
+    CHUNK_END   equ 16      ; offset just past the last byte
+    CHUNK_LINES equ 24
+    CHUNK_BLANK equ 32      ; lines that are blank
+    CHUNK_ERROR equ 40      ; 1 if a read failed
+    CHUNK_RECORD equ 64
+
+    ; Worker record: one per thread
+    WORKER_BUFFER equ 0     ; BUFFER_SIZE + BLOCK_SIZE bytes to read chunks into
+    WORKER_CHUNK equ 8      ; chunk being counted
+    WORKER_POS  equ 16      ; next offset to read
+    WORKER_TID  equ 24      ; thread ID, 0 once the thread has exited
+    WORKER_RECORD equ 64
+
+    ; Filename used when none is given on the command line
+    default_filename db "sensor_log.txt", 0
+
+    ; Pieces of the report
+    separator db ": "
+    separator_len equ $ - separator
+    readings_sep db " readings, "
+    readings_sep_len equ $ - readings_sep
+    non_empty_msg db " non-empty", 0xA
+    non_empty_msg_len equ $ - non_empty_msg
+    slash db "/"
+    newline db 0xA
+    files_msg db "Log files: "
+    files_msg_len equ $ - files_msg
+    msg db "Total sensor readings: "
+    msg_len equ $ - msg
+    readings_msg db "Non-empty sensor readings: "
+    readings_msg_len equ $ - readings_msg
+
+    ; Error messages
+    usage_msg db "Usage: question2_scan [-t threads] [file_or_directory ...]", 0xA
+    usage_msg_len equ $ - usage_msg
+    open_error_msg db "Error: cannot open "
+    open_error_msg_len equ $ - open_error_msg
+    read_error_msg db "Error: cannot read "
+    read_error_msg_len equ $ - read_error_msg
+    memory_error_msg db "Error: out of memory", 0xA
+    memory_error_msg_len equ $ - memory_error_msg
+    too_many_msg db "Error: too many log files", 0xA
+    too_many_msg_len equ $ - too_many_msg
+    thread_error_msg db "Error: cannot start a thread", 0xA
+    thread_error_msg_len equ $ - thread_error_msg
+
+    ; Where out_bytes writes to, and the exit status
+    align 8, db 0
+    output_fd dq STDOUT
+    exit_status dq 0
+
+section .bss
+    ; Index of the next chunk to take, on a cache line of its own: every thread
+    ; adds to it, and nothing else should share the line
+    alignb 64
+    next_chunk resb 64
+
+    workers resb MAX_THREADS * WORKER_RECORD
+    thread_count resb 8     ; threads to start
+    threads_started resb 8
+
+    ; Tables, reserved with mmap when the program starts
+    file_table resb 8
+    file_count resb 8
+    chunk_table resb 8
+    chunk_count resb 8
+    name_table resb 8
+    names_used resb 8
+
+    ; Scratch space for the main thread
+    alignb 64
+    scan_buffer resb SCAN_SIZE
+    dirent_buffer resb DIRENT_BUFFER_SIZE
+    output_buffer resb OUTPUT_SIZE
+    output_used resb 8
+    stat_buffer resb STAT_SIZE
+    file_limit resb 16      ; struct rlimit
+    cpu_mask resb 128       ; room for 1024 CPUs
+
+    ; Buffer for converting a number to a string
+    num_buffer resb 24
+    num_buffer_len equ $ - num_buffer
+
+section .text
+    global _start
+
+_start:
+    ; On entry [rsp] = argc and [rsp + 8] = argv[0], [rsp + 16] = argv[1], ...
+    mov r12, rsp
+    call select_kernel
+    call raise_file_limit
+    call allocate_tables
+    call count_cpus
+    mov [rel thread_count], rax
+
+    ; --- Collect the Logs ---
+    ; r13 = index of the next argument, r14 = paths given
+    mov r13, 1
+    xor r14, r14
+next_argument:
+    cmp r13, [r12]
+    jae arguments_done
+    mov rdi, [r12 + 8 + r13*8]
+    inc r13
+    cmp byte [rdi], '-'
+    jne add_argument
+    cmp byte [rdi + 1], 't'
+    jne add_argument
+    cmp byte [rdi + 2], 0
+    jne add_argument
+
+    ; -t threads: a number from 1 to MAX_THREADS
+    cmp r13, [r12]
+    jae usage_error
+    mov rdi, [r12 + 8 + r13*8]
+    inc r13
+    call parse_count
+    test rax, rax
+    jz usage_error
+    cmp rax, MAX_THREADS
+    ja usage_error
+    mov [rel thread_count], rax
+    jmp next_argument
+
+add_argument:
+    inc r14
+    call add_path
+    jmp next_argument
+
+arguments_done:
+    test r14, r14
+    jnz start_threads
+    lea rdi, [rel default_filename]
+    call add_path
+
+start_threads:
+    ; --- Start the Thread Pool ---
+    ; No more threads than chunks. r13 = threads to start, r12 = worker record.
+    mov r13, [rel thread_count]
+    mov rax, [rel chunk_count]
+    cmp r13, rax
+    cmova r13, rax
+    lea r12, [rel workers]
+start_thread:
+    cmp [rel threads_started], r13
+    jae join_threads
+
+    ; Its stack, with its read buffer just above
+    mov rax, SYS_MMAP
+    xor rdi, rdi
+    mov rsi, STACK_SIZE + BUFFER_SIZE + BLOCK_SIZE
+    mov rdx, PROT_READ_WRITE
+    mov r10, MAP_PRIVATE_ANONYMOUS
+    mov r8, -1
+    xor r9, r9
+    syscall
+    test rax, rax
+    js memory_error
+    add rax, STACK_SIZE
+    mov [r12 + WORKER_BUFFER], rax
+
+    ; rax = SYS_CLONE (56)
+    ; rdi = flags, rsi = stack top (the new thread returns with rsp there)
+    ; rdx = where to store the thread ID, r10 = where to clear it on exit
+    mov rsi, rax
+    mov rax, SYS_CLONE
+    mov rdi, CLONE_FLAGS
+    lea rdx, [r12 + WORKER_TID]
+    mov r10, rdx
+    xor r8, r8
+    syscall
+    test rax, rax
+    js thread_error
+    jz worker_main        ; The new thread, with r12 = its worker record
+
+    inc qword [rel threads_started]
+    add r12, WORKER_RECORD
+    jmp start_thread
+
+join_threads:
+    ; --- Wait for Every Thread to Exit ---
+    lea r12, [rel workers]
+    mov r13, [rel threads_started]
+join_thread:
+    test r13, r13
+    jz report
+    mov edx, [r12 + WORKER_TID]
+    test edx, edx
+    jz joined
+    ; rax = SYS_FUTEX (202)
+    ; rdi = the thread ID word, rsi = FUTEX_WAIT, rdx = its value, r10 = no timeout
+    ; Sleeps until the kernel clears the word as the thread exits
+    mov rax, SYS_FUTEX
+    lea rdi, [r12 + WORKER_TID]
+    mov rsi, FUTEX_WAIT
+    xor r10, r10
+    syscall
+    jmp join_thread
+joined:
+    add r12, WORKER_RECORD
+    dec r13
+    jmp join_thread
+
+report:
+    ; --- Display the Counts of Each File ---
+    ; r12 = file record, r13 = files left, r14 = total lines, r15 = total blank
+    ; lines, rbp = files counted, rbx = chunk record
+    mov r12, [rel file_table]
+    mov r13, [rel file_count]
+    xor r14, r14
+    xor r15, r15
+    xor rbp, rbp
+report_file:
+    test r13, r13
+    jz report_totals
+
+    ; Add up its chunks: rax = lines, rdx = blank lines, rcx = chunks left,
+    ; r8 = 1 if any read failed
+    mov rbx, [r12 + FILE_FIRST_CHUNK]
+    shl rbx, 6              ; * CHUNK_RECORD
+    add rbx, [rel chunk_table]
+    mov rcx, [r12 + FILE_CHUNKS]
+    xor eax, eax
+    xor edx, edx
+    xor r8, r8
+.sum:
+    test rcx, rcx
+    jz .summed
+    add rax, [rbx + CHUNK_LINES]
+    add rdx, [rbx + CHUNK_BLANK]
+    or r8, [rbx + CHUNK_ERROR]
+    add rbx, CHUNK_RECORD
+    dec rcx
+    jmp .sum
+.summed:
+    test r8, r8
+    jnz .read_failed
+    add r14, rax
+    add r15, rdx
+    inc rbp
+    push rdx
+    push rax
+
+    ; "<path>: <lines> readings, <lines that are not blank> non-empty"
+    mov rdi, [r12 + FILE_DIR]
+    mov rsi, [r12 + FILE_NAME]
+    call out_path
+    lea rsi, [rel separator]
+    mov rdx, separator_len
+    call out_bytes
+    mov rax, [rsp]
+    call out_number
+    lea rsi, [rel readings_sep]
+    mov rdx, readings_sep_len
+    call out_bytes
+    pop rax
+    pop rdx
+    sub rax, rdx
+    call out_number
+    lea rsi, [rel non_empty_msg]
+    mov rdx, non_empty_msg_len
+    call out_bytes
+    jmp .next
+
+.read_failed:
+    lea rsi, [rel read_error_msg]
+    mov rdx, read_error_msg_len
+    mov rdi, [r12 + FILE_DIR]
+    mov rcx, [r12 + FILE_NAME]
+    call report_error
+.next:
+    add r12, FILE_RECORD
+    dec r13
+    jmp report_file
+
+report_totals:
+    ; --- Display the Totals ---
+    lea rsi, [rel files_msg]
+    mov rdx, files_msg_len
+    call out_bytes
+    mov rax, rbp
+    call out_number
+    call out_newline
+
+    lea rsi, [rel msg]
+    mov rdx, msg_len
+    call out_bytes
+    mov rax, r14
+    call out_number
+    call out_newline
+
+    lea rsi, [rel readings_msg]
+    mov rdx, readings_msg_len
+    call out_bytes
+    mov rax, r14
+    sub rax, r15
+    call out_number
+    call out_newline
+    call out_flush
+
+    ; --- Program Termination ---
+    ; rax = SYS_EXIT_GROUP (231), which ends any threads too
+    ; rdi = 0, or 1 if any log could not be counted
+    mov rax, SYS_EXIT_GROUP
+    mov rdi, [rel exit_status]
+    syscall
+
+usage_error:
+    lea rsi, [rel usage_msg]
+    mov rdx, usage_msg_len
+    jmp fatal_error
+
+memory_error:
+    lea rsi, [rel memory_error_msg]
+    mov rdx, memory_error_msg_len
+    jmp fatal_error
+
+too_many_files:
+    lea rsi, [rel too_many_msg]
+    mov rdx, too_many_msg_len
+    jmp fatal_error
+
+thread_error:
+    lea rsi, [rel thread_error_msg]
+    mov rdx, thread_error_msg_len
+
+fatal_error:
+    ; --- Program Termination (Exit Error) ---
+    ; Write the message in rsi, rdx to stderr
+    mov rdi, STDERR
+    call write_all
+    ; rax = SYS_EXIT_GROUP (231)
+    ; rdi = 1 (exit code for error)
+    mov rax, SYS_EXIT_GROUP
+    mov rdi, 1
+    syscall
+
+; --- Worker Thread ---
+; In:  r12 = its worker record, rsp = the top of its own stack
+; Takes chunks until there are none left, then exits.
+worker_main:
+    mov rax, 1
+    lock xadd [rel next_chunk], rax
+    cmp rax, [rel chunk_count]
+    jae .exit
+    shl rax, 6              ; * CHUNK_RECORD
+    add rax, [rel chunk_table]
+    mov [r12 + WORKER_CHUNK], rax
+    call count_chunk
+    jmp worker_main
+.exit:
+    ; rax = SYS_EXIT (60): ends this thread only
+    mov rax, SYS_EXIT
+    xor rdi, rdi
+    syscall
+
+; --- Count One Chunk ---
+; In:  r12 = worker record, with WORKER_CHUNK set
+; Stores the chunk's lines and blank lines in its record. Clobbers every register
+; but r12 and rsp.
+count_chunk:
+    ; Ask the kernel to start reading the whole chunk now, so the reads below
+    ; find it in the page cache
+    ; rax = SYS_FADVISE64 (221)
+    ; rdi = fd, rsi = offset, rdx = length, r10 = POSIX_FADV_WILLNEED (3)
+    mov r8, [r12 + WORKER_CHUNK]
+    mov rax, SYS_FADVISE64
+    mov rdi, [r8 + CHUNK_FD]
+    mov rsi, [r8 + CHUNK_START]
+    mov rdx, [r8 + CHUNK_END]
+    sub rdx, rsi
+    mov r10, POSIX_FADV_WILLNEED
+    syscall
+
+    mov r8, [r12 + WORKER_CHUNK]
+    mov rax, [r8 + CHUNK_START]
+    mov [r12 + WORKER_POS], rax
+    call line_count_start   ; The chunk starts at the beginning of a line
+
+.read:
+    ; rdx = bytes left in the chunk, up to the room left in the buffer
+    mov r8, [r12 + WORKER_CHUNK]
+    mov rdx, [r8 + CHUNK_END]
+    sub rdx, [r12 + WORKER_POS]
+    jz .end_of_chunk
+    mov rax, BUFFER_SIZE
+    sub rax, rbp
+    cmp rdx, rax
+    cmova rdx, rax
+
+    ; rax = SYS_PREAD64 (17)
+    ; rdi = fd, rsi = buffer after the bytes carried over, rdx = bytes wanted
+    ; r10 = offset (r10 holds part of the count: save it)
+    mov rdi, [r8 + CHUNK_FD]
+    mov rsi, [r12 + WORKER_BUFFER]
+    add rsi, rbp
+    push r10
+    mov r10, [r12 + WORKER_POS]
+    mov rax, SYS_PREAD64
+    syscall
+    pop r10
+
+    ; A read error marks the chunk; end of file means the file shrank since it
+    ; was opened
+    cmp rax, 0
+    jl .read_error
+    je .end_of_chunk
+
+    add [r12 + WORKER_POS], rax
+    mov rsi, [r12 + WORKER_BUFFER]
+    call line_count_buffer
+    jmp .read
+
+.read_error:
+    mov r8, [r12 + WORKER_CHUNK]
+    mov qword [r8 + CHUNK_ERROR], 1
+.end_of_chunk:
+    ; Only the last chunk of a file can end without a newline
+    mov rsi, [r12 + WORKER_BUFFER]
+    call line_count_finish
+    mov r8, [r12 + WORKER_CHUNK]
+    mov [r8 + CHUNK_LINES], r13
+    mov [r8 + CHUNK_BLANK], r14
+    ret
+
+; --- Add a File or Directory Named on the Command Line ---
+; In:  rdi = path
+add_path:
+    push rbx
+    push r12
+    mov rbx, rdi
+
+    ; rax = SYS_OPEN (2)
+    ; rdi = path, rsi = O_RDONLY | O_NONBLOCK
+    mov rax, SYS_OPEN
+    mov rsi, O_RDONLY | O_NONBLOCK
+    syscall
+    test rax, rax
+    js .open_error
+    mov r12, rax
+
+    mov rdi, r12
+    call stat_fd
+    js .read_error
+    cmp eax, S_IFDIR
+    je .directory
+    cmp eax, S_IFREG
+    jne .read_error
+
+    xor rdi, rdi
+    mov rsi, rbx
+    mov rdx, r12
+    mov rcx, [rel stat_buffer + ST_SIZE]
+    call add_file
+    jmp .done
+
+.directory:
+    mov rdi, r12
+    mov rsi, rbx
+    call scan_directory
+    mov rdi, r12
+    call close_fd
+    jmp .done
+
+.read_error:
+    mov rdi, r12
+    call close_fd
+    lea rsi, [rel read_error_msg]
+    mov rdx, read_error_msg_len
+    jmp .report
+.open_error:
+    lea rsi, [rel open_error_msg]
+    mov rdx, open_error_msg_len
+.report:
+    xor rdi, rdi
+    mov rcx, rbx
+    call report_error
+.done:
+    pop r12
+    pop rbx
+    ret
+
+; --- Add Every Regular File in a Directory ---
+; In:  rdi = its fd, rsi = its path
+scan_directory:
+    push rbx
+    push rbp
+    push r12
+    push r13
+    push r14
+    push r15
+    mov r12, rdi
+    mov r13, rsi
+
+.read:
+    ; rax = SYS_GETDENTS64 (217)
+    ; rdi = fd, rsi = dirent_buffer, rdx = its size
+    ; rbx = next entry, r14 = end of the entries read
+    mov rax, SYS_GETDENTS64
+    mov rdi, r12
+    lea rsi, [rel dirent_buffer]
+    mov rdx, DIRENT_BUFFER_SIZE
+    syscall
+    test rax, rax
+    js .read_error
+    jz .done
+    lea rbx, [rel dirent_buffer]
+    lea r14, [rbx + rax]
+
+.entry:
+    cmp rbx, r14
+    jae .read
+    lea rbp, [rbx + DIRENT_NAME]
+
+    ; Skip subdirectories and devices without opening them, and "." and ".."
+    mov al, [rbx + DIRENT_TYPE]
+    cmp al, DT_REG
+    je .name
+    cmp al, DT_LNK
+    je .name
+    cmp al, DT_UNKNOWN
+    jne .next
+.name:
+    cmp byte [rbp], '.'
+    jne .open
+    cmp byte [rbp + 1], 0
+    je .next
+    cmp byte [rbp + 1], '.'
+    jne .open
+    cmp byte [rbp + 2], 0
+    je .next
+
+.open:
+    ; rax = SYS_OPENAT (257)
+    ; rdi = directory fd, rsi = name, rdx = O_RDONLY | O_NONBLOCK
+    mov rax, SYS_OPENAT
+    mov rdi, r12
+    mov rsi, rbp
+    mov rdx, O_RDONLY | O_NONBLOCK
+    xor r10, r10
+    syscall
+    test rax, rax
+    js .open_error
+    mov r15, rax
+
+    ; Only regular files (a link may lead anywhere)
+    mov rdi, r15
+    call stat_fd
+    js .skip
+    cmp eax, S_IFREG
+    jne .skip
+
+    mov rsi, rbp
+    call save_name
+    mov rdi, r13
+    mov rsi, rax
+    mov rdx, r15
+    mov rcx, [rel stat_buffer + ST_SIZE]
+    call add_file
+
+.next:
+    movzx eax, word [rbx + DIRENT_RECLEN]
+    add rbx, rax
+    jmp .entry
+
+.skip:
+    mov rdi, r15
+    call close_fd
+    jmp .next
+
+.open_error:
+    lea rsi, [rel open_error_msg]
+    mov rdx, open_error_msg_len
+    mov rdi, r13
+    mov rcx, rbp
+    call report_error
+    jmp .next
+
+.read_error:
+    lea rsi, [rel read_error_msg]
+    mov rdx, read_error_msg_len
+    xor rdi, rdi
+    mov rcx, r13
+    call report_error
+.done:
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbp
+    pop rbx
+    ret
+
+; --- Add a Log and Split It into Chunks ---
+; In:  rdi = directory path or 0, rsi = name, rdx = open fd, rcx = length
+add_file:
+    push rbx
+    push r12
+    push r13
+    mov rax, [rel file_count]
+    cmp rax, MAX_FILES
+    jae too_many_files
+    inc qword [rel file_count]
+    shl rax, 6              ; * FILE_RECORD
+    add rax, [rel file_table]
+    mov rbx, rax
+    mov [rbx + FILE_DIR], rdi
+    mov [rbx + FILE_NAME], rsi
+    mov [rbx + FILE_FD], rdx
+    mov [rbx + FILE_LENGTH], rcx
+    mov rax, [rel chunk_count]
+    mov [rbx + FILE_FIRST_CHUNK], rax
+
+    ; rax = SYS_FADVISE64 (221)
+    ; rdi = fd, rsi = 0, rdx = 0 (the whole file), r10 = POSIX_FADV_SEQUENTIAL (2)
+    ; Lets the kernel read further ahead than it would by default
+    mov rax, SYS_FADVISE64
+    mov rdi, rdx
+    xor rsi, rsi
+    xor rdx, rdx
+    mov r10, POSIX_FADV_SEQUENTIAL
+    syscall
+
+    ; r12 = start of the next chunk, r13 = its end: CHUNK_SIZE bytes on, moved
+    ; to just after the next newline, or the end of the file
+    xor r12, r12
+.chunk:
+    mov r13, [rbx + FILE_LENGTH]
+    cmp r12, r13
+    jae .done
+    lea rsi, [r12 + CHUNK_SIZE]
+    cmp rsi, r13
+    jae .add
+    mov rdi, [rbx + FILE_FD]
+    dec rsi                 ; A newline at the last byte of the chunk ends it
+    call next_line_start
+    cmp rax, r13
+    cmovb r13, rax
+
+.add:
+    mov rax, [rel chunk_count]
+    cmp rax, MAX_CHUNKS
+    jae too_many_files
+    inc qword [rel chunk_count]
+    inc qword [rbx + FILE_CHUNKS]
+    shl rax, 6              ; * CHUNK_RECORD
+    add rax, [rel chunk_table]
+    mov rdx, [rbx + FILE_FD]
+    mov [rax + CHUNK_FD], rdx
+    mov [rax + CHUNK_START], r12
+    mov [rax + CHUNK_END], r13
+    mov r12, r13
+    jmp .chunk
+
+.done:
+    pop r13
+    pop r12
+    pop rbx
+    ret
+
+; --- Find Where the Next Line Starts ---
+; In:  rdi = fd, rsi = offset
+; Out: rax = offset just past the first newline at or after rsi, or -1 if there
+;      is none (or the file cannot be read)
+next_line_start:
+    push rbx
+    push r12
+    mov rbx, rdi
+    mov r12, rsi
+.search:
+    ; rax = SYS_PREAD64 (17)
+    ; rdi = fd, rsi = scan_buffer, rdx = SCAN_SIZE, r10 = offset
+    mov rax, SYS_PREAD64
+    mov rdi, rbx
+    lea rsi, [rel scan_buffer]
+    mov rdx, SCAN_SIZE
+    mov r10, r12
+    syscall
+    test rax, rax
+    jle .none
+
+    mov rdx, rax
+    lea rdi, [rel scan_buffer]
+    mov rcx, rdx
+    mov al, 0xA
+    repne scasb             ; rdi = just past the newline, if found
+    je .found
+    add r12, rdx
+    jmp .search
+
+.found:
+    lea rax, [rel scan_buffer]
+    sub rdi, rax
+    lea rax, [r12 + rdi]
+    jmp .done
+.none:
+    mov rax, -1
+.done:
+    pop r12
+    pop rbx
+    ret
+
+; --- File Type ---
+; In:  rdi = fd
+; Out: eax = its S_IFMT bits, with stat_buffer filled in; the sign flag is set
+;      if fstat failed
+stat_fd:
+    mov rax, SYS_FSTAT
+    lea rsi, [rel stat_buffer]
+    syscall
+    test rax, rax
+    js .done
+    mov eax, [rel stat_buffer + ST_MODE]
+    and eax, S_IFMT         ; Clears the sign flag
+.done:
+    ret
+
+close_fd:
+    mov rax, SYS_CLOSE
+    syscall
+    ret
+
+; --- Keep a Name from a Directory ---
+; In:  rsi = name
+; Out: rax = a copy that lasts until the program exits
+save_name:
+    mov rdi, rsi
+    mov rcx, -1
+    xor eax, eax
+    repne scasb
+    not rcx                 ; rcx = length with its terminator
+    mov rax, [rel names_used]
+    lea rdx, [rax + rcx]
+    cmp rdx, NAMES_SIZE
+    ja too_many_files
+    mov [rel names_used], rdx
+    add rax, [rel name_table]
+    mov rdi, rax
+    rep movsb
+    ret
+
+; --- Reserve the Tables ---
+; Reserves address space for the largest tables allowed; the kernel only backs
+; the pages actually used.
+allocate_tables:
+    mov rsi, MAX_FILES * FILE_RECORD
+    call reserve
+    mov [rel file_table], rax
+    mov rsi, MAX_CHUNKS * CHUNK_RECORD
+    call reserve
+    mov [rel chunk_table], rax
+    mov rsi, NAMES_SIZE
+    call reserve
+    mov [rel name_table], rax
+    ret
+
+; In:  rsi = bytes
+; Out: rax = zeroed memory
+reserve:
+    mov rax, SYS_MMAP
+    xor rdi, rdi
+    mov rdx, PROT_READ_WRITE
+    mov r10, MAP_PRIVATE_ANONYMOUS | MAP_NORESERVE
+    mov r8, -1
+    xor r9, r9
+    syscall
+    test rax, rax
+    js memory_error
+    ret
+
+; --- Allow as Many Open Files as Possible ---
+; Every log stays open until it is counted, so raise the soft limit on open files
+; to the hard one. Failing that, logs past the limit are reported as errors.
+raise_file_limit:
+    ; rax = SYS_PRLIMIT64 (302)
+    ; rdi = 0 (this process), rsi = RLIMIT_NOFILE, rdx = new limit, r10 = old limit
+    mov rax, SYS_PRLIMIT64
+    xor rdi, rdi
+    mov rsi, RLIMIT_NOFILE
+    xor rdx, rdx
+    lea r10, [rel file_limit]
+    syscall
+    test rax, rax
+    jnz .done
+    mov rax, [rel file_limit + 8]
+    mov [rel file_limit], rax
+    mov rax, SYS_PRLIMIT64
+    xor rdi, rdi
+    mov rsi, RLIMIT_NOFILE
+    lea rdx, [rel file_limit]
+    xor r10, r10
+    syscall
+.done:
+    ret
+
+; --- Number of CPUs This Process May Run On ---
+; Out: rax = at least 1, at most MAX_THREADS
+count_cpus:
+    ; rax = SYS_SCHED_GETAFFINITY (204)
+    ; rdi = 0 (this thread), rsi = size of cpu_mask, rdx = cpu_mask
+    ; Returns the bytes of the mask it filled in
+    mov rax, SYS_SCHED_GETAFFINITY
+    xor rdi, rdi
+    mov rsi, 128
+    lea rdx, [rel cpu_mask]
+    syscall
+    xor ecx, ecx            ; rcx = CPUs
+    test rax, rax
+    jle .done
+    lea rsi, [rel cpu_mask]
+    lea rdi, [rsi + rax]
+.byte:
+    movzx eax, byte [rsi]
+.bit:
+    test eax, eax
+    jz .next_byte
+    lea edx, [eax - 1]
+    and eax, edx            ; Clear the lowest set bit
+    inc rcx
+    jmp .bit
+.next_byte:
+    inc rsi
+    cmp rsi, rdi
+    jb .byte
+.done:
+    mov rax, rcx
+    mov rdx, 1
+    test rax, rax
+    cmovz rax, rdx
+    mov rdx, MAX_THREADS
+    cmp rax, rdx
+    cmova rax, rdx
+    ret
+
+; --- Parse a Decimal Count ---
+; In:  rdi = string
+; Out: rax = its value, or 0 if it is not a number from 1 to MAX_THREADS
+parse_count:
+    xor eax, eax
+    movzx ecx, byte [rdi]
+    test ecx, ecx
+    jz .invalid
+.digit:
+    movzx ecx, byte [rdi]
+    test ecx, ecx
+    jz .done
+    sub ecx, '0'
+    cmp ecx, 9
+    ja .invalid
+    imul rax, rax, 10
+    add rax, rcx
+    cmp rax, MAX_THREADS
+    ja .invalid
+    inc rdi
+    jmp .digit
+.invalid:
+    xor eax, eax
+.done:
+    ret
+
+; --- Report a Log That Could Not Be Counted ---
+; In:  rsi = message, rdx = its length, rdi = directory path or 0, rcx = name
+; Writes the message and the path to stderr and makes the exit status 1.
+report_error:
+    push rdi
+    push rcx
+    push rsi
+    push rdx
+    call out_flush
+    mov qword [rel output_fd], STDERR
+    pop rdx
+    pop rsi
+    call out_bytes
+    pop rsi
+    pop rdi
+    call out_path
+    call out_newline
+    call out_flush
+    mov qword [rel output_fd], STDOUT
+    mov qword [rel exit_status], 1
+    ret
+
+; --- Buffered Output ---
+; Output collects in output_buffer and is written to output_fd when full or
+; flushed. These routines clobber rax, rcx, rdx, rdi, rsi, r8 and r11.
+
+; In:  rdi = directory path or 0, rsi = name
+out_path:
+    test rdi, rdi
+    jz .name
+    push rsi
+    mov rsi, rdi
+    call out_string
+    ; Add a slash unless the directory path ends in one
+    lea rsi, [rel slash]
+    mov rdx, 1
+    cmp byte [rax - 1], '/'
+    je .slashed
+    call out_bytes
+.slashed:
+    pop rsi
+.name:
+    jmp out_string
+
+; In:  rsi = NUL-terminated string
+; Out: rax = just past its last character
+out_string:
+    mov rdi, rsi
+    mov rcx, -1
+    xor eax, eax
+    repne scasb
+    lea rax, [rdi - 1]
+    mov rdx, rax
+    sub rdx, rsi
+    push rax
+    call out_bytes
+    pop rax
+    ret
+
+out_newline:
+    lea rsi, [rel newline]
+    mov rdx, 1
+    ; Falls through to out_bytes
+
+; In:  rsi = bytes, rdx = how many
+out_bytes:
+    mov rax, [rel output_used]
+    lea rcx, [rax + rdx]
+    cmp rcx, OUTPUT_SIZE
+    jbe .copy
+    push rsi
+    push rdx
+    call out_flush
+    pop rdx
+    pop rsi
+    cmp rdx, OUTPUT_SIZE
+    ja .direct
+    xor eax, eax
+.copy:
+    lea rdi, [rel output_buffer]
+    add rdi, rax
+    add rax, rdx
+    mov [rel output_used], rax
+    mov rcx, rdx
+    rep movsb
+    ret
+.direct:
+    mov rdi, [rel output_fd]
+    jmp write_all
+
+; In:  rax = number
+out_number:
+    ; Convert rax to ASCII digits in num_buffer, backwards from its end
+    lea rsi, [rel num_buffer + num_buffer_len]
+    mov rcx, 10             ; Divisor (10)
+.convert:
+    xor rdx, rdx            ; Clear rdx for division
+    div rcx                 ; rax = rax / 10, rdx = rax % 10
+    add dl, '0'             ; Convert remainder to ASCII digit
+    dec rsi                 ; Move pointer back
+    mov byte [rsi], dl      ; Store digit
+    test rax, rax           ; Continue if quotient is not 0
+    jnz .convert
+    lea rdx, [rel num_buffer + num_buffer_len]
+    sub rdx, rsi
+    jmp out_bytes
+
+out_flush:
+    mov rdi, [rel output_fd]
+    lea rsi, [rel output_buffer]
+    mov rdx, [rel output_used]
+    mov qword [rel output_used], 0
+    ; Falls through to write_all
+
+; In:  rdi = fd, rsi = bytes, rdx = how many
+; Writes them all, unless the fd fails
+write_all:
+    test rdx, rdx
+    jz .done
+    mov rax, SYS_WRITE
+    syscall
+    test rax, rax
+    jle .done
+    add rsi, rax
+    sub rdx, rax
+    jmp write_all
+.done:
+    ret
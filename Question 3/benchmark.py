@@ -0,0 +1,273 @@
+"""Benchmark and accuracy harness for the temp_stats extension.
+
+Times every temp_stats reduction against its NumPy equivalent over a sweep of
+array sizes, dtypes, memory layouts and thread counts, reporting GB/s and
+ns/reading, and measures the relative error of the mean and variance each row
+reports, computed by that row's function with its thread count, against an
+extended-precision reference.
+
+    python benchmark.py                              # 1e3 .. 1e8 readings, table on stdout
+    python benchmark.py --max-size 1e9 --threads 1 8 # full sweep (needs ~8 GB of RAM for float64)
+    python benchmark.py --format jsonl --output results.jsonl
+    python benchmark.py --format jsonl --baseline results.jsonl  # flag >10% slowdowns
+
+Every row of the jsonl/csv output is one (function, implementation, dtype, size,
+layout, threads) measurement; the first jsonl row describes the machine.
+Sizes whose arrays do not fit in the available memory are skipped.
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import math
+import os
+import platform
+import sys
+import time
+
+import numpy as np
+
+import temp_stats
+
+DTYPES = {"float32": np.float32, "float64": np.float64, "int16": np.int16}
+LAYOUTS = ("contiguous", "strided")
+
+CSV_FIELDS = ("function", "impl", "dtype", "size", "layout", "threads", "seconds", "gb_per_s", "ns_per_reading",
+              "rel_error_mean", "rel_error_variance", "regression")
+
+# Largest array whose reference sum is computed exactly with math.fsum.
+FSUM_MAX_SIZE = 10_000_000
+# Readings per chunk when converting to long double for the reference.
+REFERENCE_CHUNK = 1 << 22
+
+
+def numpy_summary(a):
+    return a.min(), a.max(), a.mean(), a.var(ddof=1)
+
+
+# name: (temp_stats implementation, NumPy implementation)
+FUNCTIONS = {
+    "min_temp": (temp_stats.min_temp, np.min),
+    "max_temp": (temp_stats.max_temp, np.max),
+    "avg_temp": (temp_stats.avg_temp, np.mean),
+    "variance_temp": (temp_stats.variance_temp, lambda a: np.var(a, ddof=1)),
+    "summary": (temp_stats.summary, numpy_summary),
+    "histogram": (lambda a: temp_stats.histogram(a, 100, -50.0, 150.0),
+                  lambda a: np.histogram(a, bins=100, range=(-50.0, 150.0))[0]),
+    "quantiles": (lambda a: quantile_sketch(a).quantile([0.5, 0.95, 0.99]),
+                  lambda a: np.percentile(a, [50, 95, 99])),
+}
+
+
+# name: how to read (mean, variance) off a result; None where it reports neither
+MOMENTS = {
+    "avg_temp": lambda result: (result, None),
+    "variance_temp": lambda result: (None, result),
+    # temp_stats returns a Summary, NumPy a (min, max, mean, variance) tuple
+    "summary": lambda result: ((result.mean, result.variance) if hasattr(result, "variance")
+                               else (result[2], result[3])),
+}
+
+
+def quantile_sketch(a):
+    sketch = temp_stats.QuantileSketch()
+    sketch.update(a)
+    return sketch
+
+
+def make_readings(size, dtype, layout, rng):
+    """Returns `size` synthetic temperature readings with the given layout."""
+    span = size * 2 if layout == "strided" else size
+    readings = rng.normal(20.0, 5.0, span)
+    if dtype is np.int16:
+        readings = np.clip(readings * 100.0, -32768, 32767)
+    readings = readings.astype(dtype)
+    return readings[::2] if layout == "strided" else readings
+
+
+def time_call(fn, a, min_time, max_repeats):
+    """Returns the best wall time of fn(a) over repeated calls."""
+    best = math.inf
+    start = time.perf_counter()
+    repeats = 0
+    while repeats < max_repeats and (repeats < 2 or time.perf_counter() - start < min_time):
+        t0 = time.perf_counter()
+        fn(a)
+        best = min(best, time.perf_counter() - t0)
+        repeats += 1
+    return best
+
+
+def reference_moments(a):
+    """Returns the mean and sample variance of `a` in extended precision.
+
+    The sum behind the mean is exact for arrays math.fsum can handle, and
+    accumulated in long double otherwise. At every size the deviations from the
+    mean are formed, squared and summed in long double.
+    """
+    if a.size <= FSUM_MAX_SIZE:
+        values = a.astype(np.float64)
+        total = math.fsum(values)
+        # fsum rounds the exact sum to float64; keep what it rounded off too
+        residual = math.fsum(itertools.chain(values, (-total,)))
+        mean = (np.longdouble(total) + np.longdouble(residual)) / a.size
+    else:
+        total = np.longdouble(0)
+        for i in range(0, a.size, REFERENCE_CHUNK):
+            total += a[i:i + REFERENCE_CHUNK].astype(np.longdouble).sum()
+        mean = total / a.size
+
+    squares = np.longdouble(0)
+    for i in range(0, a.size, REFERENCE_CHUNK):
+        deviations = a[i:i + REFERENCE_CHUNK].astype(np.longdouble) - mean
+        squares += (deviations * deviations).sum()
+    return mean, squares / (a.size - 1)
+
+
+def relative_error(value, reference):
+    """Returns |value - reference| / |reference|, worked out in the reference's long double."""
+    error = abs(np.longdouble(value) - reference)
+    return float(error / abs(reference) if reference != 0 else error)
+
+
+def available_memory():
+    try:
+        return os.sysconf("SC_AVPHYS_PAGES") * os.sysconf("SC_PAGE_SIZE")
+    except (ValueError, OSError, AttributeError):
+        return None
+
+
+def sizes_between(min_size, max_size):
+    exponent = math.ceil(math.log10(min_size))
+    while 10 ** exponent <= max_size:
+        yield 10 ** exponent
+        exponent += 1
+
+
+def run(args):
+    rng = np.random.default_rng(args.seed)
+    memory = available_memory()
+
+    for size in sizes_between(args.min_size, args.max_size):
+        for dtype_name in args.dtypes:
+            dtype = DTYPES[dtype_name]
+            for layout in args.layouts:
+                needed = size * np.dtype(dtype).itemsize * (2 if layout == "strided" else 1) * 3
+                if memory is not None and needed > memory:
+                    print(f"skipping {size:.0e} {dtype_name} {layout}: needs {needed / 1e9:.1f} GB", file=sys.stderr)
+                    continue
+                readings = make_readings(size, dtype, layout, rng)
+                nbytes = size * readings.itemsize
+
+                if args.accuracy:
+                    reference = reference_moments(readings)
+
+                for name in args.functions:
+                    ours, theirs = FUNCTIONS[name]
+                    for threads in args.threads:
+                        temp_stats.set_num_threads(threads)
+                        implementations = [("temp_stats", ours)]
+                        if threads == args.threads[0]:
+                            implementations.append(("numpy", theirs))  # NumPy does not use our threads
+                        for impl, fn in implementations:
+                            seconds = time_call(fn, readings, args.min_time, args.max_repeats)
+                            row = {
+                                "function": name, "impl": impl, "dtype": dtype_name, "size": size,
+                                "layout": layout, "threads": threads if impl == "temp_stats" else 1,
+                                "seconds": seconds, "gb_per_s": nbytes / seconds / 1e9,
+                                "ns_per_reading": seconds / size * 1e9,
+                            }
+                            if args.accuracy and name in MOMENTS:
+                                # Measured with this row's function and thread count
+                                moments = MOMENTS[name](fn(readings))
+                                for key, value, expected in zip(("rel_error_mean", "rel_error_variance"),
+                                                                moments, reference):
+                                    if value is not None:
+                                        row[key] = relative_error(value, expected)
+                            yield row
+                del readings
+
+
+def machine_info():
+    return {
+        "machine": platform.machine(), "processor": platform.processor(), "cpus": os.cpu_count(),
+        "python": platform.python_version(), "numpy": np.__version__, "simd_isa": temp_stats.simd_isa,
+        "default_threads": temp_stats.get_num_threads(),
+    }
+
+
+def load_baseline(path):
+    key_fields = ("function", "impl", "dtype", "size", "layout", "threads")
+    baseline = {}
+    with open(path) as f:
+        for line in f:
+            row = json.loads(line)
+            if "function" in row:
+                baseline[tuple(row[k] for k in key_fields)] = row
+    return lambda row: baseline.get(tuple(row[k] for k in key_fields))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--min-size", type=float, default=1e3)
+    parser.add_argument("--max-size", type=float, default=1e8)
+    parser.add_argument("--dtypes", nargs="+", choices=DTYPES, default=list(DTYPES))
+    parser.add_argument("--layouts", nargs="+", choices=LAYOUTS, default=list(LAYOUTS))
+    parser.add_argument("--threads", nargs="+", type=int, default=sorted({1, temp_stats.get_num_threads()}))
+    parser.add_argument("--functions", nargs="+", choices=FUNCTIONS, default=list(FUNCTIONS))
+    parser.add_argument("--no-accuracy", dest="accuracy", action="store_false",
+                        help="skip the extended-precision error checks")
+    parser.add_argument("--min-time", type=float, default=0.2, help="seconds to spend timing each case")
+    parser.add_argument("--max-repeats", type=int, default=50)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--format", choices=("table", "csv", "jsonl"), default="table")
+    parser.add_argument("--output", help="write results here instead of stdout")
+    parser.add_argument("--baseline", help="jsonl results to compare against")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="slowdown against the baseline reported as a regression")
+    args = parser.parse_args()
+    args.min_size, args.max_size = int(args.min_size), int(args.max_size)
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    baseline = load_baseline(args.baseline) if args.baseline else None
+    regressions = 0
+    writer = None
+
+    if args.format == "jsonl":
+        print(json.dumps(machine_info()), file=out)
+    elif args.format == "table":
+        print(" ".join(f"{k}={v}" for k, v in machine_info().items()), file=out)
+        print(f"{'function':<14}{'impl':<11}{'dtype':<8}{'size':>8} {'layout':<11}{'thr':>3}"
+              f"{'GB/s':>9}{'ns/elem':>9}{'err(mean)':>11}{'err(var)':>11}", file=out)
+
+    for row in run(args):
+        if baseline is not None:
+            previous = baseline(row)
+            if previous is not None and row["seconds"] > previous["seconds"] * (1 + args.tolerance):
+                row["regression"] = row["seconds"] / previous["seconds"] - 1
+                regressions += 1
+        if args.format == "jsonl":
+            print(json.dumps(row), file=out)
+        elif args.format == "csv":
+            if writer is None:
+                writer = csv.DictWriter(out, fieldnames=CSV_FIELDS)
+                writer.writeheader()
+            writer.writerow(row)
+        else:
+            errors = "".join(f"{row[k]:>11.2e}" if k in row else f"{'':>11}"
+                             for k in ("rel_error_mean", "rel_error_variance"))
+            flag = f"  REGRESSION +{row['regression']:.0%}" if "regression" in row else ""
+            print(f"{row['function']:<14}{row['impl']:<11}{row['dtype']:<8}{row['size']:>8.0e} {row['layout']:<11}"
+                  f"{row['threads']:>3}{row['gb_per_s']:>9.2f}{row['ns_per_reading']:>9.2f}{errors}{flag}", file=out)
+        out.flush()
+
+    if out is not sys.stdout:
+        out.close()
+    if regressions:
+        print(f"{regressions} measurement(s) slower than the baseline by more than {args.tolerance:.0%}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,51 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+// Asks the kernel to start reading window `start` .. `start + count` readings into
+// the page cache, asynchronously. Advisory only, so failures are ignored.
+static void read_ahead(int fd, off_t offset, npy_intp start, npy_intp count, size_t item_size)
+{
+    if (count > 0) {
+        posix_fadvise(fd, offset + (off_t)(start * item_size), (off_t)(count * item_size), POSIX_FADV_WILLNEED);
+    }
+}
+
+int reduce_file(int fd, off_t offset, npy_intp count, size_t item_size, ReadingType type, int swapped,
+                ReduceKind kind, TempMoments *acc)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    posix_fadvise(fd, offset, (off_t)(count * item_size), POSIX_FADV_SEQUENTIAL);
+    read_ahead(fd, offset, 0, count < FILE_WINDOW_READINGS ? count : FILE_WINDOW_READINGS, item_size);
+
+    for (npy_intp start = 0; start < count; start += FILE_WINDOW_READINGS) {
+        npy_intp n = count - start < FILE_WINDOW_READINGS ? count - start : FILE_WINDOW_READINGS;
+        off_t window_offset = offset + (off_t)(start * item_size);
+        off_t map_offset = window_offset - window_offset % page_size; // mmap needs a page-aligned offset
+        size_t map_length = (size_t)(window_offset - map_offset) + n * item_size;
+
+        char *map = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, map_offset);
+        if (map == MAP_FAILED) {
+            return errno;
+        }
+        madvise(map, map_length, MADV_SEQUENTIAL);
+
+        // Overlap: the next window is read from disk while this one is reduced
+        npy_intp next = start + n;
+        read_ahead(fd, offset, next, count - next < FILE_WINDOW_READINGS ? count - next : FILE_WINDOW_READINGS,
+                   item_size);
+
+        const char *data = map + (window_offset - map_offset);
+        ReadingRun run = {data, n, (npy_intp)item_size, type, swapped, ((uintptr_t)data % item_size) == 0};
+        reduce_run(kind, &run, acc);
+
+        munmap(map, map_length);
+    }
+
+    return 0;
+}
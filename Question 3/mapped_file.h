@@ -0,0 +1,24 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <sys/types.h>
+
+#include "stats_kernels.h"
+
+// Number of readings mapped at a time. A whole number of segments, so reducing a
+// file window by window folds exactly the same segment results in the same order
+// as reducing the file's contents in memory: results are bit-identical.
+#define FILE_WINDOW_READINGS (32 * SEGMENT_SIZE)
+
+// Reduces `count` readings of `item_size` bytes stored in the open file `fd`
+// starting `offset` bytes in, folding them into `acc` like reduce_run().
+// The file is memory-mapped one window of FILE_WINDOW_READINGS readings at a time
+// with MADV_SEQUENTIAL; while a window is reduced (on the thread pool when it is
+// large enough) the kernel is asked to read the next one ahead, and each window is
+// unmapped once reduced, so resident memory stays at about one window however
+// large the file is. Never touches Python objects, so it may be called without
+// holding the GIL. Returns 0 on success or an errno value.
+int reduce_file(int fd, off_t offset, npy_intp count, size_t item_size, ReadingType type, int swapped,
+                ReduceKind kind, TempMoments *acc);
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,194 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "rolling_stats.h"
+
+// Readings that may still become the window minimum (or maximum), oldest first,
+// with their indices. Their values are monotonic from front to back, so every
+// reading is pushed and popped at most once. At most `capacity` (= window) readings
+// are ever held, in a circular buffer.
+typedef struct {
+    npy_intp *index;
+    double *value;
+    npy_intp capacity;
+    npy_intp head;
+    npy_intp size;
+} MonotonicDeque;
+
+static inline npy_intp deque_slot(const MonotonicDeque *q, npy_intp k)
+{
+    npy_intp slot = q->head + k;
+    return slot < q->capacity ? slot : slot - q->capacity;
+}
+
+// Pops readings older than `oldest` from the front.
+static inline void deque_expire(MonotonicDeque *q, npy_intp oldest)
+{
+    while (q->size > 0 && q->index[q->head] < oldest) {
+        q->head = deque_slot(q, 1);
+        q->size--;
+    }
+}
+
+// Pushes reading i, first popping every reading at the back it supersedes: for the
+// minimum, readings no smaller than x can never be a window minimum again.
+static inline void deque_push(MonotonicDeque *q, npy_intp i, double x, int is_max)
+{
+    while (q->size > 0) {
+        double back = q->value[deque_slot(q, q->size - 1)];
+        if (is_max ? back > x : back < x) {
+            break;
+        }
+        q->size--;
+    }
+    npy_intp slot = deque_slot(q, q->size);
+    q->index[slot] = i;
+    q->value[slot] = x;
+    q->size++;
+}
+
+// Recomputes the mean and M2 of the window exactly (two passes over the ring), so
+// the rounding error of the sliding updates never builds up beyond one window.
+static void recompute_window(const double *ring, npy_intp window, double *mean, double *m2)
+{
+    double sum = 0.0, squares = 0.0;
+
+    for (npy_intp k = 0; k < window; k++) {
+        sum += isfinite(ring[k]) ? ring[k] : 0.0;
+    }
+    *mean = sum / window;
+    for (npy_intp k = 0; k < window; k++) {
+        double diff = (isfinite(ring[k]) ? ring[k] : 0.0) - *mean;
+        squares += diff * diff;
+    }
+    *m2 = squares;
+}
+
+// The mean and M2 of the window are slid one reading at a time:
+//   mean' = mean + (x_new - x_old) / N
+//   M2'   = M2 + (x_new - x_old) * (x_new - mean' + x_old - mean)
+// Non-finite readings count as 0 in these sums, so an infinity leaving the window
+// cannot turn them into NaN; while one is inside, the mean and variance come from
+// counts of NaNs and infinities instead. NaN readings are never pushed onto the
+// deques.
+int rolling_stats(const ReadingRun *run, npy_intp window,
+                  double *min, double *max, double *mean, double *variance)
+{
+    double *ring = malloc(3 * window * sizeof(double)); // the last `window` readings, then deque values
+    npy_intp *indices = malloc(2 * window * sizeof(npy_intp));
+    if (ring == NULL || indices == NULL) {
+        free(ring);
+        free(indices);
+        return -1;
+    }
+
+    MonotonicDeque min_q = {indices, ring + window, window, 0, 0};
+    MonotonicDeque max_q = {indices + window, ring + 2 * window, window, 0, 0};
+    double block[BLOCK_SIZE];
+    double running_mean = 0.0, m2 = 0.0;
+    npy_intp nan_count = 0, pos_inf_count = 0, neg_inf_count = 0;
+    npy_intp slot = 0; // i % window
+
+    for (npy_intp start = 0; start < run->count; start += BLOCK_SIZE) {
+        npy_intp n = run->count - start < BLOCK_SIZE ? run->count - start : BLOCK_SIZE;
+        load_readings(run->type, run->swapped, run->data + start * run->stride, run->stride, n, block);
+
+        for (npy_intp k = 0; k < n; k++) {
+            npy_intp i = start + k;
+            double x = block[k];
+            double value = isfinite(x) ? x : 0.0;
+
+            if (i < window) {
+                // Filling the first window: Welford's update
+                double diff = value - running_mean;
+                running_mean += diff / (i + 1);
+                m2 += diff * (value - running_mean);
+            } else {
+                double old = ring[slot];
+                double old_value = isfinite(old) ? old : 0.0;
+                double new_mean = running_mean + (value - old_value) / window;
+                m2 += (value - old_value) * (value - new_mean + old_value - running_mean);
+                running_mean = new_mean;
+                nan_count -= isnan(old);
+                pos_inf_count -= old == INFINITY;
+                neg_inf_count -= old == -INFINITY;
+                deque_expire(&min_q, i - window + 1);
+                deque_expire(&max_q, i - window + 1);
+            }
+
+            ring[slot] = x;
+            if (isnan(x)) {
+                nan_count++;
+            } else {
+                pos_inf_count += x == INFINITY;
+                neg_inf_count += x == -INFINITY;
+                deque_push(&min_q, i, x, 0);
+                deque_push(&max_q, i, x, 1);
+            }
+
+            if (++slot == window) {
+                slot = 0;
+                recompute_window(ring, window, &running_mean, &m2);
+            }
+            if (i + 1 < window) {
+                continue;
+            }
+
+            npy_intp j = i + 1 - window;
+            if (nan_count > 0) {
+                min[j] = max[j] = mean[j] = variance[j] = NAN;
+            } else {
+                min[j] = min_q.value[min_q.head];
+                max[j] = max_q.value[max_q.head];
+                if (pos_inf_count > 0 || neg_inf_count > 0) {
+                    // As for NumPy: inf - inf is NaN, and so is any variance around an infinite mean
+                    mean[j] = pos_inf_count > 0 && neg_inf_count > 0 ? NAN : pos_inf_count > 0 ? INFINITY : -INFINITY;
+                    variance[j] = NAN;
+                } else {
+                    // Rounding can leave M2 a hair below zero; NaN passes through
+                    mean[j] = running_mean;
+                    variance[j] = window > 1 ? (m2 < 0.0 ? 0.0 : m2) / (window - 1) : NAN;
+                }
+            }
+        }
+    }
+
+    free(ring);
+    free(indices);
+    return 0;
+}
+
+// West's incremental update:
+//   diff = x - mean;  mean += alpha * diff;  var = (1 - alpha) * (var + alpha * diff^2)
+// starting from mean = first reading, var = 0.
+void ewma_stats(const ReadingRun *run, double alpha, double *mean, double *variance)
+{
+    double block[BLOCK_SIZE];
+    double running_mean = 0.0, running_var = 0.0;
+    int started = 0;
+
+    for (npy_intp start = 0; start < run->count; start += BLOCK_SIZE) {
+        npy_intp n = run->count - start < BLOCK_SIZE ? run->count - start : BLOCK_SIZE;
+        load_readings(run->type, run->swapped, run->data + start * run->stride, run->stride, n, block);
+
+        for (npy_intp k = 0; k < n; k++) {
+            double x = block[k];
+
+            if (isnan(x)) {
+                mean[start + k] = variance[start + k] = NAN;
+                continue;
+            }
+            if (!started) {
+                running_mean = x;
+                started = 1;
+            } else {
+                double diff = x - running_mean;
+                double increment = alpha * diff;
+                running_mean += increment;
+                running_var = (1.0 - alpha) * (running_var + diff * increment);
+            }
+            mean[start + k] = running_mean;
+            variance[start + k] = running_var;
+        }
+    }
+}
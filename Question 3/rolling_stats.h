@@ -0,0 +1,25 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include "stats_kernels.h"
+
+// Moving statistics over a run of readings, one result per reading. Like the
+// reduction kernels they never touch Python objects, so they may be called
+// without holding the GIL.
+
+// Computes min, max, mean and sample variance of every window of `window`
+// consecutive readings of `run` (1 <= window <= run->count). Result j covers
+// readings [j, j + window), so each output holds run->count - window + 1 values.
+// Windows containing a NaN yield NaN for every statistic; windows containing an
+// infinity yield an infinite (or, with both signs, NaN) mean and NaN variance. Runs in O(count) time
+// and O(window) extra memory. Returns -1 if out of memory, 0 otherwise.
+int rolling_stats(const ReadingRun *run, npy_intp window,
+                  double *min, double *max, double *mean, double *variance);
+
+// Computes the exponentially weighted moving mean and variance after every
+// reading, with smoothing factor 0 < alpha <= 1 (the weight of the newest reading).
+// A NaN reading leaves the state unchanged and yields NaN at its own position.
+// Each output holds run->count values.
+void ewma_stats(const ReadingRun *run, double alpha, double *mean, double *variance);
+
+#endif // ROLLING_STATS_H
@@ -4,8 +4,13 @@ import numpy
 # Define the C extension module
 temp_stats_module = Extension(
     'temp_stats',
-    sources=['temp_stats.c'],
-    include_dirs=[numpy.get_include()]
+    sources=['temp_stats.c', 'stats_kernels.c', 'mapped_file.c', 'rolling_stats.c', 'sketches.c', 'thread_pool.c'],
+    depends=['stats_kernels.h', 'stats_kernels_scalar.h', 'stats_kernels_isa.h', 'stats_kernels_simd.h',
+             'mapped_file.h', 'rolling_stats.h', 'sketches.h', 'thread_pool.h'],
+    include_dirs=[numpy.get_include()],
+    # The SIMD kernels must not fuse multiplies and adds, otherwise their results
+    # would no longer match the scalar reference bit for bit.
+    extra_compile_args=['-ffp-contract=off']
 )
 
 setup(
@@ -0,0 +1,415 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sketches.h"
+#include "thread_pool.h"
+
+// Large runs are sketched as this many pieces (fewer if the run is shorter than
+// that many segments), whatever the number of threads.
+#define SKETCH_PIECES 64
+
+// Quantile sketch
+// ---------------
+// Buffered readings are sorted, merged with the (already sorted) centroids and the
+// combined list is swept once, folding each item into the current centroid while
+// the centroid still spans at most one unit of k. Consecutive centroids therefore
+// span more than one unit together, which bounds their number by compression + 1.
+
+static double scale_k(double q, double compression)
+{
+    return compression / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+static double scale_k_inverse(double k, double compression)
+{
+    if (k >= compression / 4.0) {
+        return 1.0;
+    }
+    return (sin(2.0 * M_PI * k / compression) + 1.0) / 2.0;
+}
+
+// Maps a reading to an unsigned key with the same order (negative readings have
+// all bits flipped, positive ones just the sign bit), and back.
+static inline uint64_t order_key(double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (UINT64_C(1) << 63);
+}
+
+static inline double key_reading(uint64_t key)
+{
+    uint64_t bits = (key >> 63) ? key & ~(UINT64_C(1) << 63) : ~key;
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// Sorts n NaN-free readings in place with an LSD radix sort over their keys, one
+// byte per pass, using `temp` (room for 2 * n keys). Passes whose byte is the same
+// for every key are skipped; readings converted from float32 or int16 have at
+// least 29 zero low bits, so they only need a few passes.
+static void sort_readings(double *a, npy_intp n, uint64_t *temp)
+{
+    uint64_t *keys = temp, *other = temp + n;
+    uint32_t counts[8][256] = {{0}};
+
+    for (npy_intp i = 0; i < n; i++) {
+        keys[i] = order_key(a[i]);
+        for (int pass = 0; pass < 8; pass++) {
+            counts[pass][(keys[i] >> (8 * pass)) & 0xff]++;
+        }
+    }
+
+    for (int pass = 0; pass < 8; pass++) {
+        uint32_t *count = counts[pass];
+        if (count[(keys[0] >> (8 * pass)) & 0xff] == (uint32_t)n) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            uint32_t c = count[digit];
+            count[digit] = offset;
+            offset += c;
+        }
+        for (npy_intp i = 0; i < n; i++) {
+            other[count[(keys[i] >> (8 * pass)) & 0xff]++] = keys[i];
+        }
+        uint64_t *swap = keys;
+        keys = other;
+        other = swap;
+    }
+
+    for (npy_intp i = 0; i < n; i++) {
+        a[i] = key_reading(keys[i]);
+    }
+}
+
+// Number of readings buffered between merges: enough to amortise the merge over
+// the centroids, and at least a block.
+static npy_intp buffer_capacity(const QuantileSketch *sketch)
+{
+    return 4 * sketch->capacity > BLOCK_SIZE ? 4 * sketch->capacity : BLOCK_SIZE;
+}
+
+int sketch_init(QuantileSketch *sketch, double compression)
+{
+    sketch->compression = compression;
+    sketch->capacity = 2 * (npy_intp)ceil(compression) + 2;
+    sketch->centroids = malloc(sketch->capacity * sizeof(Centroid));
+    sketch->buffer = malloc(buffer_capacity(sketch) * sizeof(double));
+    sketch->scratch = malloc((sketch->capacity + buffer_capacity(sketch)) * sizeof(Centroid));
+    if (sketch->centroids == NULL || sketch->buffer == NULL || sketch->scratch == NULL) {
+        sketch_free(sketch);
+        return -1;
+    }
+    sketch->num_centroids = 0;
+    sketch->buffered = 0;
+    sketch->total_weight = 0.0;
+    sketch->min = INFINITY;
+    sketch->max = -INFINITY;
+    sketch->has_nan = 0;
+    return 0;
+}
+
+void sketch_free(QuantileSketch *sketch)
+{
+    free(sketch->centroids);
+    free(sketch->buffer);
+    free(sketch->scratch);
+    sketch->centroids = NULL;
+    sketch->buffer = NULL;
+    sketch->scratch = NULL;
+}
+
+// Replaces the centroids by the merge of the `n` sorted items in scratch.
+static void merge_scratch(QuantileSketch *sketch, npy_intp n)
+{
+    const Centroid *items = sketch->scratch;
+    double total = sketch->total_weight;
+    double compression = sketch->compression;
+    double weight = items[0].weight, weighted_sum = items[0].mean * items[0].weight;
+    double weight_so_far = 0.0;
+    double limit = total * scale_k_inverse(scale_k(0.0, compression) + 1.0, compression);
+    npy_intp out = 0;
+
+    for (npy_intp i = 1; i < n; i++) {
+        if (weight_so_far + weight + items[i].weight <= limit) {
+            weight += items[i].weight;
+            weighted_sum += items[i].mean * items[i].weight;
+        } else {
+            sketch->centroids[out++] = (Centroid){weighted_sum / weight, weight};
+            weight_so_far += weight;
+            limit = total * scale_k_inverse(scale_k(weight_so_far / total, compression) + 1.0, compression);
+            weight = items[i].weight;
+            weighted_sum = items[i].mean * items[i].weight;
+        }
+    }
+    sketch->centroids[out++] = (Centroid){weighted_sum / weight, weight};
+    sketch->num_centroids = out;
+}
+
+void sketch_compress(QuantileSketch *sketch)
+{
+    if (sketch->buffered == 0) {
+        return;
+    }
+
+    // scratch has room for capacity + buffer capacity centroids, i.e. twice as many keys
+    sort_readings(sketch->buffer, sketch->buffered, (uint64_t *)sketch->scratch);
+
+    // Two-way merge of the sorted centroids and readings into scratch
+    npy_intp i = 0, j = 0, n = 0;
+    while (i < sketch->num_centroids || j < sketch->buffered) {
+        if (j == sketch->buffered || (i < sketch->num_centroids && sketch->centroids[i].mean <= sketch->buffer[j])) {
+            sketch->scratch[n++] = sketch->centroids[i++];
+        } else {
+            sketch->scratch[n++] = (Centroid){sketch->buffer[j++], 1.0};
+        }
+    }
+    sketch->buffered = 0;
+    merge_scratch(sketch, n);
+}
+
+// Adds readings [start, end) of a run on the calling thread.
+static void sketch_add_range(QuantileSketch *sketch, const ReadingRun *run, npy_intp start, npy_intp end)
+{
+    npy_intp capacity = buffer_capacity(sketch);
+
+    while (start < end) {
+        npy_intp n = end - start < capacity - sketch->buffered ? end - start : capacity - sketch->buffered;
+        double *readings = sketch->buffer + sketch->buffered;
+        load_readings(run->type, run->swapped, run->data + start * run->stride, run->stride, n, readings);
+
+        // Drop NaN readings while tracking min and max
+        npy_intp kept = 0;
+        double min_val = sketch->min, max_val = sketch->max;
+        for (npy_intp k = 0; k < n; k++) {
+            double x = readings[k];
+            if (isnan(x)) {
+                sketch->has_nan = 1;
+                continue;
+            }
+            min_val = x < min_val ? x : min_val;
+            max_val = x > max_val ? x : max_val;
+            readings[kept++] = x;
+        }
+        sketch->min = min_val;
+        sketch->max = max_val;
+        sketch->buffered += kept;
+        sketch->total_weight += kept;
+        start += n;
+
+        if (sketch->buffered == capacity) {
+            sketch_compress(sketch);
+        }
+    }
+}
+
+typedef struct {
+    const ReadingRun *run;
+    QuantileSketch *pieces;
+    npy_intp num_pieces;
+} SketchJob;
+
+static void sketch_piece_task(void *ctx, npy_intp piece)
+{
+    SketchJob *job = (SketchJob *)ctx;
+    npy_intp count = job->run->count;
+
+    sketch_add_range(&job->pieces[piece], job->run,
+                     count * piece / job->num_pieces, count * (piece + 1) / job->num_pieces);
+    sketch_compress(&job->pieces[piece]);
+}
+
+int sketch_add_run(QuantileSketch *sketch, const ReadingRun *run)
+{
+    if (run->count < PARALLEL_THRESHOLD) {
+        sketch_add_range(sketch, run, 0, run->count);
+        return 0;
+    }
+
+    npy_intp num_pieces = run->count / SEGMENT_SIZE < SKETCH_PIECES ? run->count / SEGMENT_SIZE : SKETCH_PIECES;
+    QuantileSketch *pieces = calloc(num_pieces, sizeof(QuantileSketch));
+    if (pieces == NULL) {
+        return -1;
+    }
+    for (npy_intp p = 0; p < num_pieces; p++) {
+        if (sketch_init(&pieces[p], sketch->compression) < 0) {
+            for (npy_intp q = 0; q < p; q++) {
+                sketch_free(&pieces[q]);
+            }
+            free(pieces);
+            return -1;
+        }
+    }
+
+    SketchJob job = {run, pieces, num_pieces};
+    pool_run(sketch_piece_task, &job, num_pieces);
+
+    for (npy_intp p = 0; p < num_pieces; p++) {
+        sketch_merge(sketch, &pieces[p]);
+        sketch_free(&pieces[p]);
+    }
+    free(pieces);
+    return 0;
+}
+
+void sketch_merge(QuantileSketch *sketch, QuantileSketch *other)
+{
+    sketch_compress(other);
+    sketch->has_nan |= other->has_nan;
+    if (other->num_centroids == 0) {
+        return;
+    }
+
+    if (other == sketch) {
+        for (npy_intp i = 0; i < sketch->num_centroids; i++) {
+            sketch->centroids[i].weight *= 2.0;
+        }
+        sketch->total_weight *= 2.0;
+        return;
+    }
+
+    sketch_compress(sketch);
+    sketch->min = other->min < sketch->min ? other->min : sketch->min;
+    sketch->max = other->max > sketch->max ? other->max : sketch->max;
+    sketch->total_weight += other->total_weight;
+
+    // Two-way merge of both centroid lists into scratch (at most 2 * capacity items)
+    npy_intp i = 0, j = 0, n = 0;
+    while (i < sketch->num_centroids || j < other->num_centroids) {
+        if (j == other->num_centroids ||
+            (i < sketch->num_centroids && sketch->centroids[i].mean <= other->centroids[j].mean)) {
+            sketch->scratch[n++] = sketch->centroids[i++];
+        } else {
+            sketch->scratch[n++] = other->centroids[j++];
+        }
+    }
+    merge_scratch(sketch, n);
+}
+
+// Each centroid is taken to sit at the middle of its weight: centroid i covers
+// cumulative weight [W_i, W_i + w_i) and its mean is the value at W_i + w_i / 2.
+// Between two centres the value is interpolated linearly; before the first and
+// after the last centre it is interpolated towards the exact min and max.
+double sketch_quantile(QuantileSketch *sketch, double q)
+{
+    sketch_compress(sketch);
+
+    if (sketch->has_nan) {
+        return NAN;
+    }
+    if (q <= 0.0) {
+        return sketch->min;
+    }
+    if (q >= 1.0) {
+        return sketch->max;
+    }
+
+    const Centroid *c = sketch->centroids;
+    npy_intp n = sketch->num_centroids;
+    double target = q * sketch->total_weight;
+    double centre = c[0].weight / 2.0;
+
+    if (target < centre) {
+        return sketch->min + (c[0].mean - sketch->min) * target / centre;
+    }
+    for (npy_intp i = 0; i + 1 < n; i++) {
+        double next_centre = centre + (c[i].weight + c[i + 1].weight) / 2.0;
+        if (target < next_centre) {
+            return c[i].mean + (c[i + 1].mean - c[i].mean) * (target - centre) / (next_centre - centre);
+        }
+        centre = next_centre;
+    }
+    double tail = sketch->total_weight - centre;
+    return tail > 0.0 ? c[n - 1].mean + (sketch->max - c[n - 1].mean) * (target - centre) / tail : c[n - 1].mean;
+}
+
+// Histogram
+// ---------
+// Bin indices are computed exactly as numpy.histogram does for equal-width bins:
+// a first guess from (x - low) * bins / (high - low), corrected by one bin against
+// the edges low + k * (high - low) / bins, so counts match NumPy's.
+
+typedef struct {
+    const ReadingRun *run;
+    npy_intp bins;
+    double low;
+    double high;
+    npy_int64 *counts; // [piece][bin]; piece 0 is the caller's array
+    npy_int64 *partials;
+    npy_intp num_pieces;
+} HistogramJob;
+
+static inline double bin_edge(const HistogramJob *job, npy_intp k)
+{
+    return k == job->bins ? job->high : job->low + k * ((job->high - job->low) / job->bins);
+}
+
+static void histogram_range(const HistogramJob *job, npy_intp start, npy_intp end, npy_int64 *counts)
+{
+    const ReadingRun *run = job->run;
+    double norm = job->bins / (job->high - job->low);
+    double block[BLOCK_SIZE];
+
+    for (; start < end; start += BLOCK_SIZE) {
+        npy_intp n = end - start < BLOCK_SIZE ? end - start : BLOCK_SIZE;
+        load_readings(run->type, run->swapped, run->data + start * run->stride, run->stride, n, block);
+
+        for (npy_intp k = 0; k < n; k++) {
+            double x = block[k];
+            if (!(x >= job->low && x <= job->high)) {
+                continue;
+            }
+            npy_intp bin = (npy_intp)((x - job->low) * norm);
+            if (bin >= job->bins) {
+                bin = job->bins - 1;
+            }
+            if (x < bin_edge(job, bin)) {
+                bin--;
+            } else if (bin + 1 < job->bins && x >= bin_edge(job, bin + 1)) {
+                bin++;
+            }
+            counts[bin]++;
+        }
+    }
+}
+
+static void histogram_piece_task(void *ctx, npy_intp piece)
+{
+    HistogramJob *job = (HistogramJob *)ctx;
+    npy_intp count = job->run->count;
+    npy_int64 *counts = piece == 0 ? job->counts : job->partials + (piece - 1) * job->bins;
+
+    histogram_range(job, count * piece / job->num_pieces, count * (piece + 1) / job->num_pieces, counts);
+}
+
+int histogram_run(const ReadingRun *run, npy_intp bins, double low, double high, npy_int64 *counts)
+{
+    HistogramJob job = {run, bins, low, high, counts, NULL, 1};
+
+    if (run->count < PARALLEL_THRESHOLD || pool_get_num_threads() == 1) {
+        histogram_range(&job, 0, run->count, counts);
+        return 0;
+    }
+
+    // Integer counts add exactly, so one piece per thread gives the same result as one.
+    job.num_pieces = pool_get_num_threads();
+    job.partials = calloc((job.num_pieces - 1) * bins, sizeof(npy_int64));
+    if (job.partials == NULL) {
+        return -1;
+    }
+
+    pool_run(histogram_piece_task, &job, job.num_pieces);
+
+    for (npy_intp piece = 1; piece < job.num_pieces; piece++) {
+        for (npy_intp bin = 0; bin < bins; bin++) {
+            counts[bin] += job.partials[(piece - 1) * bins + bin];
+        }
+    }
+    free(job.partials);
+    return 0;
+}
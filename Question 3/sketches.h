@@ -0,0 +1,67 @@
+#ifndef SKETCHES_H
+#define SKETCHES_H
+
+#include "stats_kernels.h"
+
+// Bounded-memory summaries of a distribution: a quantile sketch and a fixed-bin
+// histogram. Both are mergeable, so chunks and threads can build their own and
+// combine them afterwards. Like the reduction kernels they never touch Python
+// objects, so they may be called without holding the GIL.
+
+// A cluster of readings summarised by their mean and count.
+typedef struct {
+    double mean;
+    double weight;
+} Centroid;
+
+// Merging t-digest (Dunning & Ertl). Readings are buffered, then sorted and merged
+// into at most ~compression centroids whose sizes follow the k1 scale function
+// k(q) = compression / (2 pi) * asin(2q - 1): small near the tails, so extreme
+// quantiles such as p99 and p999 stay accurate, and large near the median.
+// Memory is fixed at sketch_init() whatever the number of readings.
+typedef struct {
+    double compression;
+    Centroid *centroids; // sorted by mean
+    npy_intp num_centroids;
+    npy_intp capacity;
+    double *buffer; // readings not merged yet
+    npy_intp buffered;
+    Centroid *scratch;
+    double total_weight; // including buffered readings
+    double min;
+    double max;
+    int has_nan; // a NaN reading makes every quantile NaN, like numpy.percentile
+} QuantileSketch;
+
+// Allocates an empty sketch. Returns -1 if out of memory, 0 otherwise.
+int sketch_init(QuantileSketch *sketch, double compression);
+
+void sketch_free(QuantileSketch *sketch);
+
+// Adds every reading of a run. Runs of at least PARALLEL_THRESHOLD readings are
+// split into a fixed number of pieces sketched on the thread pool and merged in
+// order, so the result does not depend on the number of threads.
+// Returns -1 if out of memory (the sketch is unchanged), 0 otherwise.
+int sketch_add_run(QuantileSketch *sketch, const ReadingRun *run);
+
+// Merges the buffered readings into the centroids.
+void sketch_compress(QuantileSketch *sketch);
+
+// Adds the readings summarised by `other` (which is compressed first). `other` may be `sketch`.
+void sketch_merge(QuantileSketch *sketch, QuantileSketch *other);
+
+// Estimates the q-quantile (0 <= q <= 1) of a non-empty sketch, interpolating
+// linearly between centroid means; q = 0 and q = 1 give the exact min and max.
+double sketch_quantile(QuantileSketch *sketch, double q);
+
+// Counts the readings of a run into `bins` equal-width bins spanning [low, high],
+// like numpy.histogram: the last bin includes `high`, and readings outside the
+// range or NaN are not counted. Bin edges are computed in double precision as
+// numpy does for float64 and int16 input (for float32 input numpy uses float32
+// edges, so readings within a float32 rounding of an edge may land one bin over).
+// Adds to counts[0 .. bins), so the counts of several runs (or chunks) accumulate.
+// Runs of at least PARALLEL_THRESHOLD readings are split across the thread pool.
+// Returns -1 if out of memory, 0 otherwise.
+int histogram_run(const ReadingRun *run, npy_intp bins, double low, double high, npy_int64 *counts);
+
+#endif // SKETCHES_H
@@ -0,0 +1,663 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats_kernels.h"
+#include "thread_pool.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+
+// Scalar reference
+// ----------------
+
+static inline double min_op(double acc, double x)
+{
+    return acc < x ? acc : x;
+}
+
+static inline double max_op(double acc, double x)
+{
+    return acc > x ? acc : x;
+}
+
+static double fold_min(double lanes[LANES])
+{
+    for (int step = LANES / 2; step > 0; step /= 2) {
+        for (int j = 0; j < step; j++) {
+            lanes[j] = min_op(lanes[j], lanes[j + step]);
+        }
+    }
+    return lanes[0];
+}
+
+static double fold_max(double lanes[LANES])
+{
+    for (int step = LANES / 2; step > 0; step /= 2) {
+        for (int j = 0; j < step; j++) {
+            lanes[j] = max_op(lanes[j], lanes[j + step]);
+        }
+    }
+    return lanes[0];
+}
+
+static double fold_sum(double lanes[LANES])
+{
+    for (int step = LANES / 2; step > 0; step /= 2) {
+        for (int j = 0; j < step; j++) {
+            lanes[j] += lanes[j + step];
+        }
+    }
+    return lanes[0];
+}
+
+static void fill_lanes(double lanes[LANES], double value)
+{
+    for (int j = 0; j < LANES; j++) {
+        lanes[j] = value;
+    }
+}
+
+#define TYPE_SUFFIX _f32
+#define TYPED(name) CONCAT(name, TYPE_SUFFIX)
+#define READING_T float
+#include "stats_kernels_scalar.h"
+#undef READING_T
+#undef TYPE_SUFFIX
+
+#define TYPE_SUFFIX _f64
+#define READING_T double
+#include "stats_kernels_scalar.h"
+#undef READING_T
+#undef TYPE_SUFFIX
+
+static const StatsKernels scalar_kernels = {
+    "scalar",
+    {scalar_block_min_f32, scalar_block_max_f32, scalar_block_sum_f32, scalar_block_moments_f32},
+    {scalar_block_min_f64, scalar_block_max_f64, scalar_block_sum_f64, scalar_block_moments_f64},
+};
+
+#if defined(__x86_64__)
+
+// Every instruction set includes the vector template twice: for float32 readings
+// (widened to double on load) and for float64 readings.
+#define SIMD_FN(name) CONCAT(CONCAT(ISA_PREFIX, name), TYPE_SUFFIX)
+
+// SSE2 (baseline on x86-64): 8 registers of 2 doubles
+#define ISA_PREFIX sse2_
+#define SIMD_TARGET "sse2"
+#define V_TYPE __m128d
+#define V_WIDTH 2
+#define V_LOAD_F32(p) _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)(p))))
+#define V_LOAD_F64(p) _mm_loadu_pd(p)
+#define V_SET1 _mm_set1_pd
+#define V_ADD _mm_add_pd
+#define V_SUB _mm_sub_pd
+#define V_MUL _mm_mul_pd
+#define V_MIN _mm_min_pd
+#define V_MAX _mm_max_pd
+#define V_STORE _mm_storeu_pd
+#define V_NAN_TYPE __m128d
+#define V_NAN_INIT _mm_setzero_pd()
+#define V_NAN_ACC(m, v) _mm_or_pd((m), _mm_cmpunord_pd((v), (v)))
+#define V_NAN_ANY(m) (_mm_movemask_pd(m) != 0)
+#include "stats_kernels_isa.h"
+#undef ISA_PREFIX
+#undef SIMD_TARGET
+#undef V_TYPE
+#undef V_WIDTH
+#undef V_LOAD_F32
+#undef V_LOAD_F64
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_MIN
+#undef V_MAX
+#undef V_STORE
+#undef V_NAN_TYPE
+#undef V_NAN_INIT
+#undef V_NAN_ACC
+#undef V_NAN_ANY
+
+// AVX2: 4 registers of 4 doubles
+#define ISA_PREFIX avx2_
+#define SIMD_TARGET "avx2"
+#define V_TYPE __m256d
+#define V_WIDTH 4
+#define V_LOAD_F32(p) _mm256_cvtps_pd(_mm_loadu_ps(p))
+#define V_LOAD_F64(p) _mm256_loadu_pd(p)
+#define V_SET1 _mm256_set1_pd
+#define V_ADD _mm256_add_pd
+#define V_SUB _mm256_sub_pd
+#define V_MUL _mm256_mul_pd
+#define V_MIN _mm256_min_pd
+#define V_MAX _mm256_max_pd
+#define V_STORE _mm256_storeu_pd
+#define V_NAN_TYPE __m256d
+#define V_NAN_INIT _mm256_setzero_pd()
+#define V_NAN_ACC(m, v) _mm256_or_pd((m), _mm256_cmp_pd((v), (v), _CMP_UNORD_Q))
+#define V_NAN_ANY(m) (_mm256_movemask_pd(m) != 0)
+#include "stats_kernels_isa.h"
+#undef ISA_PREFIX
+#undef SIMD_TARGET
+#undef V_TYPE
+#undef V_WIDTH
+#undef V_LOAD_F32
+#undef V_LOAD_F64
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_MIN
+#undef V_MAX
+#undef V_STORE
+#undef V_NAN_TYPE
+#undef V_NAN_INIT
+#undef V_NAN_ACC
+#undef V_NAN_ANY
+
+// AVX-512: 2 registers of 8 doubles
+#define ISA_PREFIX avx512_
+#define SIMD_TARGET "avx512f"
+#define V_TYPE __m512d
+#define V_WIDTH 8
+#define V_LOAD_F32(p) _mm512_cvtps_pd(_mm256_loadu_ps(p))
+#define V_LOAD_F64(p) _mm512_loadu_pd(p)
+#define V_SET1 _mm512_set1_pd
+#define V_ADD _mm512_add_pd
+#define V_SUB _mm512_sub_pd
+#define V_MUL _mm512_mul_pd
+#define V_MIN _mm512_min_pd
+#define V_MAX _mm512_max_pd
+#define V_STORE _mm512_storeu_pd
+#define V_NAN_TYPE __mmask8
+#define V_NAN_INIT 0
+#define V_NAN_ACC(m, v) (__mmask8)((m) | _mm512_cmp_pd_mask((v), (v), _CMP_UNORD_Q))
+#define V_NAN_ANY(m) ((m) != 0)
+#include "stats_kernels_isa.h"
+#undef ISA_PREFIX
+#undef SIMD_TARGET
+#undef V_TYPE
+#undef V_WIDTH
+#undef V_LOAD_F32
+#undef V_LOAD_F64
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_MIN
+#undef V_MAX
+#undef V_STORE
+#undef V_NAN_TYPE
+#undef V_NAN_INIT
+#undef V_NAN_ACC
+#undef V_NAN_ANY
+
+static const StatsKernels sse2_kernels = {
+    "sse2",
+    {sse2_block_min_f32, sse2_block_max_f32, sse2_block_sum_f32, sse2_block_moments_f32},
+    {sse2_block_min_f64, sse2_block_max_f64, sse2_block_sum_f64, sse2_block_moments_f64},
+};
+
+static const StatsKernels avx2_kernels = {
+    "avx2",
+    {avx2_block_min_f32, avx2_block_max_f32, avx2_block_sum_f32, avx2_block_moments_f32},
+    {avx2_block_min_f64, avx2_block_max_f64, avx2_block_sum_f64, avx2_block_moments_f64},
+};
+
+static const StatsKernels avx512_kernels = {
+    "avx512",
+    {avx512_block_min_f32, avx512_block_max_f32, avx512_block_sum_f32, avx512_block_moments_f32},
+    {avx512_block_min_f64, avx512_block_max_f64, avx512_block_sum_f64, avx512_block_moments_f64},
+};
+
+#endif // __x86_64__
+
+const StatsKernels *stats_kernels = &scalar_kernels;
+
+const StatsKernels *stats_kernels_init(const char *requested)
+{
+    // Supported instruction sets, widest first
+    const StatsKernels *supported[4];
+    int num_supported = 0;
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        supported[num_supported++] = &avx512_kernels;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        supported[num_supported++] = &avx2_kernels;
+    }
+    supported[num_supported++] = &sse2_kernels;
+#endif
+    supported[num_supported++] = &scalar_kernels;
+
+    stats_kernels = supported[0];
+    if (requested != NULL) {
+        for (int i = 0; i < num_supported; i++) {
+            if (strcmp(supported[i]->name, requested) == 0) {
+                stats_kernels = supported[i];
+                break;
+            }
+        }
+    }
+
+    return stats_kernels;
+}
+
+// Staging
+// -------
+// Readings the block kernels cannot read in place are copied, one block at a time,
+// into a buffer of native float32 (float32 and int16 runs) or float64 readings.
+// memcpy() keeps the loads legal for unaligned readings; the compiler turns it
+// into a plain load.
+
+static inline uint16_t load_u16(const char *p, int swapped)
+{
+    uint16_t bits;
+    memcpy(&bits, p, sizeof(bits));
+    return swapped ? __builtin_bswap16(bits) : bits;
+}
+
+static inline uint32_t load_u32(const char *p, int swapped)
+{
+    uint32_t bits;
+    memcpy(&bits, p, sizeof(bits));
+    return swapped ? __builtin_bswap32(bits) : bits;
+}
+
+static inline uint64_t load_u64(const char *p, int swapped)
+{
+    uint64_t bits;
+    memcpy(&bits, p, sizeof(bits));
+    return swapped ? __builtin_bswap64(bits) : bits;
+}
+
+static const size_t reading_size[] = {
+    [READING_FLOAT32] = sizeof(float),
+    [READING_FLOAT64] = sizeof(double),
+    [READING_INT16] = sizeof(int16_t),
+};
+
+// True if the block kernels can read the run in place.
+static int run_is_direct(const ReadingRun *run)
+{
+    return run->type != READING_INT16 && !run->swapped && run->aligned &&
+           run->stride == (npy_intp)reading_size[run->type];
+}
+
+// Copies readings [start, start + n) of `run` into `buffer` (n <= BLOCK_SIZE).
+static void stage_block(const ReadingRun *run, npy_intp start, npy_intp n, void *buffer)
+{
+    const char *p = run->data + start * run->stride;
+
+    switch (run->type) {
+    case READING_FLOAT32: {
+        float *out = buffer;
+        for (npy_intp i = 0; i < n; i++, p += run->stride) {
+            uint32_t bits = load_u32(p, run->swapped);
+            memcpy(&out[i], &bits, sizeof(bits));
+        }
+        break;
+    }
+    case READING_FLOAT64: {
+        double *out = buffer;
+        for (npy_intp i = 0; i < n; i++, p += run->stride) {
+            uint64_t bits = load_u64(p, run->swapped);
+            memcpy(&out[i], &bits, sizeof(bits));
+        }
+        break;
+    }
+    case READING_INT16: {
+        float *out = buffer;
+        for (npy_intp i = 0; i < n; i++, p += run->stride) {
+            out[i] = (int16_t)load_u16(p, run->swapped);
+        }
+        break;
+    }
+    }
+}
+
+// Whole-run reductions
+// --------------------
+// A run is reduced segment by segment, as described in "Reference ordering".
+// Large runs reduce their segments on the thread pool into a table of partial
+// results, which is then folded in order, so the answer does not depend on the
+// number of threads.
+
+typedef struct {
+    ReduceKind kind;
+    const ReadingRun *run;
+    TempMoments *partials;
+} ReduceJob;
+
+static inline double nan_min(double acc, double x)
+{
+    return (isnan(x) || x < acc) ? x : acc;
+}
+
+static inline double nan_max(double acc, double x)
+{
+    return (isnan(x) || x > acc) ? x : acc;
+}
+
+void init_moments(TempMoments *moments)
+{
+    moments->count = 0;
+    moments->min = INFINITY;
+    moments->max = -INFINITY;
+    moments->sum = 0.0;
+    moments->mean = 0.0;
+    moments->m2 = 0.0;
+}
+
+// Folds the partial result `part` into `acc`; only the fields of `kind` are meaningful.
+static void merge_partial(ReduceKind kind, TempMoments *acc, const TempMoments *part)
+{
+    switch (kind) {
+    case REDUCE_MIN:
+        acc->min = nan_min(acc->min, part->min);
+        break;
+    case REDUCE_MAX:
+        acc->max = nan_max(acc->max, part->max);
+        break;
+    case REDUCE_SUM:
+        acc->sum += part->sum;
+        break;
+    case REDUCE_MOMENTS:
+        merge_moments(acc, part);
+        return;
+    }
+    acc->count += part->count;
+}
+
+// Reduces readings [start, start + num_readings) of `run` into `out`.
+static void reduce_segment(ReduceKind kind, const ReadingRun *run, npy_intp start, npy_intp num_readings,
+                           TempMoments *out)
+{
+    const BlockKernels *kernels = run->type == READING_FLOAT64 ? &stats_kernels->f64 : &stats_kernels->f32;
+    int direct = run_is_direct(run);
+    double buffer[BLOCK_SIZE];
+    TempMoments block;
+
+    init_moments(out);
+    init_moments(&block);
+    for (npy_intp offset = 0; offset < num_readings; offset += BLOCK_SIZE) {
+        npy_intp n = num_readings - offset < BLOCK_SIZE ? num_readings - offset : BLOCK_SIZE;
+        const void *data = buffer;
+        if (direct) {
+            data = run->data + (start + offset) * run->stride;
+        } else {
+            stage_block(run, start + offset, n, buffer);
+        }
+
+        switch (kind) {
+        case REDUCE_MIN:
+            block.min = kernels->block_min(data, n);
+            break;
+        case REDUCE_MAX:
+            block.max = kernels->block_max(data, n);
+            break;
+        case REDUCE_SUM:
+            block.sum = kernels->block_sum(data, n);
+            break;
+        case REDUCE_MOMENTS:
+            kernels->block_moments(data, n, &block);
+            break;
+        }
+        block.count = n;
+        merge_partial(kind, out, &block);
+    }
+}
+
+static void reduce_segment_task(void *ctx, npy_intp segment)
+{
+    ReduceJob *job = (ReduceJob *)ctx;
+    npy_intp start = segment * SEGMENT_SIZE;
+    npy_intp n = job->run->count - start < SEGMENT_SIZE ? job->run->count - start : SEGMENT_SIZE;
+
+    reduce_segment(job->kind, job->run, start, n, &job->partials[segment]);
+}
+
+void reduce_run(ReduceKind kind, const ReadingRun *run, TempMoments *acc)
+{
+    npy_intp num_segments = (run->count + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+    TempMoments segment;
+
+    if (run->count >= PARALLEL_THRESHOLD && pool_get_num_threads() > 1) {
+        ReduceJob job = {kind, run, malloc(num_segments * sizeof(TempMoments))};
+        if (job.partials != NULL) {
+            pool_run(reduce_segment_task, &job, num_segments);
+            for (npy_intp s = 0; s < num_segments; s++) {
+                merge_partial(kind, acc, &job.partials[s]);
+            }
+            free(job.partials);
+            return;
+        }
+        // Out of memory for the partials: reduce on this thread instead
+    }
+
+    for (npy_intp s = 0; s < num_segments; s++) {
+        npy_intp start = s * SEGMENT_SIZE;
+        npy_intp n = run->count - start < SEGMENT_SIZE ? run->count - start : SEGMENT_SIZE;
+        reduce_segment(kind, run, start, n, &segment);
+        merge_partial(kind, acc, &segment);
+    }
+}
+
+// Column reductions
+// -----------------
+// Tiles of at most TILE_COLUMNS columns by (TILE_READINGS / columns) rows are staged
+// as doubles, reduced column-wise while cache resident and merged into each
+// column's moments. A task covers one column chunk for AXIS_SEGMENT_ROWS rows, so
+// tall grids with few columns still spread over the pool; the partial results of
+// a column are merged in row order.
+
+#define TILE_COLUMNS 256
+#define TILE_READINGS 8192
+#define AXIS_SEGMENT_ROWS 65536
+
+// Number of columns reduced as runs by one task.
+#define RUN_COLUMNS_PER_TASK 64
+
+typedef struct {
+    const ReadingGrid *grid;
+    npy_intp num_chunks;
+    TempMoments *partials; // [row segment][column]
+} ColumnJob;
+
+void load_readings(ReadingType type, int swapped, const char *p, npy_intp stride, npy_intp n, double *out)
+{
+    switch (type) {
+    case READING_FLOAT32:
+        for (npy_intp i = 0; i < n; i++, p += stride) {
+            uint32_t bits = load_u32(p, swapped);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            out[i] = value;
+        }
+        break;
+    case READING_FLOAT64:
+        for (npy_intp i = 0; i < n; i++, p += stride) {
+            uint64_t bits = load_u64(p, swapped);
+            memcpy(&out[i], &bits, sizeof(bits));
+        }
+        break;
+    case READING_INT16:
+        for (npy_intp i = 0; i < n; i++, p += stride) {
+            out[i] = (int16_t)load_u16(p, swapped);
+        }
+        break;
+    }
+}
+
+// Reduces `rows` staged rows of `columns` doubles into per-column moments and
+// merges them into acc[0 .. columns).
+static void reduce_tile(const double *tile, npy_intp rows, npy_intp columns, TempMoments *acc)
+{
+    double min_val[TILE_COLUMNS], max_val[TILE_COLUMNS], sum[TILE_COLUMNS], mean[TILE_COLUMNS], m2[TILE_COLUMNS];
+
+    for (npy_intp c = 0; c < columns; c++) {
+        min_val[c] = INFINITY;
+        max_val[c] = -INFINITY;
+        sum[c] = 0.0;
+        m2[c] = 0.0;
+    }
+    for (npy_intp r = 0; r < rows; r++) {
+        const double *row = tile + r * columns;
+        for (npy_intp c = 0; c < columns; c++) {
+            min_val[c] = nan_min(min_val[c], row[c]);
+            max_val[c] = nan_max(max_val[c], row[c]);
+            sum[c] += row[c];
+        }
+    }
+    for (npy_intp c = 0; c < columns; c++) {
+        mean[c] = sum[c] / rows;
+    }
+    for (npy_intp r = 0; r < rows; r++) {
+        const double *row = tile + r * columns;
+        for (npy_intp c = 0; c < columns; c++) {
+            double diff = row[c] - mean[c];
+            m2[c] += diff * diff;
+        }
+    }
+
+    for (npy_intp c = 0; c < columns; c++) {
+        TempMoments part = {rows, min_val[c], max_val[c], sum[c], mean[c], m2[c]};
+        merge_moments(&acc[c], &part);
+    }
+}
+
+static void reduce_column_tiles_task(void *ctx, npy_intp task)
+{
+    ColumnJob *job = (ColumnJob *)ctx;
+    const ReadingGrid *grid = job->grid;
+    npy_intp chunk = task % job->num_chunks;
+    npy_intp segment = task / job->num_chunks;
+    npy_intp first_column = chunk * TILE_COLUMNS;
+    npy_intp columns = grid->columns - first_column < TILE_COLUMNS ? grid->columns - first_column : TILE_COLUMNS;
+    npy_intp first_row = segment * AXIS_SEGMENT_ROWS;
+    npy_intp end_row = grid->rows - first_row < AXIS_SEGMENT_ROWS ? grid->rows : first_row + AXIS_SEGMENT_ROWS;
+    npy_intp tile_rows = TILE_READINGS / columns;
+    TempMoments *acc = job->partials + segment * grid->columns + first_column;
+    double tile[TILE_READINGS];
+
+    for (npy_intp c = 0; c < columns; c++) {
+        init_moments(&acc[c]);
+    }
+    for (npy_intp row = first_row; row < end_row; row += tile_rows) {
+        npy_intp rows = end_row - row < tile_rows ? end_row - row : tile_rows;
+        for (npy_intp r = 0; r < rows; r++) {
+            const char *p = grid->data + (row + r) * grid->row_stride + first_column * grid->column_stride;
+            load_readings(grid->type, grid->swapped, p, grid->column_stride, columns, tile + r * columns);
+        }
+        reduce_tile(tile, rows, columns, acc);
+    }
+}
+
+typedef struct {
+    const ReadingGrid *grid;
+    TempMoments *out;
+} RunColumnsJob;
+
+static void reduce_column_runs_task(void *ctx, npy_intp task)
+{
+    RunColumnsJob *job = (RunColumnsJob *)ctx;
+    const ReadingGrid *grid = job->grid;
+    npy_intp first = task * RUN_COLUMNS_PER_TASK;
+    npy_intp end = grid->columns - first < RUN_COLUMNS_PER_TASK ? grid->columns : first + RUN_COLUMNS_PER_TASK;
+
+    for (npy_intp c = first; c < end; c++) {
+        ReadingRun run = {grid->data + c * grid->column_stride, grid->rows, grid->row_stride,
+                          grid->type, grid->swapped, grid->aligned};
+        init_moments(&job->out[c]);
+        reduce_run(REDUCE_MOMENTS, &run, &job->out[c]);
+    }
+}
+
+int reduce_columns(const ReadingGrid *grid, TempMoments *out)
+{
+    if (grid->columns == 0) {
+        return 0;
+    }
+
+    int parallel = grid->rows * grid->columns >= PARALLEL_THRESHOLD;
+
+    if (grid->rows >= BLOCK_SIZE && llabs(grid->row_stride) <= llabs(grid->column_stride)) {
+        RunColumnsJob job = {grid, out};
+        npy_intp num_tasks = (grid->columns + RUN_COLUMNS_PER_TASK - 1) / RUN_COLUMNS_PER_TASK;
+        if (parallel) {
+            pool_run(reduce_column_runs_task, &job, num_tasks);
+        } else {
+            for (npy_intp task = 0; task < num_tasks; task++) {
+                reduce_column_runs_task(&job, task);
+            }
+        }
+        return 0;
+    }
+
+    npy_intp num_chunks = (grid->columns + TILE_COLUMNS - 1) / TILE_COLUMNS;
+    npy_intp num_segments = (grid->rows + AXIS_SEGMENT_ROWS - 1) / AXIS_SEGMENT_ROWS;
+    ColumnJob job = {grid, num_chunks, out};
+
+    if (num_segments > 1) {
+        job.partials = malloc(num_segments * grid->columns * sizeof(TempMoments));
+        if (job.partials == NULL) {
+            return -1;
+        }
+    }
+
+    if (parallel) {
+        pool_run(reduce_column_tiles_task, &job, num_chunks * num_segments);
+    } else {
+        for (npy_intp task = 0; task < num_chunks * num_segments; task++) {
+            reduce_column_tiles_task(&job, task);
+        }
+    }
+
+    if (num_segments > 1) {
+        for (npy_intp c = 0; c < grid->columns; c++) {
+            out[c] = job.partials[c];
+            for (npy_intp segment = 1; segment < num_segments; segment++) {
+                merge_moments(&out[c], &job.partials[segment * grid->columns + c]);
+            }
+        }
+        free(job.partials);
+    }
+
+    return 0;
+}
+
+// Chan et al.'s pairwise update:
+//   delta = mean_b - mean_a
+//   mean  = mean_a + delta * n_b / n
+//   M2    = M2_a + M2_b + delta^2 * n_a * n_b / n
+void merge_moments(TempMoments *acc, const TempMoments *part)
+{
+    if (part->count == 0) {
+        return;
+    }
+    if (acc->count == 0) {
+        *acc = *part;
+        return;
+    }
+
+    double n_a = (double)acc->count;
+    double n_b = (double)part->count;
+    double n = n_a + n_b;
+    double delta = part->mean - acc->mean;
+
+    acc->mean += delta * n_b / n;
+    acc->m2 += part->m2 + delta * delta * n_a * n_b / n;
+    acc->sum += part->sum;
+    acc->min = nan_min(acc->min, part->min);
+    acc->max = nan_max(acc->max, part->max);
+    acc->count += part->count;
+}
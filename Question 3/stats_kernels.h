@@ -0,0 +1,151 @@
+#ifndef STATS_KERNELS_H
+#define STATS_KERNELS_H
+
+#include <Python.h>
+#include <numpy/npy_common.h>
+
+// Reduction kernels shared by the temp_stats module.
+//
+// Reference ordering
+// ------------------
+// Every kernel returns results that are bit-identical to the scalar reference,
+// whichever instruction set (scalar, SSE2, AVX2, AVX-512) is selected at import
+// and however many threads share the work:
+//   1. The readings are cut into segments of SEGMENT_SIZE elements and each segment
+//      into blocks of BLOCK_SIZE elements. Blocks are folded into their segment's
+//      result from left to right, and segment results are folded into the final
+//      result from left to right. Segments may be reduced on different threads.
+//   2. Inside a block, reading i is accumulated into lane (i % LANES), in index
+//      order, in double precision. All instruction sets use the same 16 lanes
+//      (8 SSE2 registers, 4 AVX2 registers or 2 AVX-512 registers).
+//   3. The lanes are folded pairwise: lane[j] op= lane[j + s] for s = 8, 4, 2, 1.
+// min/max follow MINPD/MAXPD semantics (lane = lane < x ? lane : x). A NaN reading
+// is tracked separately and makes min, max and sum NaN, like numpy.min/max/sum.
+// No multiply-add is ever fused (setup.py builds with -ffp-contract=off).
+//
+// The ordering is defined over a run: a sequence of equally spaced readings, such
+// as a contiguous array or a strided view. Runs that are strided, byte-swapped,
+// unaligned or int16 are copied block by block into a small stack buffer (int16
+// converts to float32 exactly) and reduce exactly like a contiguous float32/float64
+// array holding the same values. An N-D array that cannot be walked as a single run
+// is reduced one innermost loop of the NumPy iterator at a time, in memory order.
+
+// Number of readings reduced together before being folded into the running totals.
+// A block of float32 readings (8 KiB) stays resident in L1 cache, so the second
+// pass over it (squared deviations from the block mean) costs no extra memory traffic.
+#define BLOCK_SIZE 2048
+
+// Number of readings per segment, the unit of work handed to the thread pool.
+#define SEGMENT_SIZE (256 * BLOCK_SIZE)
+
+// Arrays with fewer readings are reduced on the calling thread only; below this
+// size waking the workers costs more than it saves.
+#define PARALLEL_THRESHOLD (4 * SEGMENT_SIZE)
+
+// Number of independent accumulators per block; see "Reference ordering".
+#define LANES 16
+
+// Running statistics over a stream of readings.
+// `mean` and `m2` follow Welford's notation: m2 is the sum of squared deviations
+// from the mean. Results over disjoint ranges are combined with Chan's parallel
+// update in merge_moments(), so the readings only ever need to be visited once.
+typedef struct {
+    npy_intp count;
+    double min;
+    double max;
+    double sum;
+    double mean;
+    double m2;
+} TempMoments;
+
+// Element types the kernels read natively.
+typedef enum {
+    READING_FLOAT32,
+    READING_FLOAT64,
+    READING_INT16 // raw ADC counts
+} ReadingType;
+
+// A run of `count` readings starting at `data`, `stride` bytes apart.
+typedef struct {
+    const char *data;
+    npy_intp count;
+    npy_intp stride;
+    ReadingType type;
+    int swapped; // stored in non-native byte order
+    int aligned; // every reading is aligned for its type
+} ReadingRun;
+
+// Block kernels for one element type. Every function takes 1 <= n <= BLOCK_SIZE
+// contiguous, aligned, native-order readings.
+typedef struct {
+    double (*block_min)(const void *data, npy_intp n);
+    double (*block_max)(const void *data, npy_intp n);
+    double (*block_sum)(const void *data, npy_intp n);
+    void (*block_moments)(const void *data, npy_intp n, TempMoments *out);
+} BlockKernels;
+
+// One implementation of the block kernels.
+typedef struct {
+    const char *name;
+    BlockKernels f32;
+    BlockKernels f64;
+} StatsKernels;
+
+// Kernels selected by stats_kernels_init(); scalar until then.
+extern const StatsKernels *stats_kernels;
+
+// Selects the widest instruction set supported by the CPU. `requested` (may be NULL)
+// names an instruction set to use instead ("scalar", "sse2", "avx2" or "avx512");
+// it is ignored if the CPU does not support it. Returns the selected kernels.
+const StatsKernels *stats_kernels_init(const char *requested);
+
+// Which statistic a reduction computes. REDUCE_MIN, REDUCE_MAX and REDUCE_SUM only
+// fill in `count` and their own field of TempMoments; REDUCE_MOMENTS fills in all.
+typedef enum {
+    REDUCE_MIN,
+    REDUCE_MAX,
+    REDUCE_SUM,
+    REDUCE_MOMENTS
+} ReduceKind;
+
+// Converts `n` readings starting at `p`, `stride` bytes apart, to doubles in `out`.
+// Handles any alignment and byte order.
+void load_readings(ReadingType type, int swapped, const char *p, npy_intp stride, npy_intp n, double *out);
+
+// Sets `moments` to the statistics of no readings.
+void init_moments(TempMoments *moments);
+
+// Reduces a run and folds the result into `acc`, which must have been initialised
+// with init_moments() (or hold the result of earlier runs). Runs of at least
+// PARALLEL_THRESHOLD readings are split across the thread pool. Never touches
+// Python objects, so it may be called without holding the GIL.
+void reduce_run(ReduceKind kind, const ReadingRun *run, TempMoments *acc);
+
+// A 2-D grid of readings reduced down its columns: each of the `columns` outputs
+// reduces `rows` readings. For numpy's `axis=k` of a 2-D array, rows run along
+// axis k and columns along the other axis.
+typedef struct {
+    const char *data;
+    npy_intp rows;
+    npy_intp columns;
+    npy_intp row_stride;    // bytes between consecutive readings of a column
+    npy_intp column_stride; // bytes between consecutive columns
+    ReadingType type;
+    int swapped;
+    int aligned;
+} ReadingGrid;
+
+// Computes the moments of every column of `grid` into out[0 .. columns).
+// Columns of at least BLOCK_SIZE readings that lie closer together in memory than
+// neighbouring columns are each reduced as a run (bit-identical to reducing the
+// column alone). Otherwise the grid is read row by row in cache-sized tiles,
+// updating every column of a tile at once, so row-major (samples x sensors) data is
+// streamed through exactly once; those results agree with per-column reductions to
+// rounding only. The work is
+// split across the thread pool. Returns -1 if out of memory, 0 otherwise.
+int reduce_columns(const ReadingGrid *grid, TempMoments *out);
+
+// Folds the moments of `part` into `acc` (Chan's update). Either may be empty.
+void merge_moments(TempMoments *acc, const TempMoments *part);
+
+#endif // STATS_KERNELS_H
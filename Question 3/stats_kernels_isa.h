@@ -0,0 +1,18 @@
+// Instantiates stats_kernels_simd.h for float32 and float64 readings with the
+// vector vocabulary of one instruction set (ISA_PREFIX, V_LOAD_F32, V_LOAD_F64, ...).
+
+#define TYPE_SUFFIX _f32
+#define READING_T float
+#define V_LOAD V_LOAD_F32
+#include "stats_kernels_simd.h"
+#undef V_LOAD
+#undef READING_T
+#undef TYPE_SUFFIX
+
+#define TYPE_SUFFIX _f64
+#define READING_T double
+#define V_LOAD V_LOAD_F64
+#include "stats_kernels_simd.h"
+#undef V_LOAD
+#undef READING_T
+#undef TYPE_SUFFIX
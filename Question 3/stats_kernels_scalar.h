@@ -0,0 +1,95 @@
+// Scalar reference kernels, included by stats_kernels.c once per element type.
+// The including file defines:
+//   READING_T      element type (float or double)
+//   TYPED(name)    function name for this element type
+// These helpers define the reference ordering documented in stats_kernels.h. The
+// vectorised kernels accumulate full groups of LANES readings in registers, store
+// their lanes and hand the tail of the block to the same finish_*() helpers, so
+// every instruction set performs exactly the same floating-point operations.
+
+// Each finish_*() accumulates readings [i, n) of the block into their lanes and
+// folds the lanes into the block result.
+
+static double TYPED(finish_min)(double lanes[LANES], const READING_T *data, npy_intp i, npy_intp n, int has_nan)
+{
+    for (; i < n; i++) {
+        has_nan |= isnan(data[i]);
+        lanes[i % LANES] = min_op(lanes[i % LANES], data[i]);
+    }
+    return has_nan ? NAN : fold_min(lanes);
+}
+
+static double TYPED(finish_max)(double lanes[LANES], const READING_T *data, npy_intp i, npy_intp n, int has_nan)
+{
+    for (; i < n; i++) {
+        has_nan |= isnan(data[i]);
+        lanes[i % LANES] = max_op(lanes[i % LANES], data[i]);
+    }
+    return has_nan ? NAN : fold_max(lanes);
+}
+
+static double TYPED(finish_sum)(double lanes[LANES], const READING_T *data, npy_intp i, npy_intp n)
+{
+    for (; i < n; i++) {
+        lanes[i % LANES] += data[i];
+    }
+    return fold_sum(lanes);
+}
+
+static void TYPED(finish_moments_pass1)(double lanes_min[LANES], double lanes_max[LANES], double lanes_sum[LANES],
+                                        const READING_T *data, npy_intp i, npy_intp n, int has_nan, TempMoments *out)
+{
+    for (; i < n; i++) {
+        has_nan |= isnan(data[i]);
+        lanes_min[i % LANES] = min_op(lanes_min[i % LANES], data[i]);
+        lanes_max[i % LANES] = max_op(lanes_max[i % LANES], data[i]);
+        lanes_sum[i % LANES] += data[i];
+    }
+    out->count = n;
+    out->min = has_nan ? NAN : fold_min(lanes_min);
+    out->max = has_nan ? NAN : fold_max(lanes_max);
+    out->sum = fold_sum(lanes_sum);
+    out->mean = out->sum / n;
+}
+
+static void TYPED(finish_moments_pass2)(double lanes_m2[LANES], const READING_T *data, npy_intp i, npy_intp n,
+                                        TempMoments *out)
+{
+    for (; i < n; i++) {
+        double diff = data[i] - out->mean;
+        lanes_m2[i % LANES] += diff * diff;
+    }
+    out->m2 = fold_sum(lanes_m2);
+}
+
+static double TYPED(scalar_block_min)(const void *data, npy_intp n)
+{
+    double lanes[LANES];
+    fill_lanes(lanes, INFINITY);
+    return TYPED(finish_min)(lanes, data, 0, n, 0);
+}
+
+static double TYPED(scalar_block_max)(const void *data, npy_intp n)
+{
+    double lanes[LANES];
+    fill_lanes(lanes, -INFINITY);
+    return TYPED(finish_max)(lanes, data, 0, n, 0);
+}
+
+static double TYPED(scalar_block_sum)(const void *data, npy_intp n)
+{
+    double lanes[LANES];
+    fill_lanes(lanes, 0.0);
+    return TYPED(finish_sum)(lanes, data, 0, n);
+}
+
+static void TYPED(scalar_block_moments)(const void *data, npy_intp n, TempMoments *out)
+{
+    double lanes_min[LANES], lanes_max[LANES], lanes_sum[LANES];
+    fill_lanes(lanes_min, INFINITY);
+    fill_lanes(lanes_max, -INFINITY);
+    fill_lanes(lanes_sum, 0.0);
+    TYPED(finish_moments_pass1)(lanes_min, lanes_max, lanes_sum, data, 0, n, 0, out);
+    fill_lanes(lanes_sum, 0.0);
+    TYPED(finish_moments_pass2)(lanes_sum, data, 0, n, out);
+}
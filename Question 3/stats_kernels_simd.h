@@ -0,0 +1,142 @@
+// Block kernels written once against a small vector vocabulary and included by
+// stats_kernels.c once per instruction set and element type. The including file defines:
+//   READING_T         element type (float or double)
+//   TYPED(name)       scalar helper name for this element type
+//   SIMD_FN(name)     function name for this instruction set and element type
+//   SIMD_TARGET       target attribute string
+//   V_TYPE, V_WIDTH   vector of V_WIDTH doubles
+//   V_LOAD(p)         loads V_WIDTH readings, widened to double
+//   V_SET1, V_ADD, V_SUB, V_MUL, V_MIN, V_MAX, V_STORE
+//   V_NAN_TYPE, V_NAN_INIT, V_NAN_ACC(m, v), V_NAN_ANY(m)
+// and the scalar helpers TYPED(finish_*)() that reduce the tail and fold the lanes.
+// Only the full groups of LANES readings are vectorised; lane r * V_WIDTH + k of
+// the group holds reading i + r * V_WIDTH + k, exactly as in the scalar reference.
+
+#define V_REGS (LANES / V_WIDTH)
+
+__attribute__((target(SIMD_TARGET)))
+static double SIMD_FN(block_min)(const void *readings, npy_intp n)
+{
+    const READING_T *data = readings;
+    V_TYPE acc[V_REGS];
+    V_NAN_TYPE nan_mask = V_NAN_INIT;
+    double lanes[LANES];
+    npy_intp i = 0;
+
+    for (int r = 0; r < V_REGS; r++) {
+        acc[r] = V_SET1(INFINITY);
+    }
+    for (; i + LANES <= n; i += LANES) {
+        for (int r = 0; r < V_REGS; r++) {
+            V_TYPE x = V_LOAD(data + i + r * V_WIDTH);
+            nan_mask = V_NAN_ACC(nan_mask, x);
+            acc[r] = V_MIN(acc[r], x);
+        }
+    }
+    for (int r = 0; r < V_REGS; r++) {
+        V_STORE(lanes + r * V_WIDTH, acc[r]);
+    }
+
+    return TYPED(finish_min)(lanes, data, i, n, V_NAN_ANY(nan_mask));
+}
+
+__attribute__((target(SIMD_TARGET)))
+static double SIMD_FN(block_max)(const void *readings, npy_intp n)
+{
+    const READING_T *data = readings;
+    V_TYPE acc[V_REGS];
+    V_NAN_TYPE nan_mask = V_NAN_INIT;
+    double lanes[LANES];
+    npy_intp i = 0;
+
+    for (int r = 0; r < V_REGS; r++) {
+        acc[r] = V_SET1(-INFINITY);
+    }
+    for (; i + LANES <= n; i += LANES) {
+        for (int r = 0; r < V_REGS; r++) {
+            V_TYPE x = V_LOAD(data + i + r * V_WIDTH);
+            nan_mask = V_NAN_ACC(nan_mask, x);
+            acc[r] = V_MAX(acc[r], x);
+        }
+    }
+    for (int r = 0; r < V_REGS; r++) {
+        V_STORE(lanes + r * V_WIDTH, acc[r]);
+    }
+
+    return TYPED(finish_max)(lanes, data, i, n, V_NAN_ANY(nan_mask));
+}
+
+__attribute__((target(SIMD_TARGET)))
+static double SIMD_FN(block_sum)(const void *readings, npy_intp n)
+{
+    const READING_T *data = readings;
+    V_TYPE acc[V_REGS];
+    double lanes[LANES];
+    npy_intp i = 0;
+
+    for (int r = 0; r < V_REGS; r++) {
+        acc[r] = V_SET1(0.0);
+    }
+    for (; i + LANES <= n; i += LANES) {
+        for (int r = 0; r < V_REGS; r++) {
+            acc[r] = V_ADD(acc[r], V_LOAD(data + i + r * V_WIDTH));
+        }
+    }
+    for (int r = 0; r < V_REGS; r++) {
+        V_STORE(lanes + r * V_WIDTH, acc[r]);
+    }
+
+    return TYPED(finish_sum)(lanes, data, i, n);
+}
+
+__attribute__((target(SIMD_TARGET)))
+static void SIMD_FN(block_moments)(const void *readings, npy_intp n, TempMoments *out)
+{
+    const READING_T *data = readings;
+    V_TYPE acc_min[V_REGS], acc_max[V_REGS], acc_sum[V_REGS];
+    V_NAN_TYPE nan_mask = V_NAN_INIT;
+    double lanes_min[LANES], lanes_max[LANES], lanes_sum[LANES];
+    npy_intp i = 0;
+
+    // Pass 1: min, max and sum
+    for (int r = 0; r < V_REGS; r++) {
+        acc_min[r] = V_SET1(INFINITY);
+        acc_max[r] = V_SET1(-INFINITY);
+        acc_sum[r] = V_SET1(0.0);
+    }
+    for (; i + LANES <= n; i += LANES) {
+        for (int r = 0; r < V_REGS; r++) {
+            V_TYPE x = V_LOAD(data + i + r * V_WIDTH);
+            nan_mask = V_NAN_ACC(nan_mask, x);
+            acc_min[r] = V_MIN(acc_min[r], x);
+            acc_max[r] = V_MAX(acc_max[r], x);
+            acc_sum[r] = V_ADD(acc_sum[r], x);
+        }
+    }
+    for (int r = 0; r < V_REGS; r++) {
+        V_STORE(lanes_min + r * V_WIDTH, acc_min[r]);
+        V_STORE(lanes_max + r * V_WIDTH, acc_max[r]);
+        V_STORE(lanes_sum + r * V_WIDTH, acc_sum[r]);
+    }
+    TYPED(finish_moments_pass1)(lanes_min, lanes_max, lanes_sum, data, i, n, V_NAN_ANY(nan_mask), out);
+
+    // Pass 2: squared deviations from the block mean (served from cache)
+    V_TYPE mean = V_SET1(out->mean);
+    double lanes_m2[LANES];
+    i = 0;
+    for (int r = 0; r < V_REGS; r++) {
+        acc_sum[r] = V_SET1(0.0);
+    }
+    for (; i + LANES <= n; i += LANES) {
+        for (int r = 0; r < V_REGS; r++) {
+            V_TYPE diff = V_SUB(V_LOAD(data + i + r * V_WIDTH), mean);
+            acc_sum[r] = V_ADD(acc_sum[r], V_MUL(diff, diff));
+        }
+    }
+    for (int r = 0; r < V_REGS; r++) {
+        V_STORE(lanes_m2 + r * V_WIDTH, acc_sum[r]);
+    }
+    TYPED(finish_moments_pass2)(lanes_m2, data, i, n, out);
+}
+
+#undef V_REGS
@@ -1,19 +1,261 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
+#include <pythread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+#include "rolling_stats.h"
+#include "sketches.h"
+#include "stats_kernels.h"
+#include "thread_pool.h"
+
+// Maps a dtype to the element type the kernels read.
+// Returns -1 with a TypeError set if the dtype is not supported.
+static int descr_reading_type(PyArray_Descr *descr, ReadingType *type)
+{
+    switch (descr->type_num) {
+    case NPY_FLOAT32:
+        *type = READING_FLOAT32;
+        return 0;
+    case NPY_FLOAT64:
+        *type = READING_FLOAT64;
+        return 0;
+    case NPY_INT16:
+        *type = READING_INT16;
+        return 0;
+    default:
+        PyErr_Format(PyExc_TypeError, "Unsupported dtype %R: expected float32, float64 or int16", (PyObject *)descr);
+        return -1;
+    }
+}
+
+// Maps the dtype of `in_array` to the element type the kernels read.
+// Returns -1 with a TypeError set if the dtype is not supported.
+static int reading_type(PyArrayObject *in_array, ReadingType *type)
+{
+    return descr_reading_type(PyArray_DESCR(in_array), type);
+}
+
+// Called for each run of a NumPy array, without the GIL. Returns -1 if out of memory.
+typedef int (*RunVisitor)(const ReadingRun *run, void *ctx);
+
+// Calls `visit` on every reading of a non-empty `in_array` without copying it.
+// A NumPy iterator walks the array in memory order; each of its inner loops is one
+// run (a single run for contiguous arrays and strided 1-D views such as a column of
+// a 2-D array). Byte-swapped and unaligned arrays are handled by the kernels.
+// The GIL is released while visiting. Returns -1 with an exception set on failure.
+static int visit_runs(PyArrayObject *in_array, RunVisitor visit, void *ctx)
+{
+    ReadingRun run;
+
+    if (reading_type(in_array, &run.type) < 0) {
+        return -1;
+    }
+    run.swapped = !PyArray_ISNOTSWAPPED(in_array);
+    run.aligned = PyArray_ISALIGNED(in_array);
+
+    NpyIter *iter = NpyIter_New(in_array, NPY_ITER_READONLY | NPY_ITER_EXTERNAL_LOOP,
+                                NPY_KEEPORDER, NPY_NO_CASTING, NULL);
+    if (iter == NULL) {
+        return -1;
+    }
+    NpyIter_IterNextFunc *iternext = NpyIter_GetIterNext(iter, NULL);
+    if (iternext == NULL) {
+        NpyIter_Deallocate(iter);
+        return -1;
+    }
+    char **dataptr = NpyIter_GetDataPtrArray(iter);
+    npy_intp *strideptr = NpyIter_GetInnerStrideArray(iter);
+    npy_intp *sizeptr = NpyIter_GetInnerLoopSizePtr(iter);
+
+    int status = 0;
+    Py_BEGIN_ALLOW_THREADS
+    do {
+        run.data = dataptr[0];
+        run.stride = strideptr[0];
+        run.count = *sizeptr;
+        status = visit(&run, ctx);
+    } while (status == 0 && iternext(iter));
+    Py_END_ALLOW_THREADS
+
+    NpyIter_Deallocate(iter);
+    if (status < 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    ReduceKind kind;
+    TempMoments *acc;
+} ReduceVisit;
+
+static int reduce_visitor(const ReadingRun *run, void *ctx)
+{
+    ReduceVisit *visit = (ReduceVisit *)ctx;
+
+    reduce_run(visit->kind, run, visit->acc);
+    return 0;
+}
+
+// Reduces every reading of a non-empty `in_array` into `acc` (see visit_runs()).
+// Returns -1 with an exception set on failure.
+static int reduce_array(PyArrayObject *in_array, ReduceKind kind, TempMoments *acc)
+{
+    ReduceVisit visit = {kind, acc};
+
+    init_moments(acc);
+    return visit_runs(in_array, reduce_visitor, &visit);
+}
+
+// Parses the optional `axis` argument of a reduction. Returns 1 and stores the axis
+// (made non-negative) in `axis` if one was given for a 2-D array, 0 if the whole
+// array is to be reduced (axis is None, or the array is 1-D), and -1 with an
+// exception set if the axis is invalid.
+static int parse_axis(PyArrayObject *in_array, PyObject *axis_obj, int *axis)
+{
+    if (axis_obj == NULL || axis_obj == Py_None) {
+        return 0;
+    }
+
+    long value = PyLong_AsLong(axis_obj);
+    if (value == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+
+    int ndim = PyArray_NDIM(in_array);
+    if (value < -ndim || value >= ndim) {
+        PyErr_Format(PyExc_ValueError, "axis %ld is out of bounds for array of dimension %d", value, ndim);
+        return -1;
+    }
+    if (ndim > 2) {
+        PyErr_SetString(PyExc_ValueError, "axis reductions support 1-D and 2-D arrays");
+        return -1;
+    }
+
+    *axis = (int)(value < 0 ? value + ndim : value);
+    return ndim == 2;
+}
+
+// Reduces a non-empty 2-D `in_array` along `axis`, returning the moments of each of
+// its `*num_columns` lanes along the other axis (free with PyMem_RawFree). Each
+// lane is a strided run over the array's own memory; see reduce_columns().
+// The GIL is released while reducing. Returns NULL with an exception set on failure.
+static TempMoments *reduce_axis(PyArrayObject *in_array, int axis, npy_intp *num_columns)
+{
+    ReadingGrid grid;
+
+    if (reading_type(in_array, &grid.type) < 0) {
+        return NULL;
+    }
+    grid.swapped = !PyArray_ISNOTSWAPPED(in_array);
+    grid.aligned = PyArray_ISALIGNED(in_array);
+    grid.data = PyArray_BYTES(in_array);
+    grid.rows = PyArray_DIM(in_array, axis);
+    grid.columns = PyArray_DIM(in_array, 1 - axis);
+    grid.row_stride = PyArray_STRIDE(in_array, axis);
+    grid.column_stride = PyArray_STRIDE(in_array, 1 - axis);
+
+    TempMoments *moments = PyMem_RawMalloc(grid.columns * sizeof(TempMoments));
+    if (moments == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = reduce_columns(&grid, moments);
+    Py_END_ALLOW_THREADS
+
+    if (status < 0) {
+        PyMem_RawFree(moments);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    *num_columns = grid.columns;
+    return moments;
+}
+
+typedef double (*MomentsField)(const TempMoments *moments);
+
+static double moments_min(const TempMoments *moments)
+{
+    return moments->min;
+}
+
+static double moments_max(const TempMoments *moments)
+{
+    return moments->max;
+}
+
+static double moments_mean(const TempMoments *moments)
+{
+    return moments->sum / moments->count;
+}
+
+static double moments_variance(const TempMoments *moments)
+{
+    return moments->count > 1 ? moments->m2 / (moments->count - 1) : Py_NAN;
+}
+
+// Returns a new float64 array holding `field` of each of the `n` moments.
+static PyObject *moments_array(const TempMoments *moments, npy_intp n, MomentsField field)
+{
+    PyObject *result = PyArray_SimpleNew(1, &n, NPY_FLOAT64);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    double *out = PyArray_DATA((PyArrayObject *)result);
+    for (npy_intp i = 0; i < n; i++) {
+        out[i] = field(&moments[i]);
+    }
+    return result;
+}
+
+// Reduces `in_array` along `axis` and returns `field` of every result as an array.
+static PyObject *axis_statistic(PyArrayObject *in_array, int axis, MomentsField field)
+{
+    npy_intp num_columns;
+    TempMoments *moments = reduce_axis(in_array, axis, &num_columns);
+    if (moments == NULL) {
+        return NULL;
+    }
+
+    PyObject *result = moments_array(moments, num_columns, field);
+    PyMem_RawFree(moments);
+    return result;
+}
 
 // Documentation for min_temp:
-// How it works: Iterates through the NumPy array of float temperatures and finds the minimum value.
+// How it works: Iterates through the NumPy array of temperatures (float32, float64 or int16, any strides) and finds the minimum value.
+//   The loop runs on the widest SIMD kernel the CPU supports (see stats_kernels.h); a NaN reading yields NaN.
+//   With axis=0 or axis=1 a 2-D array is reduced along that axis into a float64 array.
 // Memory usage considerations: It operates directly on the input NumPy array, avoiding extra memory allocation for data copying.
 // Time complexity: O(n), where n is the number of temperature readings, as it iterates through the array once.
-static PyObject *min_temp(PyObject *self, PyObject *args)
+static PyObject *min_temp(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+    static char *kwlist[] = {"arr", "axis", NULL};
     PyArrayObject *in_array;
+    PyObject *axis_obj = Py_None;
+    int axis;
 
-    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwlist, &PyArray_Type, &in_array, &axis_obj)) {
+        return NULL;
+    }
+
+    int has_axis = parse_axis(in_array, axis_obj, &axis);
+    if (has_axis < 0) {
         return NULL;
     }
 
-    float *data = (float *)PyArray_DATA(in_array);
     npy_intp num_readings = PyArray_SIZE(in_array);
 
     if (num_readings == 0) {
@@ -21,29 +263,40 @@ static PyObject *min_temp(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    float min_val = data[0];
-    for (npy_intp i = 1; i < num_readings; i++) {
-        if (data[i] < min_val) {
-            min_val = data[i];
-        }
+    if (has_axis) {
+        return axis_statistic(in_array, axis, moments_min);
+    }
+
+    TempMoments moments;
+    if (reduce_array(in_array, REDUCE_MIN, &moments) < 0) {
+        return NULL;
     }
 
-    return PyFloat_FromDouble(min_val);
+    return PyFloat_FromDouble(moments.min);
 }
 
 // Documentation for max_temp:
-// How it works: Iterates through the NumPy array of float temperatures and finds the maximum value.
+// How it works: Iterates through the NumPy array of temperatures (float32, float64 or int16, any strides) and finds the maximum value.
+//   The loop runs on the widest SIMD kernel the CPU supports (see stats_kernels.h); a NaN reading yields NaN.
+//   With axis=0 or axis=1 a 2-D array is reduced along that axis into a float64 array.
 // Memory usage considerations: It operates directly on the input NumPy array, avoiding extra memory allocation for data copying.
 // Time complexity: O(n), where n is the number of temperature readings, as it iterates through the array once.
-static PyObject *max_temp(PyObject *self, PyObject *args)
+static PyObject *max_temp(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+    static char *kwlist[] = {"arr", "axis", NULL};
     PyArrayObject *in_array;
+    PyObject *axis_obj = Py_None;
+    int axis;
 
-    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwlist, &PyArray_Type, &in_array, &axis_obj)) {
+        return NULL;
+    }
+
+    int has_axis = parse_axis(in_array, axis_obj, &axis);
+    if (has_axis < 0) {
         return NULL;
     }
 
-    float *data = (float *)PyArray_DATA(in_array);
     npy_intp num_readings = PyArray_SIZE(in_array);
 
     if (num_readings == 0) {
@@ -51,29 +304,40 @@ static PyObject *max_temp(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    float max_val = data[0];
-    for (npy_intp i = 1; i < num_readings; i++) {
-        if (data[i] > max_val) {
-            max_val = data[i];
-        }
+    if (has_axis) {
+        return axis_statistic(in_array, axis, moments_max);
+    }
+
+    TempMoments moments;
+    if (reduce_array(in_array, REDUCE_MAX, &moments) < 0) {
+        return NULL;
     }
 
-    return PyFloat_FromDouble(max_val);
+    return PyFloat_FromDouble(moments.max);
 }
 
 // Documentation for avg_temp:
 // How it works: Calculates the sum of all temperature readings and divides by the total number of readings.
+//   The sum uses 16 independent double-precision accumulators in the reference ordering described in stats_kernels.h.
+//   With axis=0 or axis=1 a 2-D array is reduced along that axis into a float64 array.
 // Memory usage considerations: It operates directly on the input NumPy array, avoiding extra memory allocation for data copying.
 // Time complexity: O(n), where n is the number of temperature readings, as it iterates through the array once.
-static PyObject *avg_temp(PyObject *self, PyObject *args)
+static PyObject *avg_temp(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+    static char *kwlist[] = {"arr", "axis", NULL};
     PyArrayObject *in_array;
+    PyObject *axis_obj = Py_None;
+    int axis;
 
-    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwlist, &PyArray_Type, &in_array, &axis_obj)) {
+        return NULL;
+    }
+
+    int has_axis = parse_axis(in_array, axis_obj, &axis);
+    if (has_axis < 0) {
         return NULL;
     }
 
-    float *data = (float *)PyArray_DATA(in_array);
     npy_intp num_readings = PyArray_SIZE(in_array);
 
     if (num_readings == 0) {
@@ -81,73 +345,952 @@ static PyObject *avg_temp(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    double sum = 0.0;
-    for (npy_intp i = 0; i < num_readings; i++) {
-        sum += data[i];
+    if (has_axis) {
+        return axis_statistic(in_array, axis, moments_mean);
+    }
+
+    TempMoments moments;
+    if (reduce_array(in_array, REDUCE_SUM, &moments) < 0) {
+        return NULL;
     }
 
-    return PyFloat_FromDouble(sum / num_readings);
+    return PyFloat_FromDouble(moments.sum / num_readings);
 }
 
 // Documentation for variance_temp:
-// How it works: Calculates the sample variance using the formula: sum((x_i - mean)^2) / (n - 1).
+// How it works: Calculates the sample variance sum((x_i - mean)^2) / (n - 1) with the fused block kernel, combining per-block results with Chan's update.
+//   With axis=0 or axis=1 a 2-D array is reduced along that axis into a float64 array.
 // Memory usage considerations: It operates directly on the input NumPy array, avoiding extra memory allocation for data copying.
-// Time complexity: O(n), where n is the number of temperature readings, as it iterates through the array twice (once for mean, once for sum of squares).
-static PyObject *variance_temp(PyObject *self, PyObject *args)
+// Time complexity: O(n), where n is the number of temperature readings, as it streams through the array once.
+static PyObject *variance_temp(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+    static char *kwlist[] = {"arr", "axis", NULL};
     PyArrayObject *in_array;
+    PyObject *axis_obj = Py_None;
+    int axis;
 
-    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwlist, &PyArray_Type, &in_array, &axis_obj)) {
         return NULL;
     }
 
-    float *data = (float *)PyArray_DATA(in_array);
-    npy_intp num_readings = PyArray_SIZE(in_array);
+    int has_axis = parse_axis(in_array, axis_obj, &axis);
+    if (has_axis < 0) {
+        return NULL;
+    }
+
+    npy_intp num_readings = has_axis ? PyArray_DIM(in_array, axis) : PyArray_SIZE(in_array);
 
     if (num_readings < 2) {
         PyErr_SetString(PyExc_ValueError, "At least two readings are required to compute variance");
         return NULL;
     }
 
-    // Calculate mean first
-    double sum = 0.0;
-    for (npy_intp i = 0; i < num_readings; i++) {
-        sum += data[i];
+    if (has_axis) {
+        return axis_statistic(in_array, axis, moments_variance);
     }
-    double mean = sum / num_readings;
 
-    // Calculate sum of squared differences for variance
-    double sum_sq_diff = 0.0;
-    for (npy_intp i = 0; i < num_readings; i++) {
-        sum_sq_diff += (data[i] - mean) * (data[i] - mean);
+    TempMoments moments;
+    if (reduce_array(in_array, REDUCE_MOMENTS, &moments) < 0) {
+        return NULL;
     }
 
-    return PyFloat_FromDouble(sum_sq_diff / (num_readings - 1));
+    return PyFloat_FromDouble(moments.m2 / (num_readings - 1));
 }
 
 // Documentation for count_readings:
-// How it works: Returns the total number of elements in the input NumPy array.
+// How it works: Returns the total number of elements in the input NumPy array, or its length along `axis` if one is given.
 // Memory usage considerations: It operates directly on the input NumPy array, avoiding extra memory allocation for data copying.
 // Time complexity: O(1), as it directly accesses the size information from the NumPy array object.
-static PyObject *count_readings(PyObject *self, PyObject *args)
+static PyObject *count_readings(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+    static char *kwlist[] = {"arr", "axis", NULL};
     PyArrayObject *in_array;
+    PyObject *axis_obj = Py_None;
+    int axis;
 
-    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwlist, &PyArray_Type, &in_array, &axis_obj)) {
         return NULL;
     }
 
-    npy_intp num_readings = PyArray_SIZE(in_array);
+    int has_axis = parse_axis(in_array, axis_obj, &axis);
+    if (has_axis < 0) {
+        return NULL;
+    }
+
+    npy_intp num_readings = has_axis ? PyArray_DIM(in_array, axis) : PyArray_SIZE(in_array);
 
     return PyLong_FromSsize_t(num_readings);
 }
 
+static PyStructSequence_Field summary_fields[] = {
+    {"count", "Number of readings"},
+    {"min", "Minimum temperature"},
+    {"max", "Maximum temperature"},
+    {"mean", "Average (mean) temperature"},
+    {"variance", "Sample variance (NaN for a single reading)"},
+    {NULL, NULL}
+};
+
+static PyStructSequence_Desc summary_desc = {
+    "temp_stats.Summary",
+    "Statistics of a set of temperature readings, as returned by summary().",
+    summary_fields,
+    5
+};
+
+static PyTypeObject SummaryType;
+
+// Builds the Summary of non-empty `moments`.
+static PyObject *summary_of(const TempMoments *moments)
+{
+    PyObject *result = PyStructSequence_New(&SummaryType);
+    if (result == NULL) {
+        return NULL;
+    }
+    PyStructSequence_SET_ITEM(result, 0, PyLong_FromSsize_t(moments->count));
+    PyStructSequence_SET_ITEM(result, 1, PyFloat_FromDouble(moments->min));
+    PyStructSequence_SET_ITEM(result, 2, PyFloat_FromDouble(moments->max));
+    PyStructSequence_SET_ITEM(result, 3, PyFloat_FromDouble(moments_mean(moments)));
+    PyStructSequence_SET_ITEM(result, 4, PyFloat_FromDouble(moments_variance(moments)));
+    if (PyErr_Occurred()) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+// Builds the Summary of `in_array` reduced along `axis`: the count of readings per
+// lane and one float64 array per statistic.
+static PyObject *axis_summary(PyArrayObject *in_array, int axis)
+{
+    npy_intp num_columns;
+    TempMoments *moments = reduce_axis(in_array, axis, &num_columns);
+    if (moments == NULL) {
+        return NULL;
+    }
+
+    PyObject *result = PyStructSequence_New(&SummaryType);
+    if (result == NULL) {
+        PyMem_RawFree(moments);
+        return NULL;
+    }
+    PyStructSequence_SET_ITEM(result, 0, PyLong_FromSsize_t(PyArray_DIM(in_array, axis)));
+    PyStructSequence_SET_ITEM(result, 1, moments_array(moments, num_columns, moments_min));
+    PyStructSequence_SET_ITEM(result, 2, moments_array(moments, num_columns, moments_max));
+    PyStructSequence_SET_ITEM(result, 3, moments_array(moments, num_columns, moments_mean));
+    PyStructSequence_SET_ITEM(result, 4, moments_array(moments, num_columns, moments_variance));
+    PyMem_RawFree(moments);
+    if (PyErr_Occurred()) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+// Documentation for summary:
+// How it works: Computes count, minimum, maximum, mean and sample variance in a single streaming pass.
+//   The array is processed in cache-sized blocks; each block's moments are combined into the running totals with Chan's update.
+//   With axis=0 or axis=1 every statistic except count is a float64 array over the other axis of a 2-D array;
+//   row-major data is streamed through once in cache-sized tiles rather than one strided column at a time.
+// Memory usage considerations: It operates directly on the input NumPy array; the only extra state is a fixed-size accumulator.
+// Time complexity: O(n), where n is the number of temperature readings, reading each element from memory exactly once.
+static PyObject *summary(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"arr", "axis", NULL};
+    PyArrayObject *in_array;
+    PyObject *axis_obj = Py_None;
+    int axis;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwlist, &PyArray_Type, &in_array, &axis_obj)) {
+        return NULL;
+    }
+
+    int has_axis = parse_axis(in_array, axis_obj, &axis);
+    if (has_axis < 0) {
+        return NULL;
+    }
+
+    npy_intp num_readings = PyArray_SIZE(in_array);
+
+    if (num_readings == 0) {
+        PyErr_SetString(PyExc_ValueError, "Input array cannot be empty");
+        return NULL;
+    }
+
+    if (has_axis) {
+        return axis_summary(in_array, axis);
+    }
+
+    TempMoments moments;
+    if (reduce_array(in_array, REDUCE_MOMENTS, &moments) < 0) {
+        return NULL;
+    }
+
+    return summary_of(&moments);
+}
+
+// Documentation for summary_file:
+// How it works: Computes the same Summary as summary() over a raw binary file of readings (e.g. a sensor dump),
+//   without loading it into NumPy. `dtype` (float32 by default, float64 or int16, either byte order) describes the
+//   readings and `offset` skips a header. The file is memory-mapped a window at a time with MADV_SEQUENTIAL and the
+//   next window is read ahead while the current one is reduced; the GIL is released throughout. The result is
+//   bit-identical to summary(numpy.fromfile(path, dtype, offset=offset)).
+// Memory usage considerations: Only about one window (32 segments of readings) is resident at a time, however large the file.
+// Time complexity: O(n), where n is the number of readings in the file, reading each byte of the file once.
+static PyObject *summary_file(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"path", "dtype", "offset", NULL};
+    PyObject *path;
+    PyArray_Descr *descr = NULL;
+    long long offset = 0;
+    ReadingType type;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|O&L", kwlist, PyUnicode_FSConverter, &path,
+                                     PyArray_DescrConverter2, &descr, &offset)) {
+        return NULL;
+    }
+    if (descr == NULL) {
+        descr = PyArray_DescrFromType(NPY_FLOAT32);
+    }
+
+    PyObject *result = NULL;
+    if (descr_reading_type(descr, &type) < 0) {
+        goto done;
+    }
+    if (offset < 0) {
+        PyErr_SetString(PyExc_ValueError, "Offset cannot be negative");
+        goto done;
+    }
+
+    size_t item_size = PyDataType_ELSIZE(descr);
+    int swapped = !PyArray_ISNBO(descr->byteorder);
+    struct stat st;
+    int fd, error = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    fd = open(PyBytes_AS_STRING(path), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        error = errno;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (error != 0) {
+        errno = error;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path));
+        goto close;
+    }
+    if (offset > st.st_size) {
+        PyErr_SetString(PyExc_ValueError, "Offset is past the end of the file");
+        goto close;
+    }
+    if ((st.st_size - offset) % item_size != 0) {
+        PyErr_Format(PyExc_ValueError, "File size minus offset is not a whole number of %zu-byte readings", item_size);
+        goto close;
+    }
+
+    npy_intp count = (npy_intp)((st.st_size - offset) / item_size);
+    if (count == 0) {
+        PyErr_SetString(PyExc_ValueError, "File contains no readings");
+        goto close;
+    }
+
+    TempMoments moments;
+    init_moments(&moments);
+    Py_BEGIN_ALLOW_THREADS
+    error = reduce_file(fd, (off_t)offset, count, item_size, type, swapped, REDUCE_MOMENTS, &moments);
+    Py_END_ALLOW_THREADS
+
+    if (error != 0) {
+        errno = error;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path));
+        goto close;
+    }
+    result = summary_of(&moments);
+
+close:
+    if (fd >= 0) {
+        close(fd);
+    }
+done:
+    Py_DECREF(descr);
+    Py_DECREF(path);
+    return result;
+}
+
+// Describes a 1-D `in_array` as a single run of readings.
+// Returns -1 with an exception set if it has another shape or an unsupported dtype.
+static int array_run(PyArrayObject *in_array, ReadingRun *run)
+{
+    if (PyArray_NDIM(in_array) != 1) {
+        PyErr_SetString(PyExc_ValueError, "Moving statistics require a 1-D array");
+        return -1;
+    }
+    if (reading_type(in_array, &run->type) < 0) {
+        return -1;
+    }
+    run->data = PyArray_BYTES(in_array);
+    run->count = PyArray_DIM(in_array, 0);
+    run->stride = PyArray_STRIDE(in_array, 0);
+    run->swapped = !PyArray_ISNOTSWAPPED(in_array);
+    run->aligned = PyArray_ISALIGNED(in_array);
+    return 0;
+}
+
+// Documentation for rolling_summary:
+// How it works: Returns a Summary whose min, max, mean and variance are arrays holding the statistics of every window of
+//   `window` consecutive readings (element j covers readings j .. j + window - 1). Rolling min/max use monotonic deques and
+//   the mean/variance are slid one reading at a time (re-anchored exactly once per window), so the whole series costs O(n).
+// Memory usage considerations: Besides the four result arrays, only O(window) state is kept; the input is read in place.
+// Time complexity: O(n), independent of the window length.
+static PyObject *rolling_summary(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"arr", "window", NULL};
+    PyArrayObject *in_array;
+    Py_ssize_t window;
+    ReadingRun run;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!n", kwlist, &PyArray_Type, &in_array, &window)) {
+        return NULL;
+    }
+
+    if (array_run(in_array, &run) < 0) {
+        return NULL;
+    }
+
+    if (window < 1 || window > run.count) {
+        PyErr_SetString(PyExc_ValueError, "Window must be between 1 and the number of readings");
+        return NULL;
+    }
+
+    npy_intp num_windows = run.count - window + 1;
+    PyObject *result = PyStructSequence_New(&SummaryType);
+    if (result == NULL) {
+        return NULL;
+    }
+    PyStructSequence_SET_ITEM(result, 0, PyLong_FromSsize_t(window));
+    for (int field = 1; field < 5; field++) {
+        PyStructSequence_SET_ITEM(result, field, PyArray_SimpleNew(1, &num_windows, NPY_FLOAT64));
+    }
+    if (PyErr_Occurred()) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    double *out[4];
+    for (int field = 1; field < 5; field++) {
+        out[field - 1] = PyArray_DATA((PyArrayObject *)PyStructSequence_GET_ITEM(result, field));
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = rolling_stats(&run, window, out[0], out[1], out[2], out[3]);
+    Py_END_ALLOW_THREADS
+
+    if (status < 0) {
+        Py_DECREF(result);
+        return PyErr_NoMemory();
+    }
+
+    return result;
+}
+
+// Documentation for ewma:
+// How it works: Returns a (mean, variance) pair of arrays with the exponentially weighted moving mean and variance after
+//   every reading; `alpha` is the weight of the newest reading. A NaN reading is skipped and yields NaN at its position.
+// Memory usage considerations: Besides the two result arrays, only the running mean and variance are kept.
+// Time complexity: O(n), where n is the number of temperature readings.
+static PyObject *ewma(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"arr", "alpha", NULL};
+    PyArrayObject *in_array;
+    double alpha;
+    ReadingRun run;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!d", kwlist, &PyArray_Type, &in_array, &alpha)) {
+        return NULL;
+    }
+
+    if (array_run(in_array, &run) < 0) {
+        return NULL;
+    }
+
+    if (!(alpha > 0.0 && alpha <= 1.0)) {
+        PyErr_SetString(PyExc_ValueError, "Alpha must be in (0, 1]");
+        return NULL;
+    }
+
+    PyObject *mean = PyArray_SimpleNew(1, &run.count, NPY_FLOAT64);
+    PyObject *variance = PyArray_SimpleNew(1, &run.count, NPY_FLOAT64);
+    if (mean == NULL || variance == NULL) {
+        Py_XDECREF(mean);
+        Py_XDECREF(variance);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ewma_stats(&run, alpha, PyArray_DATA((PyArrayObject *)mean), PyArray_DATA((PyArrayObject *)variance));
+    Py_END_ALLOW_THREADS
+
+    return Py_BuildValue("(NN)", mean, variance);
+}
+
+// Accumulator: running statistics over readings that arrive in chunks.
+// The state is a single TempMoments, so updating costs only the new chunk and the
+// object stays the same size however many readings it has seen.
+typedef struct {
+    PyObject_HEAD
+    TempMoments moments;
+} AccumulatorObject;
+
+static PyTypeObject AccumulatorType;
+
+static PyObject *Accumulator_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (PyTuple_GET_SIZE(args) > 0 || (kwargs != NULL && PyDict_GET_SIZE(kwargs) > 0)) {
+        PyErr_SetString(PyExc_TypeError, "Accumulator() takes no arguments");
+        return NULL;
+    }
+
+    AccumulatorObject *self = (AccumulatorObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    init_moments(&self->moments);
+    return (PyObject *)self;
+}
+
+// Documentation for Accumulator.update:
+// How it works: Reduces the chunk with the same kernels as summary() and folds its moments into the running state with Chan's update.
+//   The chunk is reduced into a local result with the GIL released and merged only once the GIL is held again,
+//   so concurrent updates of one accumulator from several threads are safe. An empty chunk is ignored.
+// Memory usage considerations: It operates directly on the chunk; the accumulator's state does not grow.
+// Time complexity: O(k), where k is the number of readings in the chunk.
+static PyObject *Accumulator_update(AccumulatorObject *self, PyObject *args)
+{
+    PyArrayObject *in_array;
+    ReadingType type;
+
+    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+        return NULL;
+    }
+
+    if (reading_type(in_array, &type) < 0) {
+        return NULL;
+    }
+
+    if (PyArray_SIZE(in_array) > 0) {
+        TempMoments chunk;
+        if (reduce_array(in_array, REDUCE_MOMENTS, &chunk) < 0) {
+            return NULL;
+        }
+        merge_moments(&self->moments, &chunk);
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Documentation for Accumulator.merge:
+// How it works: Folds the state of another Accumulator (e.g. one unpickled from a worker process) into this one with Chan's update.
+//   The result matches a single accumulator that saw both streams of readings, up to rounding.
+// Time complexity: O(1).
+static PyObject *Accumulator_merge(AccumulatorObject *self, PyObject *args)
+{
+    AccumulatorObject *other;
+
+    if (!PyArg_ParseTuple(args, "O!", &AccumulatorType, &other)) {
+        return NULL;
+    }
+
+    TempMoments part = other->moments;
+    merge_moments(&self->moments, &part);
+
+    Py_RETURN_NONE;
+}
+
+// Documentation for Accumulator.result:
+// How it works: Returns the Summary (count, min, max, mean, variance) of every reading seen so far.
+// Time complexity: O(1).
+static PyObject *Accumulator_result(AccumulatorObject *self, PyObject *Py_UNUSED(args))
+{
+    if (self->moments.count == 0) {
+        PyErr_SetString(PyExc_ValueError, "No readings have been accumulated");
+        return NULL;
+    }
+
+    return summary_of(&self->moments);
+}
+
+// Pickles as Accumulator() plus a state tuple of the raw moments. Python floats
+// round-trip doubles exactly, so an unpickled accumulator is bit-identical.
+static PyObject *Accumulator_reduce(AccumulatorObject *self, PyObject *Py_UNUSED(args))
+{
+    const TempMoments *m = &self->moments;
+
+    return Py_BuildValue("O()(nddddd)", (PyObject *)Py_TYPE(self),
+                         m->count, m->min, m->max, m->sum, m->mean, m->m2);
+}
+
+static PyObject *Accumulator_setstate(AccumulatorObject *self, PyObject *state)
+{
+    TempMoments m;
+
+    if (!PyArg_ParseTuple(state, "nddddd;Accumulator state must be (count, min, max, sum, mean, m2)",
+                          &m.count, &m.min, &m.max, &m.sum, &m.mean, &m.m2)) {
+        return NULL;
+    }
+    if (m.count < 0) {
+        PyErr_SetString(PyExc_ValueError, "Accumulator count cannot be negative");
+        return NULL;
+    }
+
+    self->moments = m;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Accumulator_get_count(AccumulatorObject *self, void *Py_UNUSED(closure))
+{
+    return PyLong_FromSsize_t(self->moments.count);
+}
+
+static PyObject *Accumulator_repr(AccumulatorObject *self)
+{
+    return PyUnicode_FromFormat("temp_stats.Accumulator(count=%zd)", (Py_ssize_t)self->moments.count);
+}
+
+static PyMethodDef Accumulator_methods[] = {
+    {"update", (PyCFunction)Accumulator_update, METH_VARARGS, "Adds a chunk of readings to the running statistics."},
+    {"merge", (PyCFunction)Accumulator_merge, METH_VARARGS, "Adds the readings seen by another Accumulator."},
+    {"result", (PyCFunction)Accumulator_result, METH_NOARGS, "Returns the Summary of all readings seen so far."},
+    {"__reduce__", (PyCFunction)Accumulator_reduce, METH_NOARGS, "Supports pickling."},
+    {"__setstate__", (PyCFunction)Accumulator_setstate, METH_O, "Restores a pickled state."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef Accumulator_getset[] = {
+    {"count", (getter)Accumulator_get_count, NULL, "Number of readings seen so far.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject AccumulatorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "temp_stats.Accumulator",
+    .tp_basicsize = sizeof(AccumulatorObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Running count, min, max, mean and variance over readings that arrive in chunks.",
+    .tp_new = Accumulator_new,
+    .tp_repr = (reprfunc)Accumulator_repr,
+    .tp_methods = Accumulator_methods,
+    .tp_getset = Accumulator_getset,
+};
+
+// QuantileSketch: approximate quantiles in bounded memory (see sketches.h).
+// Updates reduce the chunk without the GIL; the per-object lock keeps concurrent
+// updates, merges and queries of one sketch from interleaving.
+typedef struct {
+    PyObject_HEAD
+    QuantileSketch sketch;
+    PyThread_type_lock lock;
+} QuantileSketchObject;
+
+static PyTypeObject QuantileSketchType;
+
+static QuantileSketchObject *new_sketch_object(PyTypeObject *type, double compression)
+{
+    QuantileSketchObject *self = (QuantileSketchObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    self->lock = PyThread_allocate_lock();
+    if (self->lock == NULL || sketch_init(&self->sketch, compression) < 0) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    return self;
+}
+
+static PyObject *QuantileSketch_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"compression", NULL};
+    double compression = 100.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|d:QuantileSketch", kwlist, &compression)) {
+        return NULL;
+    }
+
+    if (!(compression >= 10.0 && compression <= 10000.0)) {
+        PyErr_SetString(PyExc_ValueError, "Compression must be between 10 and 10000");
+        return NULL;
+    }
+
+    return (PyObject *)new_sketch_object(type, compression);
+}
+
+static void QuantileSketch_dealloc(QuantileSketchObject *self)
+{
+    sketch_free(&self->sketch);
+    if (self->lock != NULL) {
+        PyThread_free_lock(self->lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int sketch_visitor(const ReadingRun *run, void *ctx)
+{
+    return sketch_add_run((QuantileSketch *)ctx, run);
+}
+
+// Documentation for QuantileSketch.update:
+// How it works: Adds every reading of the chunk (float32, float64 or int16, any shape and strides) to the t-digest.
+//   Readings are buffered, sorted and merged into the centroids a buffer at a time; chunks of at least
+//   PARALLEL_THRESHOLD readings are sketched in pieces on the thread pool and merged. The GIL is released meanwhile.
+// Memory usage considerations: The sketch's memory is fixed when it is created (O(compression)), whatever the input size.
+// Time complexity: O(k log b), where k is the number of readings in the chunk and b the buffer size.
+static PyObject *QuantileSketch_update(QuantileSketchObject *self, PyObject *args)
+{
+    PyArrayObject *in_array;
+    ReadingType type;
+
+    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &in_array)) {
+        return NULL;
+    }
+
+    if (reading_type(in_array, &type) < 0) {
+        return NULL;
+    }
+    if (PyArray_SIZE(in_array) == 0) {
+        Py_RETURN_NONE;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    int status = visit_runs(in_array, sketch_visitor, &self->sketch);
+    PyThread_release_lock(self->lock);
+
+    if (status < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// Documentation for QuantileSketch.merge:
+// How it works: Adds the readings summarised by another sketch (e.g. one built by another thread, or unpickled from a
+//   worker process). The centroid lists are merged and re-compressed, so memory stays bounded.
+// Time complexity: O(c), where c is the number of centroids (at most about compression + 1 per sketch).
+static PyObject *QuantileSketch_merge(QuantileSketchObject *self, PyObject *args)
+{
+    QuantileSketchObject *other;
+
+    if (!PyArg_ParseTuple(args, "O!", &QuantileSketchType, &other)) {
+        return NULL;
+    }
+
+    // Lock the two sketches in address order, so a.merge(b) and b.merge(a) running
+    // at once cannot each hold one lock and wait for the other
+    QuantileSketchObject *first = (uintptr_t)self < (uintptr_t)other ? self : other;
+    QuantileSketchObject *second = first == self ? other : self;
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(first->lock, WAIT_LOCK);
+    if (second != first) {
+        PyThread_acquire_lock(second->lock, WAIT_LOCK);
+    }
+    Py_END_ALLOW_THREADS
+    sketch_merge(&self->sketch, &other->sketch);
+    if (second != first) {
+        PyThread_release_lock(second->lock);
+    }
+    PyThread_release_lock(first->lock);
+
+    Py_RETURN_NONE;
+}
+
+// Documentation for QuantileSketch.quantile:
+// How it works: Estimates the q-quantile (0 <= q <= 1) by interpolating between centroids; q may be a number
+//   (returns a float) or a sequence (returns a float64 array). Tail quantiles are the most accurate, and q = 0 and
+//   q = 1 give the exact min and max. Any NaN reading makes every quantile NaN, like numpy.percentile.
+// Time complexity: O(c) per quantile, where c is the number of centroids.
+static PyObject *QuantileSketch_quantile(QuantileSketchObject *self, PyObject *q_obj)
+{
+    PyArrayObject *q_array = (PyArrayObject *)PyArray_FROMANY(q_obj, NPY_FLOAT64, 0, 1, NPY_ARRAY_IN_ARRAY);
+    if (q_array == NULL) {
+        return NULL;
+    }
+
+    const double *q = PyArray_DATA(q_array);
+    npy_intp n = PyArray_SIZE(q_array);
+    for (npy_intp i = 0; i < n; i++) {
+        if (!(q[i] >= 0.0 && q[i] <= 1.0)) {
+            Py_DECREF(q_array);
+            PyErr_SetString(PyExc_ValueError, "Quantiles must be between 0 and 1");
+            return NULL;
+        }
+    }
+
+    PyObject *result = PyArray_SimpleNew(PyArray_NDIM(q_array), PyArray_DIMS(q_array), NPY_FLOAT64);
+    if (result == NULL) {
+        Py_DECREF(q_array);
+        return NULL;
+    }
+    double *out = PyArray_DATA((PyArrayObject *)result);
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    int empty = self->sketch.total_weight == 0.0 && !self->sketch.has_nan;
+    for (npy_intp i = 0; i < n && !empty; i++) {
+        out[i] = sketch_quantile(&self->sketch, q[i]);
+    }
+    PyThread_release_lock(self->lock);
+    Py_DECREF(q_array);
+
+    if (empty) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_ValueError, "No readings have been added");
+        return NULL;
+    }
+
+    if (PyArray_NDIM((PyArrayObject *)result) == 0) {
+        PyObject *scalar = PyFloat_FromDouble(out[0]);
+        Py_DECREF(result);
+        return scalar;
+    }
+    return result;
+}
+
+// Pickles as QuantileSketch(compression) plus a state tuple of (min, max, has_nan,
+// centroids) where centroids is a tuple of (mean, weight) pairs.
+static PyObject *QuantileSketch_reduce(QuantileSketchObject *self, PyObject *Py_UNUSED(args))
+{
+    QuantileSketch *sketch = &self->sketch;
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    sketch_compress(sketch);
+    PyObject *centroids = PyTuple_New(sketch->num_centroids);
+    for (npy_intp i = 0; centroids != NULL && i < sketch->num_centroids; i++) {
+        PyObject *pair = Py_BuildValue("(dd)", sketch->centroids[i].mean, sketch->centroids[i].weight);
+        if (pair == NULL) {
+            Py_CLEAR(centroids);
+            break;
+        }
+        PyTuple_SET_ITEM(centroids, i, pair);
+    }
+    // Copied under the lock so the state matches the centroids
+    double min_val = sketch->min, max_val = sketch->max;
+    int has_nan = sketch->has_nan;
+    PyThread_release_lock(self->lock);
+
+    if (centroids == NULL) {
+        return NULL;
+    }
+    return Py_BuildValue("O(d)(ddiN)", (PyObject *)Py_TYPE(self), sketch->compression, min_val, max_val, has_nan,
+                         centroids);
+}
+
+static PyObject *QuantileSketch_setstate(QuantileSketchObject *self, PyObject *state)
+{
+    QuantileSketch *sketch = &self->sketch;
+    double min_val, max_val;
+    int has_nan;
+    PyObject *centroids;
+
+    if (!PyArg_ParseTuple(state, "ddpO!;QuantileSketch state must be (min, max, has_nan, centroids)",
+                          &min_val, &max_val, &has_nan, &PyTuple_Type, &centroids)) {
+        return NULL;
+    }
+    if (PyTuple_GET_SIZE(centroids) > sketch->capacity) {
+        PyErr_SetString(PyExc_ValueError, "Too many centroids for the sketch's compression");
+        return NULL;
+    }
+
+    Centroid *restored = PyMem_Malloc((PyTuple_GET_SIZE(centroids) + 1) * sizeof(Centroid));
+    if (restored == NULL) {
+        return PyErr_NoMemory();
+    }
+    double total_weight = 0.0;
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(centroids); i++) {
+        if (!PyArg_ParseTuple(PyTuple_GET_ITEM(centroids, i), "dd;centroids must be (mean, weight) pairs",
+                              &restored[i].mean, &restored[i].weight)) {
+            PyMem_Free(restored);
+            return NULL;
+        }
+        if (!(restored[i].weight > 0.0) || (i > 0 && restored[i].mean < restored[i - 1].mean)) {
+            PyMem_Free(restored);
+            PyErr_SetString(PyExc_ValueError, "centroids must have positive weights and ascending means");
+            return NULL;
+        }
+        total_weight += restored[i].weight;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    memcpy(sketch->centroids, restored, PyTuple_GET_SIZE(centroids) * sizeof(Centroid));
+    sketch->num_centroids = PyTuple_GET_SIZE(centroids);
+    sketch->buffered = 0;
+    sketch->total_weight = total_weight;
+    sketch->min = min_val;
+    sketch->max = max_val;
+    sketch->has_nan = has_nan;
+    PyThread_release_lock(self->lock);
+    PyMem_Free(restored);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *QuantileSketch_get_count(QuantileSketchObject *self, void *Py_UNUSED(closure))
+{
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    double total_weight = self->sketch.total_weight;
+    PyThread_release_lock(self->lock);
+
+    return PyLong_FromDouble(total_weight);
+}
+
+static PyObject *QuantileSketch_get_compression(QuantileSketchObject *self, void *Py_UNUSED(closure))
+{
+    return PyFloat_FromDouble(self->sketch.compression);
+}
+
+static PyMethodDef QuantileSketch_methods[] = {
+    {"update", (PyCFunction)QuantileSketch_update, METH_VARARGS, "Adds a chunk of readings to the sketch."},
+    {"merge", (PyCFunction)QuantileSketch_merge, METH_VARARGS, "Adds the readings summarised by another QuantileSketch."},
+    {"quantile", (PyCFunction)QuantileSketch_quantile, METH_O, "Estimates the q-quantile(s) of the readings seen so far."},
+    {"__reduce__", (PyCFunction)QuantileSketch_reduce, METH_NOARGS, "Supports pickling."},
+    {"__setstate__", (PyCFunction)QuantileSketch_setstate, METH_O, "Restores a pickled state."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef QuantileSketch_getset[] = {
+    {"count", (getter)QuantileSketch_get_count, NULL, "Number of (non-NaN) readings seen so far.", NULL},
+    {"compression", (getter)QuantileSketch_get_compression, NULL, "Accuracy parameter: about this many centroids are kept.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject QuantileSketchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "temp_stats.QuantileSketch",
+    .tp_basicsize = sizeof(QuantileSketchObject),
+    .tp_dealloc = (destructor)QuantileSketch_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Mergeable t-digest estimating quantiles (e.g. p50/p95/p99) in bounded memory.",
+    .tp_new = QuantileSketch_new,
+    .tp_methods = QuantileSketch_methods,
+    .tp_getset = QuantileSketch_getset,
+};
+
+typedef struct {
+    npy_intp bins;
+    double low;
+    double high;
+    npy_int64 *counts;
+} HistogramVisit;
+
+static int histogram_visitor(const ReadingRun *run, void *ctx)
+{
+    HistogramVisit *visit = (HistogramVisit *)ctx;
+
+    return histogram_run(run, visit->bins, visit->low, visit->high, visit->counts);
+}
+
+// Documentation for histogram:
+// How it works: Counts the readings into `bins` equal-width bins spanning [low, high] with numpy.histogram's float64
+//   bin edges (readings outside the range and NaN are not counted). Large arrays are split across the thread
+//   pool with private counts per thread. Counts of separate chunks simply add up, so histograms are mergeable.
+// Memory usage considerations: Reads the array in place; besides the result, only one count array per extra thread.
+// Time complexity: O(n), where n is the number of temperature readings.
+static PyObject *histogram(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"arr", "bins", "low", "high", NULL};
+    PyArrayObject *in_array;
+    Py_ssize_t bins;
+    double low, high;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!ndd", kwlist, &PyArray_Type, &in_array, &bins, &low, &high)) {
+        return NULL;
+    }
+
+    if (bins < 1) {
+        PyErr_SetString(PyExc_ValueError, "Number of bins must be at least 1");
+        return NULL;
+    }
+    if (!(isfinite(low) && isfinite(high) && low < high)) {
+        PyErr_SetString(PyExc_ValueError, "Histogram range must be finite with low < high");
+        return NULL;
+    }
+
+    ReadingType type;
+    if (reading_type(in_array, &type) < 0) {
+        return NULL;
+    }
+
+    PyObject *result = PyArray_ZEROS(1, &bins, NPY_INT64, 0);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    HistogramVisit visit = {bins, low, high, PyArray_DATA((PyArrayObject *)result)};
+    if (PyArray_SIZE(in_array) > 0 && visit_runs(in_array, histogram_visitor, &visit) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+// Documentation for set_num_threads:
+// How it works: Sets how many threads (including the caller) share reductions over arrays of at least PARALLEL_THRESHOLD readings.
+//   All reductions release the GIL while they run; results do not depend on the number of threads.
+// Memory usage considerations: Each worker thread is created once and reused; resizing stops the current workers.
+// Time complexity: O(t), where t is the number of worker threads being stopped.
+static PyObject *set_num_threads(PyObject *self, PyObject *args)
+{
+    int num_threads;
+
+    if (!PyArg_ParseTuple(args, "i", &num_threads)) {
+        return NULL;
+    }
+
+    if (num_threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "Number of threads must be at least 1");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    pool_set_num_threads(num_threads);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+// Documentation for get_num_threads:
+// How it works: Returns the number of threads used for large reductions (defaults to the number of online CPUs).
+// Time complexity: O(1).
+static PyObject *get_num_threads(PyObject *self, PyObject *Py_UNUSED(args))
+{
+    return PyLong_FromLong(pool_get_num_threads());
+}
+
 static PyMethodDef TempStatsMethods[] = {
-    {"min_temp", min_temp, METH_VARARGS, "Returns the minimum temperature recorded."}, 
-    {"max_temp", max_temp, METH_VARARGS, "Returns the maximum temperature recorded."}, 
-    {"avg_temp", avg_temp, METH_VARARGS, "Returns the average (mean) temperature."}, 
-    {"variance_temp", variance_temp, METH_VARARGS, "Returns the variance of the temperature readings (sample-based)."}, 
-    {"count_readings", count_readings, METH_VARARGS, "Returns the total number of temperature readings."}, 
+    {"min_temp", (PyCFunction)(void (*)(void))min_temp, METH_VARARGS | METH_KEYWORDS, "Returns the minimum temperature recorded."}, 
+    {"max_temp", (PyCFunction)(void (*)(void))max_temp, METH_VARARGS | METH_KEYWORDS, "Returns the maximum temperature recorded."}, 
+    {"avg_temp", (PyCFunction)(void (*)(void))avg_temp, METH_VARARGS | METH_KEYWORDS, "Returns the average (mean) temperature."}, 
+    {"variance_temp", (PyCFunction)(void (*)(void))variance_temp, METH_VARARGS | METH_KEYWORDS, "Returns the variance of the temperature readings (sample-based)."}, 
+    {"count_readings", (PyCFunction)(void (*)(void))count_readings, METH_VARARGS | METH_KEYWORDS, "Returns the total number of temperature readings."}, 
+    {"summary", (PyCFunction)(void (*)(void))summary, METH_VARARGS | METH_KEYWORDS, "Returns count, min, max, mean and variance computed in a single pass."}, 
+    {"summary_file", (PyCFunction)(void (*)(void))summary_file, METH_VARARGS | METH_KEYWORDS, "Returns the summary of a binary file of readings, streamed through a memory map."}, 
+    {"rolling_summary", (PyCFunction)(void (*)(void))rolling_summary, METH_VARARGS | METH_KEYWORDS, "Returns min, max, mean and variance over every window of consecutive readings."}, 
+    {"ewma", (PyCFunction)(void (*)(void))ewma, METH_VARARGS | METH_KEYWORDS, "Returns the exponentially weighted moving mean and variance after every reading."}, 
+    {"histogram", (PyCFunction)(void (*)(void))histogram, METH_VARARGS | METH_KEYWORDS, "Counts the readings into equal-width bins over [low, high]."}, 
+    {"set_num_threads", set_num_threads, METH_VARARGS, "Sets the number of threads used for large reductions."}, 
+    {"get_num_threads", get_num_threads, METH_NOARGS, "Returns the number of threads used for large reductions."}, 
     {NULL, NULL, 0, NULL}
 };
 
@@ -162,5 +1305,57 @@ static struct PyModuleDef tempstatsmodule = {
 PyMODINIT_FUNC PyInit_temp_stats(void)
 {
     import_array(); // Required for NumPy C-API
-    return PyModule_Create(&tempstatsmodule);
+
+    // Pick the SIMD kernels once; TEMP_STATS_ISA can force a narrower instruction set.
+    const StatsKernels *kernels = stats_kernels_init(getenv("TEMP_STATS_ISA"));
+
+    if (SummaryType.tp_name == NULL && PyStructSequence_InitType2(&SummaryType, &summary_desc) < 0) {
+        return NULL;
+    }
+
+    if (PyType_Ready(&AccumulatorType) < 0) {
+        return NULL;
+    }
+
+    if (PyType_Ready(&QuantileSketchType) < 0) {
+        return NULL;
+    }
+
+    PyObject *module = PyModule_Create(&tempstatsmodule);
+    if (module == NULL) {
+        return NULL;
+    }
+
+    if (PyModule_AddStringConstant(module, "simd_isa", kernels->name) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    if (PyModule_AddIntConstant(module, "PARALLEL_THRESHOLD", PARALLEL_THRESHOLD) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&SummaryType);
+    if (PyModule_AddObject(module, "Summary", (PyObject *)&SummaryType) < 0) {
+        Py_DECREF(&SummaryType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&AccumulatorType);
+    if (PyModule_AddObject(module, "Accumulator", (PyObject *)&AccumulatorType) < 0) {
+        Py_DECREF(&AccumulatorType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&QuantileSketchType);
+    if (PyModule_AddObject(module, "QuantileSketch", (PyObject *)&QuantileSketchType) < 0) {
+        Py_DECREF(&QuantileSketchType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
 }
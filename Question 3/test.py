@@ -5,6 +5,7 @@ import temp_stats
 temperature_readings = np.array([20.5, 21.0, 20.0, 22.0, 21.5, 19.5, 20.8, 21.2, 20.7, 21.1], dtype=np.float32)
 
 print(f"Temperature Readings: {temperature_readings}")
+print(f"SIMD kernels: {temp_stats.simd_isa}")
 
 # Test the C extension functions
 min_val = temp_stats.min_temp(temperature_readings)
@@ -53,3 +54,171 @@ try:
 except ValueError as e:
     print(f"Error for variance_temp with single element array: {e}")
 print(f"Number of Readings: {temp_stats.count_readings(single_reading)}")
+
+# Test the fused single-pass summary
+print("\nTesting summary:")
+stats = temp_stats.summary(temperature_readings)
+print(f"Summary: {stats}")
+assert stats.count == count_val
+assert stats.min == min_val and stats.max == max_val
+assert abs(stats.mean - avg_val) < 1e-9
+assert abs(stats.variance - variance_val) < 1e-9
+print(f"Summary of single reading: {temp_stats.summary(single_reading)}")
+try:
+    temp_stats.summary(empty_readings)
+except ValueError as e:
+    print(f"Error for summary with empty array: {e}")
+
+# A NaN reading propagates like numpy.min/max/sum
+nan_readings = np.array([20.0, np.nan, 22.0], dtype=np.float32)
+print("\nTesting with a NaN reading:")
+print(f"Minimum Temperature: {temp_stats.min_temp(nan_readings)}")
+print(f"Maximum Temperature: {temp_stats.max_temp(nan_readings)}")
+print(f"Average Temperature: {temp_stats.avg_temp(nan_readings)}")
+
+# Large arrays are split across the thread pool; the result must not depend on the thread count
+large_readings = (np.random.default_rng(0).standard_normal(3 * temp_stats.PARALLEL_THRESHOLD) + 20.0).astype(np.float32)
+print("\nTesting thread pool:")
+print(f"Default number of threads: {temp_stats.get_num_threads()}")
+temp_stats.set_num_threads(1)
+single_threaded = temp_stats.summary(large_readings)
+temp_stats.set_num_threads(4)
+multi_threaded = temp_stats.summary(large_readings)
+print(f"Summary with 1 thread:  {single_threaded}")
+print(f"Summary with 4 threads: {multi_threaded}")
+assert single_threaded == multi_threaded
+try:
+    temp_stats.set_num_threads(0)
+except ValueError as e:
+    print(f"Error for set_num_threads(0): {e}")
+
+# Strided views, float64, int16 and byte-swapped arrays are read in place
+grid = np.arange(40, dtype=np.float32).reshape(10, 4) / 2 + 18.0
+column = grid[:, 1]
+print("\nTesting strided and multi-dtype input:")
+print(f"Column view: {column} (contiguous: {column.flags.c_contiguous})")
+print(f"Summary of column view: {temp_stats.summary(column)}")
+assert temp_stats.summary(column) == temp_stats.summary(np.ascontiguousarray(column))
+assert temp_stats.summary(column.astype(np.float64)) == temp_stats.summary(column)
+assert temp_stats.summary(column.astype('>f4')) == temp_stats.summary(column)
+adc_counts = np.array([2050, 2100, 1990, 2201], dtype=np.int16)
+print(f"Average of int16 ADC counts {adc_counts}: {temp_stats.avg_temp(adc_counts)}")
+try:
+    temp_stats.avg_temp(np.arange(5))
+except TypeError as e:
+    print(f"Error for avg_temp with int64 array: {e}")
+
+# axis= reduces each sensor (column) or each time step (row) of a 2-D array
+sensors = np.random.default_rng(1).normal(20.0, 5.0, (4096, 8)).astype(np.float32)
+print("\nTesting axis-wise statistics:")
+per_sensor = temp_stats.summary(sensors, axis=0)
+print(f"Per-sensor means: {per_sensor.mean}")
+assert per_sensor.count == 4096
+assert np.array_equal(per_sensor.min, sensors.min(axis=0)) and np.array_equal(per_sensor.max, sensors.max(axis=0))
+assert np.allclose(per_sensor.mean, sensors.astype(np.float64).mean(axis=0))
+assert np.allclose(per_sensor.variance, sensors.astype(np.float64).var(axis=0, ddof=1))
+per_step = temp_stats.avg_temp(sensors, axis=1)
+assert per_step.shape == (4096,) and np.allclose(per_step, sensors.astype(np.float64).mean(axis=1))
+# Column-major data reduces each column exactly like the column on its own
+fortran_sensors = np.asfortranarray(sensors)
+assert temp_stats.variance_temp(fortran_sensors, axis=0)[3] == temp_stats.variance_temp(fortran_sensors[:, 3])
+print(f"Readings per sensor: {temp_stats.count_readings(sensors, axis=0)}")
+try:
+    temp_stats.min_temp(sensors, axis=2)
+except ValueError as e:
+    print(f"Error for min_temp with axis=2: {e}")
+
+# Accumulator keeps O(1) running state across chunks and merges across processes
+import pickle
+print("\nTesting Accumulator:")
+stream = np.random.default_rng(2).normal(20.0, 5.0, 10_000).astype(np.float32)
+accumulator = temp_stats.Accumulator()
+for chunk in np.array_split(stream, 7):
+    accumulator.update(chunk)
+streamed = accumulator.result()
+whole = temp_stats.summary(stream)
+print(f"Streamed summary: {streamed}")
+assert streamed.count == whole.count and streamed.min == whole.min and streamed.max == whole.max
+assert abs(streamed.mean - whole.mean) < 1e-9 and abs(streamed.variance - whole.variance) < 1e-9
+first, second = temp_stats.Accumulator(), temp_stats.Accumulator()
+first.update(stream[:2500])
+second.update(stream[2500:])
+first.merge(pickle.loads(pickle.dumps(second)))
+assert first.count == whole.count and abs(first.result().variance - whole.variance) < 1e-9
+try:
+    temp_stats.Accumulator().result()
+except ValueError as e:
+    print(f"Error for result() of an empty Accumulator: {e}")
+
+# Rolling statistics over every window of N readings, and exponentially weighted moving statistics
+from numpy.lib.stride_tricks import sliding_window_view
+print("\nTesting moving statistics:")
+series = np.random.default_rng(3).normal(20.0, 5.0, 2000).astype(np.float32)
+rolling = temp_stats.rolling_summary(series, 50)
+windows = sliding_window_view(series.astype(np.float64), 50)
+print(f"Rolling means (first 3 windows): {rolling.mean[:3]}")
+assert rolling.count == 50 and rolling.min.shape == (1951,)
+assert np.array_equal(rolling.min, windows.min(axis=1)) and np.array_equal(rolling.max, windows.max(axis=1))
+assert np.allclose(rolling.mean, windows.mean(axis=1)) and np.allclose(rolling.variance, windows.var(axis=1, ddof=1))
+# Infinities give infinite or NaN means and NaN variance while inside a window, and nothing once they leave it
+with_inf = np.array([1, 2, 3, np.inf, -np.inf, 5, 6, 7, 8, 9])
+rolling_inf = temp_stats.rolling_summary(with_inf, 3)
+print(f"Rolling means and variances with infinities: {rolling_inf.mean} {rolling_inf.variance}")
+with np.errstate(invalid="ignore"):
+    inf_windows = sliding_window_view(with_inf, 3)
+    assert np.allclose(rolling_inf.mean, inf_windows.mean(axis=1), equal_nan=True)
+    assert np.allclose(rolling_inf.variance, inf_windows.var(axis=1, ddof=1), equal_nan=True)
+assert np.array_equal(rolling_inf.min, inf_windows.min(axis=1)) and np.array_equal(rolling_inf.max, inf_windows.max(axis=1))
+ewma_mean, ewma_variance = temp_stats.ewma(temperature_readings, alpha=0.5)
+print(f"EWMA mean: {ewma_mean}")
+print(f"EWMA variance: {ewma_variance}")
+try:
+    temp_stats.rolling_summary(series, 0)
+except ValueError as e:
+    print(f"Error for rolling_summary with window 0: {e}")
+
+# Quantile sketch (t-digest) and fixed-bin histogram, both mergeable with bounded memory
+print("\nTesting quantile sketch and histogram:")
+latencies = np.random.default_rng(4).lognormal(0.0, 1.0, 200_000).astype(np.float32)
+sketch = temp_stats.QuantileSketch()
+for chunk in np.array_split(latencies, 8):
+    sketch.update(chunk)
+p50, p95, p99 = sketch.quantile([0.5, 0.95, 0.99])
+print(f"p50={p50:.4f} p95={p95:.4f} p99={p99:.4f} (numpy: {np.percentile(latencies, [50, 95, 99])})")
+sorted_latencies = np.sort(latencies)
+for q, estimate in [(0.5, p50), (0.95, p95), (0.99, p99)]:
+    assert abs(np.searchsorted(sorted_latencies, estimate) / latencies.size - q) < 0.005
+assert sketch.quantile(0.0) == latencies.min() and sketch.quantile(1.0) == latencies.max()
+left, right = temp_stats.QuantileSketch(), temp_stats.QuantileSketch()
+left.update(latencies[:50_000])
+right.update(latencies[50_000:])
+left.merge(pickle.loads(pickle.dumps(right)))
+assert left.count == latencies.size
+assert abs(np.searchsorted(sorted_latencies, left.quantile(0.99)) / latencies.size - 0.99) < 0.005
+counts = temp_stats.histogram(temperature_readings.astype(np.float64), 4, 20.0, 24.0)
+print(f"Histogram of temperature readings over [20, 24]: {counts}")
+assert np.array_equal(counts, np.histogram(temperature_readings.astype(np.float64), bins=4, range=(20.0, 24.0))[0])
+assert np.array_equal(temp_stats.histogram(latencies[:1000], 10, 0.0, 5.0) + temp_stats.histogram(latencies[1000:], 10, 0.0, 5.0),
+                      temp_stats.histogram(latencies, 10, 0.0, 5.0))
+
+# Binary sensor dumps are streamed through a memory map instead of being loaded into NumPy
+import os
+import tempfile
+print("\nTesting summary_file:")
+with tempfile.NamedTemporaryFile(suffix=".bin", delete=False) as dump:
+    dump.write(b"HDR0")
+    dump.write(temperature_readings.astype(">f4").tobytes())
+try:
+    from_file = temp_stats.summary_file(dump.name, dtype=">f4", offset=4)
+    print(f"Summary of binary file: {from_file}")
+    assert from_file == temp_stats.summary(temperature_readings)
+    try:
+        temp_stats.summary_file(dump.name, dtype=np.float64)
+    except ValueError as e:
+        print(f"Error for summary_file without skipping the header: {e}")
+    try:
+        temp_stats.summary_file(dump.name, dtype=">f4", offset=1000)
+    except ValueError as e:
+        print(f"Error for summary_file with an offset past the end: {e}")
+finally:
+    os.remove(dump.name)
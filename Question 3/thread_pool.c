@@ -0,0 +1,184 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+
+// Upper bound on the number of threads, including the calling thread
+#define MAX_THREADS 256
+
+// Held by the thread whose job is running, for the whole job, and by resizes.
+static pthread_mutex_t submit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Protects the job description and worker bookkeeping below.
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;  // a job was posted (or shutdown)
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER; // the last busy worker finished
+
+static _Atomic int num_threads; // defaults to the number of online CPUs
+static int num_workers = 0; // running worker threads (num_threads - 1 once started)
+static pthread_t workers[MAX_THREADS];
+static unsigned long generation = 0; // incremented for every posted job
+static int busy_workers = 0;
+static int shutting_down = 0;
+
+static PoolTaskFn job_fn;
+static void *job_ctx;
+static npy_intp job_tasks;
+static _Atomic npy_intp next_task;
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+// Claims and runs tasks of the current job until none are left.
+static void run_tasks(PoolTaskFn fn, void *ctx, npy_intp num_tasks)
+{
+    npy_intp task;
+    while ((task = atomic_fetch_add(&next_task, 1)) < num_tasks) {
+        fn(ctx, task);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    unsigned long seen = (unsigned long)(uintptr_t)arg;
+
+    pthread_mutex_lock(&state_mutex);
+    while (true) {
+        while (generation == seen && !shutting_down) {
+            pthread_cond_wait(&job_cond, &state_mutex);
+        }
+        if (shutting_down) {
+            break;
+        }
+        seen = generation;
+        PoolTaskFn fn = job_fn;
+        void *ctx = job_ctx;
+        npy_intp num_tasks = job_tasks;
+        pthread_mutex_unlock(&state_mutex);
+
+        run_tasks(fn, ctx, num_tasks);
+
+        pthread_mutex_lock(&state_mutex);
+        if (--busy_workers == 0) {
+            pthread_cond_signal(&done_cond);
+        }
+    }
+    pthread_mutex_unlock(&state_mutex);
+
+    return NULL;
+}
+
+// Stops all workers. Called with submit_mutex held.
+static void stop_workers(void)
+{
+    pthread_mutex_lock(&state_mutex);
+    shutting_down = 1;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    shutting_down = 0;
+    num_workers = 0;
+}
+
+// Fork handlers: a child process inherits none of the workers, so it starts
+// with an empty pool that is refilled on its first job. Holding submit_mutex
+// across fork() guarantees no job is half-posted in the child.
+static void atfork_prepare(void)
+{
+    pthread_mutex_lock(&submit_mutex);
+}
+
+static void atfork_parent(void)
+{
+    pthread_mutex_unlock(&submit_mutex);
+}
+
+static void atfork_child(void)
+{
+    num_workers = 0;
+    busy_workers = 0;
+    pthread_cond_init(&job_cond, NULL);
+    pthread_cond_init(&done_cond, NULL);
+    pthread_mutex_unlock(&submit_mutex);
+}
+
+static void init_pool(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    atomic_store(&num_threads, cpus < 1 ? 1 : cpus > MAX_THREADS ? MAX_THREADS : (int)cpus);
+    pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+}
+
+// Starts num_threads - 1 workers if none are running. Called with submit_mutex held.
+static void start_workers(void)
+{
+    int wanted = atomic_load(&num_threads) - 1;
+    for (int i = num_workers; i < wanted; i++) {
+        if (pthread_create(&workers[i], NULL, worker_main, (void *)(uintptr_t)generation) != 0) {
+            break; // run with the workers we have
+        }
+        num_workers++;
+    }
+}
+
+int pool_set_num_threads(int threads)
+{
+    if (threads < 1) {
+        return -1;
+    }
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    pthread_once(&init_once, init_pool);
+    pthread_mutex_lock(&submit_mutex);
+    stop_workers();
+    atomic_store(&num_threads, threads);
+    pthread_mutex_unlock(&submit_mutex);
+
+    return 0;
+}
+
+int pool_get_num_threads(void)
+{
+    pthread_once(&init_once, init_pool);
+    return atomic_load(&num_threads);
+}
+
+void pool_run(PoolTaskFn fn, void *ctx, npy_intp num_tasks)
+{
+    if (num_tasks <= 1 || pool_get_num_threads() <= 1 || pthread_mutex_trylock(&submit_mutex) != 0) {
+        for (npy_intp task = 0; task < num_tasks; task++) {
+            fn(ctx, task);
+        }
+        return;
+    }
+
+    start_workers();
+
+    pthread_mutex_lock(&state_mutex);
+    job_fn = fn;
+    job_ctx = ctx;
+    job_tasks = num_tasks;
+    atomic_store(&next_task, 0);
+    busy_workers = num_workers;
+    generation++;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    run_tasks(fn, ctx, num_tasks);
+
+    pthread_mutex_lock(&state_mutex);
+    while (busy_workers > 0) {
+        pthread_cond_wait(&done_cond, &state_mutex);
+    }
+    pthread_mutex_unlock(&state_mutex);
+
+    pthread_mutex_unlock(&submit_mutex);
+}
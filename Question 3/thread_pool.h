@@ -0,0 +1,26 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <Python.h>
+#include <numpy/npy_common.h>
+
+// A persistent pool of worker threads shared by the temp_stats kernels.
+// Workers never touch Python objects, so callers release the GIL around pool_run().
+
+// Runs task `task` (0 <= task < num_tasks) of a job.
+typedef void (*PoolTaskFn)(void *ctx, npy_intp task);
+
+// Sets the number of threads used by pool_run(), including the calling thread.
+// Existing workers are stopped and new ones are started on the next job.
+// Returns 0 on success, -1 if num_threads < 1.
+int pool_set_num_threads(int num_threads);
+
+// Returns the number of threads used by pool_run(). Defaults to the number of online CPUs.
+int pool_get_num_threads(void);
+
+// Runs fn(ctx, task) for every task in [0, num_tasks) and returns once all have finished.
+// Tasks are claimed dynamically by the workers and the calling thread. If the pool is
+// busy with another caller's job (or has a single thread), the tasks run inline instead.
+void pool_run(PoolTaskFn fn, void *ctx, npy_intp num_tasks);
+
+#endif // THREAD_POOL_H
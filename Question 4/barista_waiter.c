@@ -1,105 +1,746 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
-#include <semaphore.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include "barista_waiter.h"
+#include "futex.h"
+
+typedef enum {
+    MODE_REAL,      // threads doing the work in real time
+    MODE_SIMULATE,  // discrete-event simulation on a virtual clock
+    MODE_BENCHMARK  // threads with no work at all, timing the queues
+} Mode;
+
+typedef enum {
+    SERVICE_FIXED,       // every drink takes the mean time
+    SERVICE_EXPONENTIAL, // memoryless, as for random arrivals
+    SERVICE_UNIFORM      // anywhere from nothing to twice the mean
+} ServiceDistribution;
+
+// Configuration
+static Mode mode = MODE_REAL;
+static int num_baristas = 1;
+static int num_waiters = 1;
+static long drinks_per_barista = 0; // 0: run indefinitely
+static long shift_seconds = 0;      // simulation: stop preparing drinks after this much virtual time
+static long queue_size = QUEUE_SIZE;
+static OrderQueuePolicy full_policy = ORDER_QUEUE_BLOCK;
+static long prepare_us = BARISTA_TIME * 1000000L;
+static long serve_us = WAITER_TIME * 1000000L;
+static ServiceDistribution distribution = SERVICE_FIXED;
+static long seed = 1;
+static int burn_cpu = 0; // spin through the work instead of sleeping
+static int pin_threads = 0;
+static int verbose = 1;
+
+// Stations
+// Each barista owns a station: a lock-free queue (see order_queue.h) that only it
+// adds to. Waiter i calls station i % num_baristas home and takes its drinks
+// first; when home is empty it steals from the busiest other station, so idle
+// waiters pull drinks from stations that are falling behind and no one queue or
+// lock is shared by every thread.
+static OrderQueue *stations;
+
+// When each drink was placed, indexed by drink number, for bounded runs and the
+// simulation. The queue's release and acquire publish each entry with its drink.
+static uint64_t *placed_ns;
+static size_t placed_capacity;
+
+// Waiters with no drink anywhere sleep on `drinks_posted`, which a barista bumps
+// after placing a drink if `idle_waiters` says anyone is asleep.
+static alignas(CACHE_LINE_SIZE) atomic_uint drinks_posted;
+static atomic_uint idle_waiters;
+static atomic_int baristas_working; // a bounded run ends once none are and every station is empty
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
 
-// Shared queue and its management variables
-int order_queue[QUEUE_SIZE];
-int head = 0;
-int tail = 0;
-int count = 0;
+// Draws how long the worker's next drink takes, in nanoseconds, from its own
+// xorshift64* generator, so runs with the same seed draw the same times.
+static uint64_t service_time(Worker *self, long mean_us) {
+    double mean = mean_us * 1000.0;
+    if (distribution == SERVICE_FIXED || mean_us == 0) {
+        return (uint64_t)mean;
+    }
+    self->rng ^= self->rng >> 12;
+    self->rng ^= self->rng << 25;
+    self->rng ^= self->rng >> 27;
+    double u = (double)((self->rng * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53; // [0, 1)
+    return (uint64_t)(distribution == SERVICE_EXPONENTIAL ? -mean * log1p(-u) : 2 * mean * u);
+}
 
-// Mutex and condition variables for synchronization
-pthread_mutex_t mutex;
-pthread_cond_t producer_cond;
-pthread_cond_t consumer_cond;
+// Simulates preparing or serving a drink.
+static void do_work(uint64_t ns) {
+    if (ns == 0) {
+        return;
+    }
+    uint64_t deadline = now_ns() + ns;
+    if (burn_cpu) {
+        while (now_ns() < deadline) {
+        }
+        return;
+    }
+    struct timespec until = {(time_t)(deadline / 1000000000ULL), (long)(deadline % 1000000000ULL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+}
 
 // Barista thread function (Producer)
 void *barista(void *arg) {
-    int item = 0;
-    while (1) {
-        // Acquire the mutex before accessing shared resources
-        pthread_mutex_lock(&mutex);
+    Worker *self = (Worker *)arg;
+    OrderQueue *station = &stations[self->id];
+    for (long i = 0; drinks_per_barista == 0 || i < drinks_per_barista; i++) {
+        // Drinks are numbered across all stations
+        int item = (int)(i * num_baristas + self->id);
 
-        // If the queue is full, wait for space to become available
-        while (count == QUEUE_SIZE) {
-            printf("Barista: Queue is full. Waiting for space...\n");
-            pthread_cond_wait(&producer_cond, &mutex);
+        // Prepare a drink (simulate work)
+        if (verbose) {
+            printf("Barista %d: Preparing drink %d...\n", self->id, item);
+        }
+        do_work(service_time(self, prepare_us));
+        if (placed_ns != NULL) {
+            placed_ns[item] = now_ns();
         }
 
-        // Prepare a drink (simulate work)
-        printf("Barista: Preparing drink %d...\n", item);
-        sleep(BARISTA_TIME);
+        // Add the drink to the station. If the station is full, wait for space to
+        // become available, drop the oldest drink or reject this one
+        if (!order_queue_try_push(station, item)) {
+            if (verbose) {
+                printf("Barista %d: Queue is full. %s\n", self->id,
+                       full_policy == ORDER_QUEUE_BLOCK         ? "Waiting for space..."
+                       : full_policy == ORDER_QUEUE_DROP_OLDEST ? "Dropping the oldest drink."
+                                                                : "Rejecting the drink.");
+            }
+            if (order_queue_push(station, item) < 0) {
+                self->rejected++;
+                continue;
+            }
+        }
+        futex_notify(&drinks_posted, &idle_waiters, 1);
+        if (verbose) {
+            printf("Barista %d: Placed drink %d in queue. Queue size: %zu\n", self->id, item,
+                   order_queue_size(station));
+        }
+        self->drinks++;
+    }
 
-        // Add the drink to the queue
-        order_queue[tail] = item;
-        tail = (tail + 1) % QUEUE_SIZE;
-        count++;
-        printf("Barista: Placed drink %d in queue. Queue size: %d\n", item, count);
+    // The last barista to finish a bounded run wakes idle waiters to drain the
+    // stations and stop
+    if (atomic_fetch_sub_explicit(&baristas_working, 1, memory_order_acq_rel) == 1) {
+        atomic_fetch_add(&drinks_posted, 1);
+        futex_wake(&drinks_posted, INT_MAX);
+    }
+    return NULL;
+}
 
-        // Signal the waiter that a new drink is available
-        pthread_cond_signal(&consumer_cond);
+// Takes every drink waiting at the waiter's home station, up to `max`, or failing
+// that steals half of the drinks at the busiest station. Returns how many it took.
+static size_t take_drinks(Worker *self, int *items, size_t max) {
+    OrderQueue *home = &stations[self->id % num_baristas];
+    size_t taken = order_queue_try_pop_n(home, items, max);
+    if (taken > 0) {
+        return taken;
+    }
 
-        // Release the mutex
-        pthread_mutex_unlock(&mutex);
+    // A pop can still fail when the size said otherwise: another waiter got there
+    // first, or a barista has claimed a slot but not filled it yet. Give up after
+    // a few rounds and let the caller sleep until the next drink is placed.
+    for (int round = 0; round < 4; round++) {
+        OrderQueue *busiest = NULL;
+        size_t most = 0;
+        for (int s = 0; s < num_baristas; s++) {
+            size_t waiting = order_queue_size(&stations[s]);
+            if (waiting > most) {
+                most = waiting;
+                busiest = &stations[s];
+            }
+        }
+        if (busiest == NULL) {
+            return 0;
+        }
+        // Leave the rest for the station's own waiter
+        size_t share = busiest == home ? most : (most + 1) / 2;
+        taken = order_queue_try_pop_n(busiest, items, share < max ? share : max);
+        if (taken > 0) {
+            if (busiest != home) {
+                self->stolen += taken;
+            }
+            return taken;
+        }
+    }
+    return 0;
+}
 
-        item++;
+// Records how long each drink just taken waited since it was placed.
+static void record_waits(Worker *self, const int *items, size_t taken, uint64_t now) {
+    if (placed_ns == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < taken; i++) {
+        histogram_record(&self->waits, now - placed_ns[items[i]]);
     }
-    return NULL;
 }
 
 // Waiter thread function (Consumer)
 void *waiter(void *arg) {
+    Worker *self = (Worker *)arg;
+    int *items = malloc(queue_size * sizeof(int));
+    if (items == NULL) {
+        fprintf(stderr, "Waiter %d: Out of memory\n", self->id);
+        return NULL;
+    }
     while (1) {
-        // Acquire the mutex before accessing shared resources
-        pthread_mutex_lock(&mutex);
+        // Every drink was placed before the count reached zero, so once it has,
+        // finding the stations empty means the run is over
+        int last_round = atomic_load_explicit(&baristas_working, memory_order_acquire) == 0;
+
+        // Remove every drink waiting at a station. If every station is empty, wait
+        // for a drink to become available
+        size_t taken = take_drinks(self, items, queue_size);
+        if (taken == 0) {
+            if (last_round) {
+                break;
+            }
+            // Announce the wait before looking again (see futex_notify)
+            atomic_fetch_add(&idle_waiters, 1);
+            unsigned seen = atomic_load(&drinks_posted);
+            taken = take_drinks(self, items, queue_size);
+            if (taken == 0 && atomic_load(&baristas_working) > 0) {
+                if (verbose) {
+                    printf("Waiter %d: Queue is empty. Waiting for drinks...\n", self->id);
+                }
+                futex_wait(&drinks_posted, seen);
+            }
+            atomic_fetch_sub(&idle_waiters, 1);
+            if (taken == 0) {
+                continue;
+            }
+        }
+        record_waits(self, items, taken, now_ns());
+
+        for (size_t i = 0; i < taken; i++) {
+            if (verbose) {
+                printf("Waiter %d: Serving drink %d. Queue size: %zu\n", self->id, items[i],
+                       order_queue_size(&stations[self->id % num_baristas]));
+            }
 
-        // If the queue is empty, wait for a drink to become available
-        while (count == 0) {
-            printf("Waiter: Queue is empty. Waiting for drinks...\n");
-            pthread_cond_wait(&consumer_cond, &mutex);
+            // Simulate serving time
+            do_work(service_time(self, serve_us));
+            self->drinks++;
         }
+        self->batches++;
+    }
+    free(items);
+    return NULL;
+}
+
+// Simulation
+// A discrete-event run of the same pipeline on a virtual clock. One thread plays
+// every barista and waiter, jumping from each event to the next instead of
+// sleeping, so a shift takes as long as its events do to process rather than its
+// length. Drinks go through the same stations, full-station policy and
+// take_drinks(), and service times come from the same seeded generators, so a run
+// is exactly repeatable.
 
-        // Remove a drink from the queue
-        int item = order_queue[head];
-        head = (head + 1) % QUEUE_SIZE;
-        count--;
-        printf("Waiter: Serving drink %d. Queue size: %d\n", item, count);
+typedef enum {
+    EVENT_PREPARED, // a barista has finished preparing a drink
+    EVENT_READY     // a waiter is free to take more drinks
+} EventType;
 
-        // Simulate serving time
-        sleep(WAITER_TIME);
+typedef struct {
+    uint64_t time;
+    uint64_t sequence; // orders events at the same time by when they were scheduled
+    EventType type;
+    Worker *worker;
+} Event;
 
-        // Signal the barista that space is available in the queue
-        pthread_cond_signal(&producer_cond);
+// Pending events, a binary min-heap. Each worker has at most one.
+static Event *events;
+static size_t num_events;
+static uint64_t events_scheduled;
+static uint64_t sim_now;
 
-        // Release the mutex
-        pthread_mutex_unlock(&mutex);
+// Waiters with nothing to do, woken first-in first-out as drinks are placed
+static Worker **idle;
+static size_t idle_first, num_idle;
+
+static int event_before(const Event *a, const Event *b) {
+    return a->time != b->time ? a->time < b->time : a->sequence < b->sequence;
+}
+
+static void schedule(EventType type, Worker *worker, uint64_t time) {
+    size_t i = num_events++;
+    events[i] = (Event){time, events_scheduled++, type, worker};
+    while (i > 0 && event_before(&events[i], &events[(i - 1) / 2])) {
+        Event parent = events[(i - 1) / 2];
+        events[(i - 1) / 2] = events[i];
+        events[i] = parent;
+        i = (i - 1) / 2;
     }
-    return NULL;
 }
 
-int main() {
-    pthread_t barista_tid, waiter_tid;
+static Event next_event(void) {
+    Event first = events[0];
+    events[0] = events[--num_events];
+    for (size_t i = 0;;) {
+        size_t smallest = i;
+        for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < num_events; child++) {
+            if (event_before(&events[child], &events[smallest])) {
+                smallest = child;
+            }
+        }
+        if (smallest == i) {
+            break;
+        }
+        Event swap = events[i];
+        events[i] = events[smallest];
+        events[smallest] = swap;
+        i = smallest;
+    }
+    return first;
+}
+
+// Starts the barista's next drink, unless it has made its last one or the shift is over.
+static void simulate_prepare_next(Worker *self) {
+    long made = (long)(self->drinks + self->rejected);
+    if ((drinks_per_barista > 0 && made >= drinks_per_barista) ||
+        (shift_seconds > 0 && sim_now >= (uint64_t)shift_seconds * 1000000000ULL) ||
+        made >= INT_MAX / num_baristas - 1) {
+        return;
+    }
+    uint64_t time = service_time(self, prepare_us);
+    self->busy_ns += time;
+    schedule(EVENT_PREPARED, self, sim_now + time);
+}
 
-    // Initialize mutex and condition variables
-    pthread_mutex_init(&mutex, NULL);
-    pthread_cond_init(&producer_cond, NULL);
-    pthread_cond_init(&consumer_cond, NULL);
+static void simulate_placed(Worker *self) {
+    self->drinks++;
+    if (num_idle > 0) {
+        Worker *waiter = idle[idle_first];
+        idle_first = (idle_first + 1) % num_waiters;
+        num_idle--;
+        schedule(EVENT_READY, waiter, sim_now);
+    }
+    simulate_prepare_next(self);
+}
 
-    // Create threads
-    pthread_create(&barista_tid, NULL, barista, NULL);
-    pthread_create(&waiter_tid, NULL, waiter, NULL);
+static int simulate_prepared(Worker *self) {
+    size_t item = (self->drinks + self->rejected) * num_baristas + self->id;
+    if (item >= placed_capacity) {
+        size_t capacity = placed_capacity * 2 > item ? placed_capacity * 2 : item + 1;
+        uint64_t *grown = realloc(placed_ns, capacity * sizeof(uint64_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        placed_ns = grown;
+        placed_capacity = capacity;
+    }
+    placed_ns[item] = sim_now;
 
-    // Join threads (they will run indefinitely in this simulation)
-    pthread_join(barista_tid, NULL);
-    pthread_join(waiter_tid, NULL);
+    OrderQueue *station = &stations[self->id];
+    if (order_queue_try_push(station, (int)item)) {
+        simulate_placed(self);
+    } else if (full_policy == ORDER_QUEUE_BLOCK) {
+        self->pending = (int)item;
+        self->blocked_since = sim_now;
+    } else if (order_queue_push(station, (int)item) == 0) {
+        simulate_placed(self);
+    } else {
+        self->rejected++;
+        simulate_prepare_next(self);
+    }
+    return 0;
+}
+
+static void simulate_ready(Worker *self, Worker *baristas, int *items) {
+    size_t taken = take_drinks(self, items, queue_size);
+    if (taken == 0) {
+        idle[(idle_first + num_idle++) % num_waiters] = self;
+        return;
+    }
+    record_waits(self, items, taken, sim_now);
+    uint64_t busy = 0;
+    for (size_t i = 0; i < taken; i++) {
+        busy += service_time(self, serve_us);
+    }
+    self->drinks += taken;
+    self->batches++;
+    self->busy_ns += busy;
+    schedule(EVENT_READY, self, sim_now + busy);
 
-    // Destroy mutex and condition variables
-    pthread_mutex_destroy(&mutex);
-    pthread_cond_destroy(&producer_cond);
-    pthread_cond_destroy(&consumer_cond);
+    // Taking drinks made room for baristas waiting at full stations
+    for (int b = 0; b < num_baristas; b++) {
+        Worker *barista = &baristas[b];
+        if (barista->pending >= 0 && order_queue_try_push(&stations[b], barista->pending)) {
+            barista->pending = -1;
+            barista->blocked_ns += sim_now - barista->blocked_since;
+            simulate_placed(barista);
+        }
+    }
+}
 
+// Runs the simulation until no events are left. Returns -1 if out of memory.
+static int simulate(Worker *baristas, Worker *waiters, uint64_t *processed) {
+    events = malloc((num_baristas + num_waiters) * sizeof(Event));
+    idle = malloc(num_waiters * sizeof(Worker *));
+    int *items = malloc(queue_size * sizeof(int));
+    placed_capacity = 1024;
+    placed_ns = malloc(placed_capacity * sizeof(uint64_t));
+    if (events == NULL || idle == NULL || items == NULL || placed_ns == NULL) {
+        return -1;
+    }
+
+    for (int w = 0; w < num_waiters; w++) {
+        idle[num_idle++] = &waiters[w]; // every station starts out empty
+    }
+    for (int b = 0; b < num_baristas; b++) {
+        simulate_prepare_next(&baristas[b]);
+    }
+    while (num_events > 0) {
+        Event event = next_event();
+        sim_now = event.time;
+        ++*processed;
+        if (event.type == EVENT_READY) {
+            simulate_ready(event.worker, baristas, items);
+        } else if (simulate_prepared(event.worker) < 0) {
+            return -1;
+        }
+    }
+
+    free(events);
+    free(idle);
+    free(items);
+    return 0;
+}
+
+// Starts a worker thread, pinned to a CPU if it has one.
+static int start_worker(Worker *worker, void *(*run)(void *)) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (worker->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    int error = pthread_create(&worker->thread, &attr, run, worker);
+    pthread_attr_destroy(&attr);
+    return error;
+}
+
+// Formats a duration given in nanoseconds with a unit to suit its size.
+static const char *format_duration(char *buffer, size_t size, double ns) {
+    if (ns < 1e3) {
+        snprintf(buffer, size, "%.0f ns", ns);
+    } else if (ns < 1e6) {
+        snprintf(buffer, size, "%.1f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        snprintf(buffer, size, "%.2f ms", ns / 1e6);
+    } else {
+        snprintf(buffer, size, "%.2f s", ns / 1e9);
+    }
+    return buffer;
+}
+
+static void report(Worker *baristas, Worker *waiters, double seconds, double wall_seconds, uint64_t events_processed) {
+    static Histogram waits;
+    unsigned long served = 0, stolen = 0, batches = 0, dropped = 0, rejected = 0;
+    uint64_t prepare_ns = 0, blocked_ns = 0, serve_ns = 0;
+    for (int i = 0; i < num_waiters; i++) {
+        served += waiters[i].drinks;
+        stolen += waiters[i].stolen;
+        batches += waiters[i].batches;
+        serve_ns += waiters[i].busy_ns;
+        histogram_merge(&waits, &waiters[i].waits);
+    }
+    for (int s = 0; s < num_baristas; s++) {
+        dropped += order_queue_dropped(&stations[s]);
+        rejected += baristas[s].rejected;
+        prepare_ns += baristas[s].busy_ns;
+        blocked_ns += baristas[s].blocked_ns;
+    }
+
+    char a[32], b[32], c[32], d[32];
+    if (mode == MODE_SIMULATE) {
+        printf("Simulated %d baristas, %d waiters for %s in %.3f s (%.0f events/s)\n", num_baristas, num_waiters,
+               format_duration(a, sizeof(a), seconds * 1e9), wall_seconds, events_processed / wall_seconds);
+        printf("  %lu drinks served, %.0f per hour, %lu stolen\n", served, seconds > 0 ? served * 3600 / seconds : 0.0,
+               stolen);
+    } else {
+        printf("%d baristas, %d waiters: %lu drinks served in %.3f s, %.0f drinks/s, %lu stolen\n", num_baristas,
+               num_waiters, served, seconds, served / seconds, stolen);
+    }
+    printf("  %.1f drinks taken per batch, %lu dropped, %lu rejected\n", batches ? (double)served / batches : 0.0,
+           dropped, rejected);
+    if (atomic_load(&waits.total) > 0) {
+        printf("  enqueue to dequeue: p50 %s, p99 %s, p99.9 %s, max %s\n",
+               format_duration(a, sizeof(a), histogram_percentile(&waits, 0.50)),
+               format_duration(b, sizeof(b), histogram_percentile(&waits, 0.99)),
+               format_duration(c, sizeof(c), histogram_percentile(&waits, 0.999)),
+               format_duration(d, sizeof(d), atomic_load(&waits.max)));
+    }
+    if (mode == MODE_SIMULATE && seconds > 0) {
+        double total_ns = seconds * 1e9;
+        printf("  baristas busy %.1f%%, blocked %.1f%%; waiters busy %.1f%%\n",
+               100 * prepare_ns / (total_ns * num_baristas), 100 * blocked_ns / (total_ns * num_baristas),
+               100 * serve_ns / (total_ns * num_waiters));
+    }
+    for (int i = 0; i < num_waiters; i++) {
+        printf("  waiter %d: %lu served, %lu stolen\n", i, waiters[i].drinks, waiters[i].stolen);
+    }
+}
+
+static int parse_count(const char *arg, long min, long max, long *out) {
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || *end != '\0' || value < min || value > max) {
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+static int parse_policy(const char *arg, OrderQueuePolicy *out) {
+    if (strcmp(arg, "block") == 0) {
+        *out = ORDER_QUEUE_BLOCK;
+    } else if (strcmp(arg, "drop") == 0) {
+        *out = ORDER_QUEUE_DROP_OLDEST;
+    } else if (strcmp(arg, "reject") == 0) {
+        *out = ORDER_QUEUE_REJECT;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_mode(const char *arg, Mode *out) {
+    if (strcmp(arg, "real") == 0) {
+        *out = MODE_REAL;
+    } else if (strcmp(arg, "sim") == 0) {
+        *out = MODE_SIMULATE;
+    } else if (strcmp(arg, "bench") == 0) {
+        *out = MODE_BENCHMARK;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_distribution(const char *arg, ServiceDistribution *out) {
+    if (strcmp(arg, "fixed") == 0) {
+        *out = SERVICE_FIXED;
+    } else if (strcmp(arg, "exp") == 0) {
+        *out = SERVICE_EXPONENTIAL;
+    } else if (strcmp(arg, "uniform") == 0) {
+        *out = SERVICE_UNIFORM;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-m mode] [-b baristas] [-w waiters] [-n drinks] [-T shift_seconds]\n"
+            "          [-Q queue_size] [-F full_policy] [-p prepare_us] [-s serve_us] [-D distribution]\n"
+            "          [-r seed] [-c] [-a] [-q]\n"
+            "  -m  real: threads prepare and serve drinks in real time (default)\n"
+            "      sim: simulate the same pipeline on a virtual clock, printing only the summary\n"
+            "      bench: threads with no preparing or serving time, to time the queues\n"
+            "  -b  number of barista threads, each with a station of its own (default 1)\n"
+            "  -w  number of waiter threads (default 1)\n"
+            "  -n  drinks each barista makes before the run ends, 0 for no end\n"
+            "      (default 0, or %d in bench mode)\n"
+            "  -T  sim: stop preparing drinks after this many simulated seconds\n"
+            "      (default: one hour, unless -n is given)\n"
+            "  -Q  drinks each station holds, a power of two of at least 2 (default %d)\n"
+            "  -F  when a station is full: block until there is room, drop the oldest drink\n"
+            "      or reject the new one (default block)\n"
+            "  -p  mean microseconds to prepare a drink (default %d s)\n"
+            "  -s  mean microseconds to serve a drink (default %d s)\n"
+            "  -D  how preparing and serving times vary: fixed, exp (exponential) or uniform\n"
+            "      (default fixed)\n"
+            "  -r  seed for the service time generators (default 1)\n"
+            "  -c  spin the CPU while preparing and serving instead of sleeping\n"
+            "  -a  pin each thread to a CPU of its own, while there are CPUs left\n"
+            "  -q  print only the summary\n",
+            prog, BENCHMARK_DRINKS, QUEUE_SIZE, BARISTA_TIME, WAITER_TIME);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "m:b:w:n:T:Q:F:p:s:D:r:caqh")) != -1) {
+        long value = 0;
+        int ok = 0;
+        switch (opt) {
+        case 'm':
+            ok = parse_mode(optarg, &mode);
+            break;
+        case 'b':
+            ok = parse_count(optarg, 1, MAX_WORKERS, &value);
+            num_baristas = (int)value;
+            break;
+        case 'w':
+            ok = parse_count(optarg, 1, MAX_WORKERS, &value);
+            num_waiters = (int)value;
+            break;
+        case 'n':
+            ok = parse_count(optarg, 0, INT_MAX / MAX_WORKERS, &drinks_per_barista);
+            break;
+        case 'T':
+            ok = parse_count(optarg, 1, 100L * 365 * 24 * 3600, &shift_seconds);
+            break;
+        case 'Q':
+            ok = parse_count(optarg, 2, 1L << 24, &queue_size);
+            if ((queue_size & (queue_size - 1)) != 0) {
+                ok = -1;
+            }
+            break;
+        case 'F':
+            ok = parse_policy(optarg, &full_policy);
+            break;
+        case 'p':
+            ok = parse_count(optarg, 0, 3600000000L, &prepare_us);
+            break;
+        case 's':
+            ok = parse_count(optarg, 0, 3600000000L, &serve_us);
+            break;
+        case 'D':
+            ok = parse_distribution(optarg, &distribution);
+            break;
+        case 'r':
+            ok = parse_count(optarg, 0, LONG_MAX, &seed);
+            break;
+        case 'c':
+            burn_cpu = 1;
+            break;
+        case 'a':
+            pin_threads = 1;
+            break;
+        case 'q':
+            verbose = 0;
+            break;
+        default:
+            ok = -1;
+            break;
+        }
+        if (ok < 0) {
+            usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (mode == MODE_BENCHMARK) {
+        prepare_us = serve_us = 0;
+        verbose = 0;
+        if (drinks_per_barista == 0) {
+            drinks_per_barista = BENCHMARK_DRINKS;
+        }
+    } else if (mode == MODE_SIMULATE) {
+        verbose = 0;
+        if (drinks_per_barista == 0 && shift_seconds == 0) {
+            shift_seconds = 3600;
+        }
+    }
+
+    // With one waiter, every station has a single producer and a single consumer
+    OrderQueueKind kind = num_waiters == 1 ? ORDER_QUEUE_SPSC : ORDER_QUEUE_MPMC;
+    stations = aligned_alloc(alignof(OrderQueue), num_baristas * sizeof(OrderQueue));
+    Worker *baristas = aligned_alloc(alignof(Worker), num_baristas * sizeof(Worker));
+    Worker *waiters = aligned_alloc(alignof(Worker), num_waiters * sizeof(Worker));
+    if (stations == NULL || baristas == NULL || waiters == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (int s = 0; s < num_baristas; s++) {
+        if (order_queue_init(&stations[s], kind, (size_t)queue_size, full_policy) < 0) {
+            perror("order_queue_init");
+            return EXIT_FAILURE;
+        }
+    }
+    atomic_init(&baristas_working, num_baristas);
+    if (mode != MODE_SIMULATE && drinks_per_barista > 0) {
+        placed_ns = malloc((size_t)drinks_per_barista * num_baristas * sizeof(uint64_t));
+        if (placed_ns == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // CPUs this process may run on, handed out to baristas and then waiters
+    int cpu_list[CPU_SETSIZE];
+    int num_cpus = 0;
+    cpu_set_t allowed;
+    if (pin_threads && sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpu_list[num_cpus++] = cpu;
+            }
+        }
+    }
+    for (int i = 0; i < num_baristas + num_waiters; i++) {
+        Worker *worker = i < num_baristas ? &baristas[i] : &waiters[i - num_baristas];
+        memset(worker, 0, sizeof(*worker));
+        worker->id = i < num_baristas ? i : i - num_baristas;
+        worker->cpu = i < num_cpus ? cpu_list[i] : -1;
+        worker->pending = -1;
+        // splitmix64 of the seed and worker, so every generator starts somewhere different
+        uint64_t state = (uint64_t)seed + (uint64_t)(i + 1) * 0x9E3779B97F4A7C15ULL;
+        state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+        worker->rng = (state ^ (state >> 31)) | 1;
+    }
+
+    uint64_t started = now_ns();
+    uint64_t events_processed = 0;
+    if (mode == MODE_SIMULATE) {
+        if (simulate(baristas, waiters, &events_processed) < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    } else {
+        // Create threads
+        for (int i = 0; i < num_waiters; i++) {
+            if (start_worker(&waiters[i], waiter) != 0) {
+                fprintf(stderr, "Cannot start waiter %d\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+        for (int i = 0; i < num_baristas; i++) {
+            if (start_worker(&baristas[i], barista) != 0) {
+                fprintf(stderr, "Cannot start barista %d\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Join threads (without -n they will run indefinitely in this simulation)
+        for (int i = 0; i < num_baristas; i++) {
+            pthread_join(baristas[i].thread, NULL);
+        }
+        for (int i = 0; i < num_waiters; i++) {
+            pthread_join(waiters[i].thread, NULL);
+        }
+    }
+    double wall_seconds = (now_ns() - started) / 1e9;
+    report(baristas, waiters, mode == MODE_SIMULATE ? sim_now / 1e9 : wall_seconds, wall_seconds, events_processed);
+
+    for (int s = 0; s < num_baristas; s++) {
+        order_queue_destroy(&stations[s]);
+    }
+    free(stations);
+    free(baristas);
+    free(waiters);
+    free(placed_ns);
     return 0;
 }
@@ -2,24 +2,40 @@
 #define BARISTA_WAITER_H
 
 #include <pthread.h>
+#include <stdalign.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "order_queue.h"
 
 // Constants
-#define QUEUE_SIZE 8
+#define QUEUE_SIZE 8    // default number of drinks a station holds
 #define BARISTA_TIME 4  // seconds
 #define WAITER_TIME 3   // seconds
+#define MAX_WORKERS 1024 // baristas, and separately waiters
+#define BENCHMARK_DRINKS 1000000 // default drinks per barista in bench mode
 
-// Shared queue and its management variables
-extern int order_queue[QUEUE_SIZE];
-extern int head;
-extern int tail;
-extern int count;
-
-// Mutex and condition variables for synchronization
-extern pthread_mutex_t mutex;
-extern pthread_cond_t producer_cond;
-extern pthread_cond_t consumer_cond;
+// A barista or waiter. In the threaded modes each is a thread sitting on cache
+// lines of its own, so counting drinks never contends with another worker; the
+// simulation plays them all on one thread.
+typedef struct {
+    alignas(CACHE_LINE_SIZE) int id;
+    int cpu;                // CPU the thread is pinned to, or -1
+    unsigned long drinks;   // drinks placed or served
+    unsigned long stolen;   // waiters: drinks taken from a station other than their home one
+    unsigned long batches;  // waiters: times they took drinks from a station
+    unsigned long rejected; // baristas: drinks turned away by a full station
+    uint64_t rng;           // state of the worker's service time generator
+    uint64_t busy_ns;       // simulation: time spent preparing or serving
+    uint64_t blocked_ns;    // simulation, baristas: time spent waiting for room at a full station
+    uint64_t blocked_since; // simulation, baristas: when the pending drink found its station full
+    int pending;            // simulation, baristas: drink waiting for room, or -1
+    Histogram waits;        // waiters: nanoseconds from each drink's enqueue to its dequeue
+    pthread_t thread;
+} Worker;
 
 // Function prototypes
+// Each thread takes its Worker as its argument. They run in the threaded modes.
 void *barista(void *arg);
 void *waiter(void *arg);
 
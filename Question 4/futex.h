@@ -0,0 +1,36 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Futex helpers
+// A waiter announces itself in a `waiting` count, reads an event word, checks for
+// work once more and then sleeps until the event word changes. A thread that makes
+// work available calls futex_notify(), which makes the system call only when a
+// waiter is announced.
+
+static inline void futex_wait(atomic_uint *word, unsigned expected) {
+    // Returns at once if *word no longer holds `expected`; spurious wakeups are
+    // fine, since callers check for work again
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static inline void futex_wake(atomic_uint *word, int count) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// Wakes up to `count` threads waiting on `event`. The fence orders the caller's
+// change before the read of `waiting`, and a waiter increments `waiting` before it
+// looks for work, so either the waiter sees the change or this sees the waiter.
+static inline void futex_notify(atomic_uint *event, atomic_uint *waiting, int count) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) > 0) {
+        atomic_fetch_add(event, 1);
+        futex_wake(event, count);
+    }
+}
+
+#endif // FUTEX_H
@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "futex.h"
+#include "order_queue.h"
+
+int order_queue_init(OrderQueue *q, OrderQueueKind kind, size_t capacity, OrderQueuePolicy policy) {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0 || capacity > SIZE_MAX / 2 / sizeof(OrderSlot)) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t bytes = (capacity * sizeof(OrderSlot) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    q->slots = aligned_alloc(CACHE_LINE_SIZE, bytes);
+    if (q->slots == NULL) {
+        return -1;
+    }
+
+    // Dropping the oldest order makes the producer a consumer as well
+    q->kind = policy == ORDER_QUEUE_DROP_OLDEST ? ORDER_QUEUE_MPMC : kind;
+    q->policy = policy;
+    q->capacity = capacity;
+    q->mask = capacity - 1;
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->head, 0);
+    q->cached_head = 0;
+    q->cached_tail = 0;
+    atomic_init(&q->dropped, 0);
+    atomic_init(&q->not_empty, 0);
+    atomic_init(&q->consumers_waiting, 0);
+    atomic_init(&q->not_full, 0);
+    atomic_init(&q->producers_waiting, 0);
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&q->slots[i].sequence, i);
+    }
+    return 0;
+}
+
+void order_queue_destroy(OrderQueue *q) {
+    free(q->slots);
+    q->slots = NULL;
+}
+
+// SPSC: only the producer writes `tail` and only the consumer writes `head`. A
+// release store of its own index publishes a run of slots to the other side.
+static size_t spsc_try_push_n(OrderQueue *q, const int *orders, size_t n) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t room = q->capacity - (tail - q->cached_head);
+    if (room < n) {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        room = q->capacity - (tail - q->cached_head);
+    }
+    if (n > room) {
+        n = room;
+    }
+    for (size_t i = 0; i < n; i++) {
+        q->slots[(tail + i) & q->mask].order = orders[i];
+    }
+    if (n > 0) {
+        atomic_store_explicit(&q->tail, tail + n, memory_order_release);
+    }
+    return n;
+}
+
+static size_t spsc_try_pop_n(OrderQueue *q, int *orders, size_t max) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t waiting = q->cached_tail - head;
+    if (waiting < max) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        waiting = q->cached_tail - head;
+    }
+    if (max > waiting) {
+        max = waiting;
+    }
+    for (size_t i = 0; i < max; i++) {
+        orders[i] = q->slots[(head + i) & q->mask].order;
+    }
+    if (max > 0) {
+        atomic_store_explicit(&q->head, head + max, memory_order_release);
+    }
+    return max;
+}
+
+// MPMC: a slot whose sequence equals position p is free for the producer that
+// claims p, and one whose sequence is p + 1 holds the order written at p. The
+// consumer that takes it sets the sequence to p + capacity, freeing the slot for
+// the next lap. A run of positions is claimed with one compare-and-swap once
+// every slot in it is ready; nobody else can touch those slots until the index
+// passes them, so the run stays ready.
+static size_t mpmc_try_push_n(OrderQueue *q, const int *orders, size_t n) {
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    while (n > 0) {
+        size_t sequence = atomic_load_explicit(&q->slots[pos & q->mask].sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)pos;
+        if (difference < 0) {
+            return 0; // the slot still holds last lap's order: full
+        }
+        if (difference > 0) {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+            continue;
+        }
+
+        size_t count = 1;
+        while (count < n && atomic_load_explicit(&q->slots[(pos + count) & q->mask].sequence,
+                                                 memory_order_acquire) == pos + count) {
+            count++;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + count, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            for (size_t i = 0; i < count; i++) {
+                OrderSlot *slot = &q->slots[(pos + i) & q->mask];
+                slot->order = orders[i];
+                atomic_store_explicit(&slot->sequence, pos + i + 1, memory_order_release);
+            }
+            return count;
+        }
+    }
+    return 0;
+}
+
+static size_t mpmc_try_pop_n(OrderQueue *q, int *orders, size_t max) {
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    while (max > 0) {
+        size_t sequence = atomic_load_explicit(&q->slots[pos & q->mask].sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (difference < 0) {
+            return 0; // nothing written at this position yet: empty
+        }
+        if (difference > 0) {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+            continue;
+        }
+
+        size_t count = 1;
+        while (count < max && atomic_load_explicit(&q->slots[(pos + count) & q->mask].sequence,
+                                                   memory_order_acquire) == pos + count + 1) {
+            count++;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + count, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            for (size_t i = 0; i < count; i++) {
+                OrderSlot *slot = &q->slots[(pos + i) & q->mask];
+                orders[i] = slot->order;
+                atomic_store_explicit(&slot->sequence, pos + i + q->capacity, memory_order_release);
+            }
+            return count;
+        }
+    }
+    return 0;
+}
+
+size_t order_queue_try_push_n(OrderQueue *q, const int *orders, size_t n) {
+    size_t pushed = q->kind == ORDER_QUEUE_SPSC ? spsc_try_push_n(q, orders, n) : mpmc_try_push_n(q, orders, n);
+    if (pushed > 0) {
+        futex_notify(&q->not_empty, &q->consumers_waiting, pushed < INT_MAX ? (int)pushed : INT_MAX);
+    }
+    return pushed;
+}
+
+size_t order_queue_try_pop_n(OrderQueue *q, int *orders, size_t max) {
+    size_t popped = q->kind == ORDER_QUEUE_SPSC ? spsc_try_pop_n(q, orders, max) : mpmc_try_pop_n(q, orders, max);
+    if (popped > 0) {
+        futex_notify(&q->not_full, &q->producers_waiting, popped < INT_MAX ? (int)popped : INT_MAX);
+    }
+    return popped;
+}
+
+bool order_queue_try_push(OrderQueue *q, int order) {
+    return order_queue_try_push_n(q, &order, 1) == 1;
+}
+
+bool order_queue_try_pop(OrderQueue *q, int *order) {
+    return order_queue_try_pop_n(q, order, 1) == 1;
+}
+
+size_t order_queue_push_n(OrderQueue *q, const int *orders, size_t n) {
+    size_t pushed = order_queue_try_push_n(q, orders, n);
+    while (pushed < n) {
+        switch (q->policy) {
+        case ORDER_QUEUE_REJECT:
+            errno = EAGAIN;
+            return pushed;
+        case ORDER_QUEUE_DROP_OLDEST: {
+            int discarded;
+            if (mpmc_try_pop_n(q, &discarded, 1) == 1) {
+                atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+            }
+            pushed += order_queue_try_push_n(q, orders + pushed, n - pushed);
+            break;
+        }
+        case ORDER_QUEUE_BLOCK: {
+            // Announce the wait before looking at the ring again (see futex_notify)
+            atomic_fetch_add(&q->producers_waiting, 1);
+            unsigned seen = atomic_load(&q->not_full);
+            size_t added = order_queue_try_push_n(q, orders + pushed, n - pushed);
+            if (added == 0) {
+                futex_wait(&q->not_full, seen);
+            }
+            atomic_fetch_sub(&q->producers_waiting, 1);
+            pushed += added;
+            break;
+        }
+        }
+    }
+    return pushed;
+}
+
+int order_queue_push(OrderQueue *q, int order) {
+    return order_queue_push_n(q, &order, 1) == 1 ? 0 : -1;
+}
+
+size_t order_queue_pop_n(OrderQueue *q, int *orders, size_t max) {
+    size_t taken = order_queue_try_pop_n(q, orders, max);
+    while (taken == 0) {
+        atomic_fetch_add(&q->consumers_waiting, 1);
+        unsigned seen = atomic_load(&q->not_empty);
+        taken = order_queue_try_pop_n(q, orders, max);
+        if (taken == 0) {
+            futex_wait(&q->not_empty, seen);
+        }
+        atomic_fetch_sub(&q->consumers_waiting, 1);
+    }
+    return taken;
+}
+
+int order_queue_pop(OrderQueue *q) {
+    int order;
+    order_queue_pop_n(q, &order, 1);
+    return order;
+}
+
+size_t order_queue_size(OrderQueue *q) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail <= head) {
+        return 0;
+    }
+    return tail - head < q->capacity ? tail - head : q->capacity;
+}
+
+unsigned long order_queue_dropped(OrderQueue *q) {
+    return atomic_load_explicit(&q->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,116 @@
+#ifndef ORDER_QUEUE_H
+#define ORDER_QUEUE_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Lock-free bounded queue of orders
+// Positions only ever increase; an order at position p lives in slot
+// p % capacity, with the capacity a power of two chosen when the queue is
+// created. The producer and consumer ends sit on cache lines of their own, so the
+// two sides never write to the same line.
+//
+// ORDER_QUEUE_SPSC is the fast path for one producer thread and one consumer
+// thread: each side owns its index outright and keeps a cached copy of the other
+// side's, so it only reads the other side's cache line when the ring looks full
+// (or empty). ORDER_QUEUE_MPMC serves any number of producers and consumers
+// (Vyukov's bounded queue): each slot carries a sequence number saying whether it
+// is ready to be written or read at a given position, and threads claim positions
+// with one compare-and-swap.
+//
+// The _n operations move a run of orders with that one index update and one
+// wakeup, instead of one of each per order.
+//
+// Neither variant takes a lock. Blocking operations sleep on a futex only while
+// the ring is full or empty; the other side issues a futex wake only when it sees
+// a thread waiting.
+typedef enum {
+    ORDER_QUEUE_SPSC,
+    ORDER_QUEUE_MPMC
+} OrderQueueKind;
+
+// What a blocking push does when the ring is full
+typedef enum {
+    ORDER_QUEUE_BLOCK,       // wait for a consumer to make room
+    ORDER_QUEUE_DROP_OLDEST, // discard the oldest order to make room; the producer takes
+                             // from the consumer end, so the queue works as MPMC
+    ORDER_QUEUE_REJECT       // fail with EAGAIN
+} OrderQueuePolicy;
+
+typedef struct {
+    atomic_size_t sequence; // MPMC only
+    int order;
+} OrderSlot;
+
+typedef struct {
+    OrderQueueKind kind;
+    OrderQueuePolicy policy;
+    size_t capacity;
+    size_t mask;
+    OrderSlot *slots;
+
+    // Producer end
+    alignas(CACHE_LINE_SIZE) atomic_size_t tail; // next position to write
+    size_t cached_head;                          // SPSC: the producer's last view of `head`
+    atomic_ulong dropped;                        // orders discarded by ORDER_QUEUE_DROP_OLDEST
+
+    // Consumer end
+    alignas(CACHE_LINE_SIZE) atomic_size_t head; // next position to read
+    size_t cached_tail;                          // SPSC: the consumer's last view of `tail`
+
+    // Futex words, bumped whenever the ring stops being empty (or full) while
+    // a consumer (or producer) is waiting
+    alignas(CACHE_LINE_SIZE) atomic_uint not_empty;
+    atomic_uint consumers_waiting;
+    alignas(CACHE_LINE_SIZE) atomic_uint not_full;
+    atomic_uint producers_waiting;
+} OrderQueue;
+
+// Sets up a queue holding up to `capacity` orders, which must be a power of two of
+// at least 2: with one slot, MPMC sequence numbers could not tell full from empty.
+// Returns -1 with errno set if the capacity is invalid or out of memory.
+int order_queue_init(OrderQueue *q, OrderQueueKind kind, size_t capacity, OrderQueuePolicy policy);
+
+// Frees the ring. No thread may be using the queue.
+void order_queue_destroy(OrderQueue *q);
+
+// Adds an order if there is room. Returns false, without waiting, if the ring is full.
+bool order_queue_try_push(OrderQueue *q, int order);
+
+// Takes the oldest order if there is one. Returns false, without waiting, if the ring is empty.
+bool order_queue_try_pop(OrderQueue *q, int *order);
+
+// Adds as many of the `n` orders as there is room for, in order, without waiting.
+// Returns how many were added.
+size_t order_queue_try_push_n(OrderQueue *q, const int *orders, size_t n);
+
+// Takes up to `max` of the oldest orders without waiting. Returns how many were taken.
+size_t order_queue_try_pop_n(OrderQueue *q, int *orders, size_t max);
+
+// Adds an order, applying the queue's policy if the ring is full. Returns 0, or -1
+// with errno EAGAIN if the policy is ORDER_QUEUE_REJECT and the ring was full.
+int order_queue_push(OrderQueue *q, int order);
+
+// Adds `n` orders, applying the queue's policy while the ring is full. Returns how
+// many were added: all of them, unless the policy is ORDER_QUEUE_REJECT, in which
+// case a short count comes with errno EAGAIN.
+size_t order_queue_push_n(OrderQueue *q, const int *orders, size_t n);
+
+// Takes the oldest order, sleeping while the ring is empty.
+int order_queue_pop(OrderQueue *q);
+
+// Takes every order waiting, up to `max` (at least 1), sleeping while the ring is
+// empty. Returns how many were taken.
+size_t order_queue_pop_n(OrderQueue *q, int *orders, size_t max);
+
+// Number of orders in the ring. Only a snapshot while other threads use it.
+size_t order_queue_size(OrderQueue *q);
+
+// Number of orders discarded to make room under ORDER_QUEUE_DROP_OLDEST.
+unsigned long order_queue_dropped(OrderQueue *q);
+
+#endif // ORDER_QUEUE_H
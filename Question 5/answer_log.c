@@ -0,0 +1,454 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "answer_log.h"
+#include "common.h"
+#include "logger.h"
+
+#define WRITE_BUFFER_SIZE (64 * 1024)
+#define MAX_RECORD_LINE (32 + USERNAME_SIZE + 32 + ANSWER_SIZE)
+// Progress is kept in this many independently locked hash tables, so students
+// graded on different event loops rarely contend.
+#define PROGRESS_STRIPES 64
+
+typedef struct LogRecord {
+    _Atomic(struct LogRecord *) next;
+    long long time_ms;
+    size_t question;
+    bool correct;
+    char username[USERNAME_SIZE];
+    char answer[ANSWER_SIZE];
+} LogRecord;
+
+typedef struct {
+    char username[USERNAME_SIZE]; // empty marks an unused entry
+    size_t answered;
+    size_t score;
+} Progress;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    Progress *entries; // open addressing, at most half full
+    size_t capacity;
+    size_t used;
+} ProgressStripe;
+
+struct AnswerLog {
+    int fd;
+    int sync_interval_ms;
+    size_t sync_bytes;
+
+    // Intrusive MPSC queue (Vyukov): producers swap their record in at `head` with
+    // one atomic exchange, the writer thread consumes from `tail`. `stub` keeps the
+    // queue non-empty so neither end ever needs a lock.
+    _Atomic(LogRecord *) head;
+    LogRecord *tail;
+    LogRecord stub;
+
+    // Set by the writer before it sleeps; the producer that clears it wakes it up
+    atomic_bool writer_idle;
+    atomic_bool stopping;
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_cond;
+    pthread_t writer;
+
+    char buffer[WRITE_BUFFER_SIZE];
+    size_t buffered;
+    unsigned long long records_written;
+    unsigned long long syncs;
+
+    ProgressStripe stripes[PROGRESS_STRIPES];
+};
+
+static long long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static long long realtime_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Copies a field, replacing the tabs and newlines that would break the line format.
+static void copy_field(char *dst, const char *src, size_t size) {
+    size_t i = 0;
+    for (; i < size - 1 && src[i] != '\0'; i++) {
+        dst[i] = (src[i] == '\t' || src[i] == '\n' || src[i] == '\r') ? ' ' : src[i];
+    }
+    dst[i] = '\0';
+}
+
+static Progress *find_progress(ProgressStripe *stripe, const char *username, uint64_t hash) {
+    size_t mask = stripe->capacity - 1;
+    size_t i = (hash / PROGRESS_STRIPES) & mask;
+    while (stripe->entries[i].username[0] != '\0' && strcmp(stripe->entries[i].username, username) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &stripe->entries[i];
+}
+
+static bool grow_stripe(ProgressStripe *stripe) {
+    size_t capacity = stripe->capacity ? 2 * stripe->capacity : 16;
+    Progress *old = stripe->entries;
+    size_t old_capacity = stripe->capacity;
+
+    stripe->entries = calloc(capacity, sizeof(Progress));
+    if (stripe->entries == NULL) {
+        stripe->entries = old;
+        return false;
+    }
+    stripe->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].username[0] != '\0') {
+            *find_progress(stripe, old[i].username, hash_username(old[i].username)) = old[i];
+        }
+    }
+    free(old);
+    return true;
+}
+
+static void update_progress(AnswerLog *log, const char *username, size_t question, bool correct) {
+    uint64_t hash = hash_username(username);
+    ProgressStripe *stripe = &log->stripes[hash % PROGRESS_STRIPES];
+
+    pthread_mutex_lock(&stripe->mutex);
+    if ((stripe->used + 1) * 2 > stripe->capacity && !grow_stripe(stripe)) {
+        pthread_mutex_unlock(&stripe->mutex);
+        log_error("Out of memory: progress of %s not updated", username);
+        return;
+    }
+    Progress *p = find_progress(stripe, username, hash);
+    if (p->username[0] == '\0') {
+        strcpy(p->username, username);
+        stripe->used++;
+    }
+    if (question + 1 > p->answered) {
+        p->answered = question + 1;
+    }
+    p->score += correct;
+    pthread_mutex_unlock(&stripe->mutex);
+}
+
+bool answer_log_progress(AnswerLog *log, const char *username, size_t *answered, size_t *score) {
+    uint64_t hash = hash_username(username);
+    ProgressStripe *stripe = &log->stripes[hash % PROGRESS_STRIPES];
+    bool found = false;
+
+    pthread_mutex_lock(&stripe->mutex);
+    if (stripe->capacity > 0) {
+        Progress *p = find_progress(stripe, username, hash);
+        if (p->username[0] != '\0') {
+            *answered = p->answered;
+            *score = p->score;
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&stripe->mutex);
+    return found;
+}
+
+static void push_record(AnswerLog *log, LogRecord *record) {
+    atomic_store_explicit(&record->next, NULL, memory_order_relaxed);
+    LogRecord *prev = atomic_exchange(&log->head, record);
+    atomic_store_explicit(&prev->next, record, memory_order_release);
+}
+
+// Takes the oldest record off the queue. Returns NULL if the queue is empty, or
+// if a producer is between its exchange and its link (the writer then retries).
+static LogRecord *pop_record(AnswerLog *log) {
+    LogRecord *tail = log->tail;
+    LogRecord *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &log->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        log->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next != NULL) {
+        log->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load(&log->head)) {
+        return NULL;
+    }
+    // `tail` is the last record: put the stub behind it so it can be taken
+    push_record(log, &log->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != NULL) {
+        log->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+void answer_log_record(AnswerLog *log, const char *username, size_t question, const char *answer, bool correct) {
+    update_progress(log, username, question, correct);
+
+    LogRecord *record = malloc(sizeof(LogRecord));
+    if (record == NULL) {
+        log_error("Out of memory: answer of %s to question %zu not logged", username, question);
+        return;
+    }
+    record->time_ms = realtime_ms();
+    record->question = question;
+    record->correct = correct;
+    copy_field(record->username, username, USERNAME_SIZE);
+    copy_field(record->answer, answer, ANSWER_SIZE);
+    push_record(log, record);
+
+    if (atomic_load(&log->writer_idle) && atomic_exchange(&log->writer_idle, false)) {
+        pthread_mutex_lock(&log->wake_mutex);
+        pthread_cond_signal(&log->wake_cond);
+        pthread_mutex_unlock(&log->wake_mutex);
+    }
+}
+
+static void write_buffer(AnswerLog *log) {
+    for (size_t written = 0; written < log->buffered;) {
+        ssize_t n = write(log->fd, log->buffer + written, log->buffered - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("answer log write: %s", strerror(errno));
+            break;
+        }
+        written += n;
+    }
+    log->buffered = 0;
+}
+
+// Formats every queued record into the write buffer, writing it out whenever it
+// fills. Returns the number of bytes added.
+static size_t drain_queue(AnswerLog *log) {
+    size_t bytes = 0;
+    LogRecord *record;
+
+    while ((record = pop_record(log)) != NULL) {
+        if (log->buffered + MAX_RECORD_LINE > WRITE_BUFFER_SIZE) {
+            write_buffer(log);
+        }
+        int n = snprintf(log->buffer + log->buffered, MAX_RECORD_LINE, "%lld\t%s\t%zu\t%d\t%s\n", record->time_ms,
+                         record->username, record->question, record->correct ? 1 : 0, record->answer);
+        log->buffered += n;
+        bytes += n;
+        log->records_written++;
+        free(record);
+    }
+    return bytes;
+}
+
+// Group commit: one write and one fdatasync for everything drained since the last one.
+static void commit(AnswerLog *log) {
+    write_buffer(log);
+    if (fdatasync(log->fd) < 0) {
+        log_error("answer log fdatasync: %s", strerror(errno));
+    }
+    log->syncs++;
+}
+
+// Sleeps until a record is queued, or until `deadline_ms` (CLOCK_MONOTONIC) if it
+// is not negative.
+static void wait_for_records(AnswerLog *log, long long deadline_ms) {
+    atomic_store(&log->writer_idle, true);
+    if (atomic_load(&log->head) != log->tail || atomic_load(&log->stopping)) {
+        atomic_store(&log->writer_idle, false);
+        return;
+    }
+
+    struct timespec deadline = {deadline_ms / 1000, (deadline_ms % 1000) * 1000000};
+    pthread_mutex_lock(&log->wake_mutex);
+    while (atomic_load(&log->writer_idle) && !atomic_load(&log->stopping)) {
+        if (deadline_ms < 0) {
+            pthread_cond_wait(&log->wake_cond, &log->wake_mutex);
+        } else if (pthread_cond_timedwait(&log->wake_cond, &log->wake_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&log->wake_mutex);
+    atomic_store(&log->writer_idle, false);
+}
+
+// Writer thread
+static void *run_writer(void *arg) {
+    AnswerLog *log = (AnswerLog *)arg;
+    size_t unsynced = 0;        // bytes drained since the last commit
+    long long oldest_ms = 0;    // when the first of them was drained
+
+    while (true) {
+        bool stopping = atomic_load(&log->stopping);
+        size_t drained = drain_queue(log);
+        if (drained > 0 && unsynced == 0) {
+            oldest_ms = monotonic_ms();
+        }
+        unsynced += drained;
+
+        if (unsynced > 0 &&
+            (stopping || unsynced >= log->sync_bytes || monotonic_ms() - oldest_ms >= log->sync_interval_ms)) {
+            commit(log);
+            unsynced = 0;
+        }
+        if (stopping && unsynced == 0 && atomic_load(&log->head) == log->tail) {
+            break;
+        }
+        if (drained == 0) {
+            wait_for_records(log, unsynced > 0 ? oldest_ms + log->sync_interval_ms : -1);
+        }
+    }
+    return NULL;
+}
+
+// Replays the log into the progress tables. A last line without its newline was
+// torn by a crash mid-write and is cut off, so new records start on a fresh line;
+// an over-long line elsewhere is only skipped as malformed.
+static bool recover(AnswerLog *log, const char *path, bool *created, char *error, size_t error_len) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        if (errno == ENOENT) {
+            *created = true;
+            return true;
+        }
+        snprintf(error, error_len, "%s: %s", path, strerror(errno));
+        return false;
+    }
+
+    char line[2 * MAX_RECORD_LINE];
+    off_t valid = 0;
+    bool torn = false;
+    size_t records = 0, malformed = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n') {
+            if (feof(file)) {
+                torn = true;
+                break;
+            }
+            // Longer than any record we write: skip the rest of it. Running into
+            // the end of the file first still means it was torn.
+            size_t skipped = len;
+            bool ended = false;
+            while (!ended && fgets(line, sizeof(line), file) != NULL) {
+                len = strlen(line);
+                ended = line[len - 1] == '\n';
+                skipped += len;
+            }
+            if (!ended) {
+                torn = true;
+                break;
+            }
+            valid += skipped;
+            malformed++;
+            continue;
+        }
+        valid += len;
+        line[len - 1] = '\0';
+
+        // time, username, question, correct, answer
+        char *fields[5];
+        fields[0] = line;
+        int n = 1;
+        for (char *tab = line; n < 5 && (tab = strchr(tab, '\t')) != NULL; n++) {
+            *tab++ = '\0';
+            fields[n] = tab;
+        }
+        char *end = NULL;
+        unsigned long long question = n == 5 ? strtoull(fields[2], &end, 10) : 0;
+        if (n < 5 || *end != '\0' || fields[1][0] == '\0' || strlen(fields[1]) >= USERNAME_SIZE) {
+            malformed++;
+            continue;
+        }
+        update_progress(log, fields[1], (size_t)question, fields[3][0] == '1');
+        records++;
+    }
+    fclose(file);
+
+    if (torn && truncate(path, valid) < 0) {
+        snprintf(error, error_len, "%s: cannot cut off torn record: %s", path, strerror(errno));
+        return false;
+    }
+    log_info("Recovered %zu answers from %s%s", records, path, torn ? " (cut off a torn last record)" : "");
+    if (malformed > 0) {
+        log_warn("Skipped %zu malformed lines in %s", malformed, path);
+    }
+    return true;
+}
+
+AnswerLog *answer_log_open(const char *path, int sync_interval_ms, size_t sync_bytes, char *error, size_t error_len) {
+    AnswerLog *log = calloc(1, sizeof(AnswerLog));
+    if (log == NULL) {
+        snprintf(error, error_len, "out of memory");
+        return NULL;
+    }
+    log->sync_interval_ms = sync_interval_ms;
+    log->sync_bytes = sync_bytes;
+    atomic_init(&log->stub.next, NULL);
+    atomic_init(&log->head, &log->stub);
+    log->tail = &log->stub;
+    atomic_init(&log->writer_idle, false);
+    atomic_init(&log->stopping, false);
+    pthread_mutex_init(&log->wake_mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log->wake_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    for (int i = 0; i < PROGRESS_STRIPES; i++) {
+        pthread_mutex_init(&log->stripes[i].mutex, NULL);
+    }
+
+    bool created = false;
+    if (!recover(log, path, &created, error, error_len)) {
+        free(log);
+        return NULL;
+    }
+    log->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (log->fd < 0) {
+        snprintf(error, error_len, "%s: %s", path, strerror(errno));
+        free(log);
+        return NULL;
+    }
+    if (created) {
+        // Make the new file's directory entry durable too
+        char *copy = strdup(path);
+        int dir = copy != NULL ? open(dirname(copy), O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+        if (dir >= 0) {
+            fsync(dir);
+            close(dir);
+        }
+        free(copy);
+    }
+
+    if (pthread_create(&log->writer, NULL, run_writer, log) != 0) {
+        snprintf(error, error_len, "cannot start the answer log writer");
+        close(log->fd);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void answer_log_close(AnswerLog *log) {
+    atomic_store(&log->stopping, true);
+    pthread_mutex_lock(&log->wake_mutex);
+    pthread_cond_signal(&log->wake_cond);
+    pthread_mutex_unlock(&log->wake_mutex);
+    pthread_join(log->writer, NULL);
+    close(log->fd);
+    log_info("Answer log closed: %llu answers written in %llu commits", log->records_written, log->syncs);
+}
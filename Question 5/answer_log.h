@@ -0,0 +1,42 @@
+#ifndef ANSWER_LOG_H
+#define ANSWER_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Durable record of every graded answer
+// Graded answers are appended to a text log, one line per answer:
+//
+//     <unix time in ms> TAB <username> TAB <question index> TAB <1 if correct, else 0> TAB <answer>
+//
+// The event loops never touch the file: answer_log_record() pushes the record onto
+// a lock-free multi-producer queue and returns. A writer thread drains the queue,
+// batches the records into large write()s, and commits them together with one
+// fdatasync() once the oldest uncommitted record is sync_interval_ms old or
+// sync_bytes have accumulated, whichever comes first (group commit). A crash can
+// therefore lose at most the last interval's answers, and a line torn by the crash
+// is discarded when the log is next opened.
+//
+// Opening the log replays it to rebuild every student's progress (questions
+// answered and score), so a student who reconnects after a restart resumes where
+// they left off.
+
+typedef struct AnswerLog AnswerLog;
+
+// Opens (creating if needed) and recovers the log at `path`, then starts its
+// writer thread. Returns NULL and describes the problem in `error` on failure.
+AnswerLog *answer_log_open(const char *path, int sync_interval_ms, size_t sync_bytes, char *error, size_t error_len);
+
+// Records a graded answer and updates the student's progress. Callable from any
+// thread; the record reaches the disk asynchronously.
+void answer_log_record(AnswerLog *log, const char *username, size_t question, const char *answer, bool correct);
+
+// Looks up a student's progress: how many questions they have answered (the index
+// of the next one) and how many of those were correct. Returns false if the
+// student has not answered anything yet.
+bool answer_log_progress(AnswerLog *log, const char *username, size_t *answered, size_t *score);
+
+// Writes and syncs every record queued so far, stops the writer thread and closes the log.
+void answer_log_close(AnswerLog *log);
+
+#endif // ANSWER_LOG_H
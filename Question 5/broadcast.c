@@ -0,0 +1,310 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "broadcast.h"
+#include "logger.h"
+#include "protocol.h"
+
+typedef struct {
+    char username[USERNAME_SIZE];
+    int change; // +1 joined, -1 left
+} RosterEvent;
+
+// Everyone in the roster, with how many connections each is logged in on.
+// Open addressing with linear probing; only the broadcaster thread touches it.
+typedef struct {
+    char username[USERNAME_SIZE];
+    int count; // 0 marks an empty entry
+} RosterEntry;
+
+static RosterDeliver deliver;
+
+// Events recorded since the last tick. The lock is only held to append an event
+// or to swap the array out, so the event loops never wait on a broadcast.
+static pthread_mutex_t events_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t events_cond = PTHREAD_COND_INITIALIZER;
+static RosterEvent *events;
+static size_t num_events, events_capacity;
+static bool snapshot_wanted;
+
+static RosterEntry *roster;
+static size_t roster_capacity, roster_used;
+
+SharedBuffer *shared_buffer_new(size_t len) {
+    SharedBuffer *buf = malloc(sizeof(SharedBuffer) + len);
+    if (buf != NULL) {
+        atomic_init(&buf->refs, 1);
+        buf->len = len;
+    }
+    return buf;
+}
+
+SharedBuffer *shared_buffer_ref(SharedBuffer *buf) {
+    atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+    return buf;
+}
+
+void shared_buffer_unref(SharedBuffer *buf) {
+    if (buf != NULL && atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) == 1) {
+        free(buf);
+    }
+}
+
+static void record_event(const char *username, int change) {
+    pthread_mutex_lock(&events_mutex);
+    if (num_events == events_capacity) {
+        size_t capacity = events_capacity ? 2 * events_capacity : 64;
+        RosterEvent *grown = realloc(events, capacity * sizeof(RosterEvent));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&events_mutex);
+            log_error("Out of memory: roster event for %s lost", username);
+            return;
+        }
+        events = grown;
+        events_capacity = capacity;
+    }
+    RosterEvent *event = &events[num_events++];
+    strncpy(event->username, username, USERNAME_SIZE - 1);
+    event->username[USERNAME_SIZE - 1] = '\0';
+    event->change = change;
+    if (change > 0) {
+        snapshot_wanted = true;
+    }
+    pthread_cond_signal(&events_cond);
+    pthread_mutex_unlock(&events_mutex);
+}
+
+void roster_joined(const char *username) {
+    record_event(username, +1);
+}
+
+void roster_left(const char *username) {
+    record_event(username, -1);
+}
+
+static RosterEntry *find_entry(RosterEntry *table, size_t capacity, const char *username) {
+    size_t i = hash_username(username) & (capacity - 1);
+    while (table[i].count != 0 && strcmp(table[i].username, username) != 0) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &table[i];
+}
+
+static bool grow_roster(void) {
+    size_t capacity = roster_capacity ? 2 * roster_capacity : 64;
+    RosterEntry *table = calloc(capacity, sizeof(RosterEntry));
+    if (table == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < roster_capacity; i++) {
+        if (roster[i].count != 0) {
+            *find_entry(table, capacity, roster[i].username) = roster[i];
+        }
+    }
+    free(roster);
+    roster = table;
+    roster_capacity = capacity;
+    return true;
+}
+
+// Removes an entry, shifting later entries of its probe run back so lookups
+// never need tombstones.
+static void remove_entry(RosterEntry *entry) {
+    size_t hole = (size_t)(entry - roster);
+    size_t i = hole;
+    while (true) {
+        i = (i + 1) & (roster_capacity - 1);
+        if (roster[i].count == 0) {
+            break;
+        }
+        size_t home = hash_username(roster[i].username) & (roster_capacity - 1);
+        // Move the entry into the hole unless its home lies cyclically in (hole, i]
+        if ((i > hole && (home <= hole || home > i)) || (i < hole && home <= hole && home > i)) {
+            roster[hole] = roster[i];
+            hole = i;
+        }
+    }
+    roster[hole].count = 0;
+    roster_used--;
+}
+
+// Applies one username's net change to the roster.
+static void apply_change(const char *username, int change) {
+    if ((roster_used + 1) * 2 > roster_capacity && !grow_roster()) {
+        log_error("Out of memory: roster not updated for %s", username);
+        return;
+    }
+    RosterEntry *entry = find_entry(roster, roster_capacity, username);
+    if (entry->count == 0) {
+        if (change <= 0) {
+            return;
+        }
+        strcpy(entry->username, username);
+        roster_used++;
+    }
+    entry->count += change;
+    if (entry->count <= 0) {
+        remove_entry(entry);
+    }
+}
+
+static int compare_events(const void *a, const void *b) {
+    return strcmp(((const RosterEvent *)a)->username, ((const RosterEvent *)b)->username);
+}
+
+// Packs space-separated items into as many `type` frames as they need, appended
+// to `out`, starting a new frame whenever the next item would not fit.
+typedef struct {
+    uint8_t *out;
+    size_t len;
+    MessageType type;
+    char payload[BUFFER_SIZE];
+    size_t payload_len;
+} FrameWriter;
+
+static void flush_frame(FrameWriter *w) {
+    if (w->payload_len > 0) {
+        w->len += encode_frame(w->out + w->len, w->type, w->payload, w->payload_len);
+        w->payload_len = 0;
+    }
+}
+
+static void write_item(FrameWriter *w, char sign, const char *username) {
+    size_t name_len = strlen(username);
+    size_t item_len = name_len + 2;
+    if (w->payload_len + item_len > BUFFER_SIZE - 1) {
+        flush_frame(w);
+    }
+    w->payload[w->payload_len++] = sign;
+    memcpy(w->payload + w->payload_len, username, name_len);
+    w->payload_len += name_len;
+    w->payload[w->payload_len++] = ' ';
+}
+
+// Frames needed for `items` items of at most USERNAME_SIZE + 1 bytes each.
+static size_t frames_bound(size_t items) {
+    size_t per_frame = (BUFFER_SIZE - 1) / (USERNAME_SIZE + 1);
+    return (items + per_frame - 1) / per_frame + 1;
+}
+
+// Serializes the net effect of one tick's events as ACTIVE_STUDENTS_DELTA frames,
+// applying it to the roster. Returns NULL if the events cancel out, or if out of
+// memory (the roster is still updated, and the next snapshot is correct).
+static SharedBuffer *build_delta(RosterEvent *batch, size_t count) {
+    qsort(batch, count, sizeof(RosterEvent), compare_events);
+
+    SharedBuffer *buf = shared_buffer_new(frames_bound(count) * MAX_FRAME_SIZE);
+    FrameWriter w = {.out = buf != NULL ? buf->data : NULL, .type = ACTIVE_STUDENTS_DELTA};
+
+    for (size_t i = 0; i < count;) {
+        int net = 0;
+        size_t j = i;
+        for (; j < count && strcmp(batch[j].username, batch[i].username) == 0; j++) {
+            net += batch[j].change;
+        }
+        apply_change(batch[i].username, net);
+        for (; buf != NULL && net > 0; net--) {
+            write_item(&w, '+', batch[i].username);
+        }
+        for (; buf != NULL && net < 0; net++) {
+            write_item(&w, '-', batch[i].username);
+        }
+        i = j;
+    }
+    if (buf == NULL) {
+        return NULL;
+    }
+    flush_frame(&w);
+
+    if (w.len == 0) {
+        shared_buffer_unref(buf);
+        return NULL;
+    }
+    buf->len = w.len;
+    return buf;
+}
+
+// Serializes the whole roster as one ACTIVE_STUDENTS_UPDATE, truncated to what fits.
+static SharedBuffer *build_snapshot(void) {
+    static const char prefix[] = "Active Students: ";
+    char payload[BUFFER_SIZE];
+    size_t len = sizeof(prefix) - 1;
+
+    memcpy(payload, prefix, len);
+    for (size_t i = 0; i < roster_capacity; i++) {
+        if (roster[i].count == 0) {
+            continue;
+        }
+        size_t name_len = strlen(roster[i].username);
+        for (int n = 0; n < roster[i].count && len + name_len + 1 <= BUFFER_SIZE - 1; n++) {
+            memcpy(payload + len, roster[i].username, name_len);
+            payload[len + name_len] = ' ';
+            len += name_len + 1;
+        }
+    }
+
+    SharedBuffer *buf = shared_buffer_new(MAX_FRAME_SIZE);
+    if (buf != NULL) {
+        buf->len = encode_frame(buf->data, ACTIVE_STUDENTS_UPDATE, payload, len);
+    }
+    return buf;
+}
+
+// Broadcaster thread
+// Sleeps until an event is recorded, waits one tick so that the logins and
+// logouts arriving together (typically at the start of an exam) are coalesced,
+// then serializes them once and hands the result to the event loops.
+static void *run_broadcaster(void *arg) {
+    (void)arg;
+    RosterEvent *batch = NULL;
+    size_t batch_capacity = 0;
+
+    while (true) {
+        pthread_mutex_lock(&events_mutex);
+        while (num_events == 0) {
+            pthread_cond_wait(&events_cond, &events_mutex);
+        }
+        pthread_mutex_unlock(&events_mutex);
+
+        struct timespec tick = {0, ROSTER_TICK_MS * 1000000L};
+        nanosleep(&tick, NULL);
+
+        // Swap the event array with our own so recording can carry on meanwhile
+        pthread_mutex_lock(&events_mutex);
+        RosterEvent *recorded = events;
+        size_t count = num_events;
+        size_t capacity = events_capacity;
+        events = batch;
+        events_capacity = batch_capacity;
+        num_events = 0;
+        bool want_snapshot = snapshot_wanted;
+        snapshot_wanted = false;
+        pthread_mutex_unlock(&events_mutex);
+        batch = recorded;
+        batch_capacity = capacity;
+
+        SharedBuffer *delta = build_delta(batch, count);
+        SharedBuffer *snapshot = want_snapshot ? build_snapshot() : NULL;
+        if (delta != NULL || snapshot != NULL) {
+            deliver(delta, snapshot);
+        }
+        shared_buffer_unref(delta);
+        shared_buffer_unref(snapshot);
+    }
+    return NULL;
+}
+
+int roster_start(RosterDeliver deliver_update) {
+    pthread_t thread_id;
+
+    deliver = deliver_update;
+    if (!grow_roster() || pthread_create(&thread_id, NULL, run_broadcaster, NULL) != 0) {
+        return -1;
+    }
+    pthread_detach(thread_id);
+    return 0;
+}
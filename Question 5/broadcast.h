@@ -0,0 +1,50 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Bytes ready to go on the wire (one or more encoded frames), shared by every
+// connection they are queued on and freed when the last reference is dropped.
+typedef struct {
+    atomic_int refs;
+    size_t len;
+    uint8_t data[];
+} SharedBuffer;
+
+// Allocates a buffer of `len` bytes holding one reference. Returns NULL if out of memory.
+SharedBuffer *shared_buffer_new(size_t len);
+SharedBuffer *shared_buffer_ref(SharedBuffer *buf);
+void shared_buffer_unref(SharedBuffer *buf);
+
+// Active student roster
+// Logins and logouts are recorded as events, and a broadcaster thread turns all
+// the events of one ROSTER_TICK_MS tick into a single delta: an
+// ACTIVE_STUDENTS_DELTA message whose payload lists "+name" for every student who
+// joined and "-name" for every one who left (a join and leave within the same
+// tick cancel out). The delta is serialized once and handed to `deliver`, which
+// fans the same buffer out to every authenticated client.
+//
+// A client that has just authenticated needs the whole roster first: after
+// recording its join, the server waits for the next update that carries a
+// snapshot (an ACTIVE_STUDENTS_UPDATE listing everyone, truncated to one
+// message), sends it that, and from then on sends it the deltas. Every event is
+// either in a snapshot or in a later delta, never both.
+#define ROSTER_TICK_MS 50
+
+// Receives one tick's update. `delta` is NULL if nothing changed on balance and
+// `snapshot` is NULL if no client asked for one. The broadcaster drops its own
+// references once this returns, so it must take references to keep them.
+typedef void (*RosterDeliver)(SharedBuffer *delta, SharedBuffer *snapshot);
+
+// Starts the broadcaster thread. Returns -1 on failure, 0 otherwise.
+int roster_start(RosterDeliver deliver);
+
+// Records that a student joined (and asks for a snapshot in the next update) or left.
+void roster_joined(const char *username);
+void roster_left(const char *username);
+
+#endif // BROADCAST_H
@@ -7,12 +7,14 @@
 #include <stdbool.h>
 
 #include "common.h"
+#include "protocol.h"
 
 int main() {
     int sock = 0;
     struct sockaddr_in serv_addr;
     char username[USERNAME_SIZE];
     bool authenticated = false;
+    FrameReader reader = {0}; // reassembles frames that TCP delivers in pieces
 
     // Create socket file descriptor
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
@@ -47,15 +49,13 @@ int main() {
         fgets(username, USERNAME_SIZE, stdin);
         username[strcspn(username, "\n")] = 0; // Remove newline character
 
-        Message auth_request;
-        auth_request.type = AUTH_REQUEST;
-        strncpy(auth_request.payload, username, USERNAME_SIZE);
-        send(sock, &auth_request, sizeof(Message), 0);
+        if (send_message(sock, AUTH_REQUEST, username) < 0) {
+            printf("Server disconnected during authentication.\n");
+            break;
+        }
 
         Message response;
-        ssize_t bytes_received = recv(sock, &response, sizeof(Message), 0);
-
-        if (bytes_received <= 0) {
+        if (recv_message(sock, &reader, &response) < 0) {
             printf("Server disconnected during authentication.\n");
             break;
         }
@@ -78,14 +78,14 @@ int main() {
     // Exam Loop
     // After successful authentication, the client enters the exam session.
     // Message Exchange: The client continuously receives messages from the
-    // server. It expects a QUESTION_DELIVERY message, then prompts the user
-    // for an answer and sends it back as an ANSWER_SUBMISSION message.
-    // It also displays FEEDBACK_CORRECT/INCORRECT messages and ACTIVE_STUDENTS_UPDATEs.
+    // server. For every QUESTION_DELIVERY message it prompts the user for an
+    // answer and sends it back as an ANSWER_SUBMISSION message.
+    // It also displays FEEDBACK_CORRECT/INCORRECT messages, the ACTIVE_STUDENTS_UPDATE
+    // snapshot sent after login and the ACTIVE_STUDENTS_DELTA changes that follow it.
     // The loop breaks when an EXAM_ENDED message is received or the server disconnects.
     Message server_msg;
     while (true) {
-        ssize_t bytes_received = recv(sock, &server_msg, sizeof(Message), 0);
-        if (bytes_received <= 0) {
+        if (recv_message(sock, &reader, &server_msg) < 0) {
             printf("Server disconnected. Exam session ended.\n");
             break;
         }
@@ -97,17 +97,17 @@ int main() {
             fgets(answer, ANSWER_SIZE, stdin);
             answer[strcspn(answer, "\n")] = 0; // Remove newline character
 
-            Message answer_submission;
-            answer_submission.type = ANSWER_SUBMISSION;
-            strncpy(answer_submission.payload, answer, ANSWER_SIZE);
-            send(sock, &answer_submission, sizeof(Message), 0);
+            send_message(sock, ANSWER_SUBMISSION, answer);
         } else if (server_msg.type == FEEDBACK_CORRECT) {
             printf("%s\n", server_msg.payload);
         } else if (server_msg.type == FEEDBACK_INCORRECT) {
             printf("%s\n", server_msg.payload);
         } else if (server_msg.type == ACTIVE_STUDENTS_UPDATE) {
             printf("%s\n", server_msg.payload);
+        } else if (server_msg.type == ACTIVE_STUDENTS_DELTA) {
+            printf("Students joined (+) / left (-): %s\n", server_msg.payload);
         } else if (server_msg.type == EXAM_ENDED) {
+            printf("%s\n", server_msg.payload);
             printf("Exam session ended. Thank you, %s.\n", username);
             break;
         }
@@ -2,8 +2,9 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdint.h>
+
 #define PORT 8080
-#define MAX_CLIENTS 4
 #define BUFFER_SIZE 1024
 #define USERNAME_SIZE 50
 #define QUESTION_SIZE 256
@@ -19,12 +20,25 @@ typedef enum {
     FEEDBACK_CORRECT,
     FEEDBACK_INCORRECT,
     ACTIVE_STUDENTS_UPDATE,
-    EXAM_ENDED
+    EXAM_ENDED,
+    ACTIVE_STUDENTS_DELTA // "+name" for students who joined, "-name" for those who left
 } MessageType;
 
+// A decoded message. Messages travel as compact length-prefixed frames (see
+// protocol.h) rather than as this fixed-size struct; the payload is a
+// NUL-terminated string of at most BUFFER_SIZE - 1 bytes.
 typedef struct {
     MessageType type;
     char payload[BUFFER_SIZE];
 } Message;
 
+// FNV-1a hash of a username, for the server's hash tables.
+static inline uint64_t hash_username(const char *username) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *username; username++) {
+        hash = (hash ^ (unsigned char)*username) * 1099511628211ULL;
+    }
+    return hash;
+}
+
 #endif // COMMON_H
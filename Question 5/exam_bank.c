@@ -0,0 +1,232 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exam_bank.h"
+
+#define MAX_LINE 4096
+
+// A bank being loaded, with the capacities of its growing arrays.
+typedef struct {
+    ExamBank *bank;
+    size_t questions_capacity;
+    size_t users_capacity;
+} BankLoader;
+
+// Strips leading and trailing whitespace in place and returns the start.
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1])) {
+        s[--len] = '\0';
+    }
+    return s;
+}
+
+void normalize_answer(const char *answer, char *out) {
+    size_t len = 0;
+    bool pending_space = false;
+
+    for (; *answer; answer++) {
+        unsigned char c = (unsigned char)*answer;
+        if (isspace(c)) {
+            pending_space = len > 0;
+            continue;
+        }
+        if (len + (pending_space ? 2 : 1) > ANSWER_SIZE - 1) {
+            break;
+        }
+        if (pending_space) {
+            out[len++] = ' ';
+            pending_space = false;
+        }
+        out[len++] = (char)tolower(c);
+    }
+    out[len] = '\0';
+
+    if (len >= 2 && out[0] == '(' && out[len - 1] == ')') {
+        memmove(out, out + 1, len - 2);
+        out[len - 2] = '\0';
+    }
+}
+
+bool answer_is_correct(const char *expected, const char *answer) {
+    char normalized[ANSWER_SIZE];
+    normalize_answer(answer, normalized);
+    return strcmp(normalized, expected) == 0;
+}
+
+bool exam_bank_has_user(const ExamBank *bank, const char *username) {
+    size_t mask = bank->index_capacity - 1;
+    for (size_t i = hash_username(username) & mask; bank->user_index[i] != 0; i = (i + 1) & mask) {
+        if (strcmp(bank->usernames[bank->user_index[i] - 1], username) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ExamBank *exam_bank_ref(ExamBank *bank) {
+    atomic_fetch_add_explicit(&bank->refs, 1, memory_order_relaxed);
+    return bank;
+}
+
+void exam_bank_unref(ExamBank *bank) {
+    if (bank != NULL && atomic_fetch_sub_explicit(&bank->refs, 1, memory_order_acq_rel) == 1) {
+        free(bank->questions);
+        free(bank->usernames);
+        free(bank->user_index);
+        free(bank);
+    }
+}
+
+// Reads the meaningful lines of a file, calling `parse` on each with its line
+// number. Returns false, with `error` set, if the file cannot be read or `parse`
+// rejects a line.
+static bool read_lines(const char *path, bool (*parse)(BankLoader *, char *, char *, size_t), BankLoader *loader,
+                       char *error, size_t error_len) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        snprintf(error, error_len, "%s: %s", path, strerror(errno));
+        return false;
+    }
+
+    char line[MAX_LINE];
+    char reason[128];
+    bool ok = true;
+    for (int line_number = 1; fgets(line, sizeof(line), file) != NULL; line_number++) {
+        char *content = trim(line);
+        if (*content == '\0' || *content == '#') {
+            continue;
+        }
+        if (!parse(loader, content, reason, sizeof(reason))) {
+            snprintf(error, error_len, "%s:%d: %s", path, line_number, reason);
+            ok = false;
+            break;
+        }
+    }
+    if (ok && ferror(file)) {
+        snprintf(error, error_len, "%s: read error", path);
+        ok = false;
+    }
+    fclose(file);
+    return ok;
+}
+
+// Grows an array of `*capacity` elements of `size` bytes so it can hold `count + 1`.
+static bool reserve(void **array, size_t *capacity, size_t count, size_t size) {
+    if (count < *capacity) {
+        return true;
+    }
+    size_t grown = *capacity ? 2 * *capacity : 16;
+    void *p = realloc(*array, grown * size);
+    if (p == NULL) {
+        return false;
+    }
+    *array = p;
+    *capacity = grown;
+    return true;
+}
+
+static bool parse_question(BankLoader *loader, char *line, char *reason, size_t reason_len) {
+    ExamBank *bank = loader->bank;
+    char *separator = strrchr(line, '|');
+    if (separator == NULL) {
+        snprintf(reason, reason_len, "expected \"question | answer\"");
+        return false;
+    }
+    *separator = '\0';
+    char *text = trim(line);
+    char *answer = trim(separator + 1);
+    if (*text == '\0' || *answer == '\0') {
+        snprintf(reason, reason_len, "empty question or answer");
+        return false;
+    }
+    if (strlen(text) >= QUESTION_SIZE || strlen(answer) >= ANSWER_SIZE) {
+        snprintf(reason, reason_len, "question longer than %d or answer longer than %d characters",
+                 QUESTION_SIZE - 1, ANSWER_SIZE - 1);
+        return false;
+    }
+    if (!reserve((void **)&bank->questions, &loader->questions_capacity, bank->num_questions, sizeof(Question))) {
+        snprintf(reason, reason_len, "out of memory");
+        return false;
+    }
+    Question *q = &bank->questions[bank->num_questions++];
+    strcpy(q->text, text);
+    normalize_answer(answer, q->answer);
+    return true;
+}
+
+static bool parse_user(BankLoader *loader, char *line, char *reason, size_t reason_len) {
+    ExamBank *bank = loader->bank;
+    if (strlen(line) >= USERNAME_SIZE) {
+        snprintf(reason, reason_len, "username longer than %d characters", USERNAME_SIZE - 1);
+        return false;
+    }
+    if (!reserve((void **)&bank->usernames, &loader->users_capacity, bank->num_users, USERNAME_SIZE)) {
+        snprintf(reason, reason_len, "out of memory");
+        return false;
+    }
+    strcpy(bank->usernames[bank->num_users++], line);
+    return true;
+}
+
+// Builds the username hash index, dropping duplicate roster entries.
+static bool index_users(ExamBank *bank) {
+    size_t capacity = 16;
+    while (capacity < 2 * bank->num_users) {
+        capacity *= 2;
+    }
+    bank->user_index = calloc(capacity, sizeof(uint32_t));
+    if (bank->user_index == NULL) {
+        return false;
+    }
+    bank->index_capacity = capacity;
+
+    size_t unique = 0;
+    for (size_t u = 0; u < bank->num_users; u++) {
+        if (exam_bank_has_user(bank, bank->usernames[u])) {
+            continue;
+        }
+        memmove(bank->usernames[unique], bank->usernames[u], USERNAME_SIZE);
+        size_t i = hash_username(bank->usernames[unique]) & (capacity - 1);
+        while (bank->user_index[i] != 0) {
+            i = (i + 1) & (capacity - 1);
+        }
+        bank->user_index[i] = (uint32_t)(unique + 1);
+        unique++;
+    }
+    bank->num_users = unique;
+    return true;
+}
+
+ExamBank *exam_bank_load(const char *questions_path, const char *roster_path, char *error, size_t error_len) {
+    ExamBank *bank = calloc(1, sizeof(ExamBank));
+    if (bank == NULL) {
+        snprintf(error, error_len, "out of memory");
+        return NULL;
+    }
+    atomic_init(&bank->refs, 1);
+    BankLoader loader = {bank, 0, 0};
+
+    if (!read_lines(questions_path, parse_question, &loader, error, error_len) ||
+        !read_lines(roster_path, parse_user, &loader, error, error_len)) {
+        exam_bank_unref(bank);
+        return NULL;
+    }
+    if (bank->num_questions == 0 || bank->num_users == 0) {
+        snprintf(error, error_len, "%s", bank->num_questions == 0 ? "no questions" : "no users on the roster");
+        exam_bank_unref(bank);
+        return NULL;
+    }
+    if (!index_users(bank)) {
+        snprintf(error, error_len, "out of memory");
+        exam_bank_unref(bank);
+        return NULL;
+    }
+    return bank;
+}
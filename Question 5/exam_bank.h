@@ -0,0 +1,58 @@
+#ifndef EXAM_BANK_H
+#define EXAM_BANK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Question bank and roster, loaded from text files:
+//
+//   questions file: one question per line, "question text | answer". The last '|'
+//                   separates the answer, so the question may contain '|' itself.
+//   roster file:    one username per line.
+//
+// Blank lines and lines starting with '#' are ignored in both. Everything is
+// loaded into one immutable, reference-counted ExamBank, so a reload builds a new
+// bank and swaps it in while connections still holding the old one finish their
+// exam on it.
+
+typedef struct {
+    char text[QUESTION_SIZE];
+    char answer[ANSWER_SIZE]; // already normalized with normalize_answer()
+} Question;
+
+typedef struct {
+    atomic_int refs;
+    Question *questions; // contiguous, in exam order
+    size_t num_questions;
+    char (*usernames)[USERNAME_SIZE];
+    size_t num_users;
+    // Open-addressing hash index of the usernames: each entry is a user's index
+    // plus one, or 0 if empty. Sized to at most half full.
+    uint32_t *user_index;
+    size_t index_capacity;
+} ExamBank;
+
+// Loads a bank from the two files. Returns NULL and describes the problem in
+// `error` if a file cannot be read or has a malformed line.
+ExamBank *exam_bank_load(const char *questions_path, const char *roster_path, char *error, size_t error_len);
+
+ExamBank *exam_bank_ref(ExamBank *bank);
+void exam_bank_unref(ExamBank *bank);
+
+// Whether `username` is on the roster. O(1) and allocation-free.
+bool exam_bank_has_user(const ExamBank *bank, const char *username);
+
+// Canonical form of an answer, so that " B ", "b" and "(b)" grade the same:
+// surrounding whitespace is trimmed, runs of inner whitespace become one space,
+// letters are lowercased and a single pair of enclosing parentheses is dropped.
+// `out` must hold ANSWER_SIZE bytes; longer answers are truncated.
+void normalize_answer(const char *answer, char *out);
+
+// Grades an answer against a normalized expected answer. Allocation-free.
+bool answer_is_correct(const char *expected, const char *answer);
+
+#endif // EXAM_BANK_H
@@ -0,0 +1,92 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Log-linear histogram in the style of HdrHistogram
+// Values below HISTOGRAM_LINEAR get a bucket each, and every power of two above
+// that is split into HISTOGRAM_SUB_BUCKETS equal buckets, so any value up to 2^64
+// is recorded within 1/64 (about 1.6%) of itself in a fixed 30 KB array.
+// Recording is a shift and an increment, and histograms merge by adding counts.
+//
+// A histogram has a single writer, which updates it with plain relaxed loads and
+// stores (no locked instructions). Other threads may merge or query it at the same
+// time and see every bucket either before or after an update.
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_LINEAR (2 * HISTOGRAM_SUB_BUCKETS)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR + (63 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    _Atomic uint64_t counts[HISTOGRAM_BUCKETS];
+    _Atomic uint64_t total;
+    _Atomic uint64_t max;
+} Histogram;
+
+static inline size_t histogram_index(uint64_t value) {
+    if (value < HISTOGRAM_LINEAR) {
+        return (size_t)value;
+    }
+    int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS; // keeps the top 7 bits
+    uint64_t sub = (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+    return HISTOGRAM_LINEAR + (size_t)(shift - 1) * HISTOGRAM_SUB_BUCKETS + (size_t)sub;
+}
+
+// Middle of the range of values counted in bucket `index`.
+static inline uint64_t histogram_value(size_t index) {
+    if (index < HISTOGRAM_LINEAR) {
+        return index;
+    }
+    size_t shift = (index - HISTOGRAM_LINEAR) / HISTOGRAM_SUB_BUCKETS + 1;
+    uint64_t sub = (index - HISTOGRAM_LINEAR) % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    return (sub << shift) + ((1ULL << shift) >> 1);
+}
+
+// Adds `n` to a single-writer counter without a locked instruction.
+static inline void counter_add(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void histogram_record(Histogram *h, uint64_t value) {
+    counter_add(&h->counts[histogram_index(value)], 1);
+    counter_add(&h->total, 1);
+    if (value > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+    }
+}
+
+// Adds the counts of `from` to `into`, which only the calling thread may be writing.
+static inline void histogram_merge(Histogram *into, Histogram *from) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counter_add(&into->counts[i], atomic_load_explicit(&from->counts[i], memory_order_relaxed));
+    }
+    counter_add(&into->total, atomic_load_explicit(&from->total, memory_order_relaxed));
+    uint64_t max = atomic_load_explicit(&from->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&into->max, memory_order_relaxed)) {
+        atomic_store_explicit(&into->max, max, memory_order_relaxed);
+    }
+}
+
+// Smallest recorded value (to within a bucket) that at least a fraction `q` of
+// the recorded values do not exceed, or 0 if nothing was recorded.
+static inline uint64_t histogram_percentile(Histogram *h, double q) {
+    uint64_t total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    uint64_t rank = (uint64_t)(q * total + 0.5);
+    uint64_t seen = 0;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t value = histogram_value(i);
+            return value < max ? value : max;
+        }
+    }
+    return total > 0 ? max : 0;
+}
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,523 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "common.h"
+#include "histogram.h"
+#include "protocol.h"
+
+// Load generator for the exam server: a few threads, each driving its share of
+// the simulated students from one epoll loop, the way the server's reactors
+// serve them. Every student connects, authenticates, and answers each question
+// it is sent after a think time set by the answer rate, until the exam ends.
+// Auth and answer round trips are recorded in nanoseconds into per-thread
+// histograms (see histogram.h) that are merged once the run is over.
+
+#define DEFAULT_STUDENTS 4
+#define DEFAULT_THREADS 4
+#define DEFAULT_PREFIX "student"
+#define DEFAULT_RATE 1.0
+#define MAX_EVENTS 256
+
+// Simulated students
+
+typedef enum {
+    STUDENT_WAITING,        // not connected yet
+    STUDENT_CONNECTING,
+    STUDENT_AUTHENTICATING,
+    STUDENT_THINKING,       // got a question; answers when due
+    STUDENT_ANSWERING,      // answer sent, waiting for its feedback
+    STUDENT_DONE
+} StudentState;
+
+typedef struct {
+    int socket;
+    StudentState state;
+    char username[USERNAME_SIZE];
+    uint64_t due_ns;  // when a waiting student connects or a thinking one answers
+    uint64_t sent_ns; // when the request being timed was sent
+    FrameReader reader;
+    uint8_t out[MAX_FRAME_SIZE]; // the unsent end of the last request
+    size_t out_len;
+} Student;
+
+// Counters of one thread; summed over every thread for the report.
+typedef struct {
+    uint64_t connect_errors;
+    uint64_t auth_failures;
+    uint64_t rejected; // "Server is full"
+    uint64_t disconnects;
+    uint64_t finished;
+    uint64_t broadcasts;
+} Counters;
+
+typedef struct {
+    pthread_t thread_id;
+    int epoll_fd;
+    Student *students; // in the order they connect
+    size_t num_students;
+    size_t next_connect; // first student still waiting to connect
+    size_t remaining;    // students not done yet
+    unsigned int seed;
+
+    // Thinking students in order of due time. Every one is scheduled the same
+    // fixed delay after a question that arrived now, so appending keeps the
+    // queue sorted and a ring does the job of a heap.
+    Student **due;
+    size_t due_head;
+    size_t due_count;
+
+    Histogram auth_latency;
+    Histogram answer_latency;
+    Counters counters;
+} Driver;
+
+// Settings
+struct sockaddr_in server_addr;
+int num_students = DEFAULT_STUDENTS;
+int num_threads = DEFAULT_THREADS;
+const char *username_prefix = DEFAULT_PREFIX;
+int first_index = 1;
+uint64_t think_ns;   // delay before answering each question
+uint64_t ramp_ns;    // connections are spread evenly over this long
+uint64_t deadline_ns; // give up at this time (0: run until every exam ends)
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void schedule(Driver *d, Student *s, uint64_t due_ns) {
+    s->due_ns = due_ns;
+    d->due[(d->due_head + d->due_count) % d->num_students] = s;
+    d->due_count++;
+}
+
+static void finish(Driver *d, Student *s) {
+    if (s->socket >= 0) {
+        close(s->socket); // also removes it from the epoll set
+        s->socket = -1;
+    }
+    if (s->state != STUDENT_DONE) {
+        s->state = STUDENT_DONE;
+        d->remaining--;
+    }
+}
+
+// Sends as much of the pending request as the socket takes. Returns false if the
+// connection failed.
+static bool flush_request(Student *s) {
+    while (s->out_len > 0) {
+        ssize_t n = send(s->socket, s->out, s->out_len, MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        memmove(s->out, s->out + n, s->out_len - n);
+        s->out_len -= n;
+    }
+    return true;
+}
+
+static bool send_request(Student *s, MessageType type, const char *payload) {
+    s->out_len = encode_frame(s->out, type, payload, strlen(payload));
+    s->sent_ns = now_ns();
+    return flush_request(s);
+}
+
+static void start_connect(Driver *d, Student *s) {
+    s->socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (s->socket < 0) {
+        d->counters.connect_errors++;
+        finish(d, s);
+        return;
+    }
+    int one = 1;
+    setsockopt(s->socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = s};
+    if (epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, s->socket, &ev) < 0 ||
+        (connect(s->socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS)) {
+        d->counters.connect_errors++;
+        finish(d, s);
+        return;
+    }
+    s->state = STUDENT_CONNECTING;
+}
+
+// Students pick answers at random: the server's grading work is the same
+// whether they are right or not.
+static void answer_question(Driver *d, Student *s) {
+    char answer[2] = {(char)('a' + rand_r(&d->seed) % 3), '\0'};
+    s->state = STUDENT_ANSWERING;
+    if (!send_request(s, ANSWER_SUBMISSION, answer)) {
+        d->counters.disconnects++;
+        finish(d, s);
+    }
+}
+
+// Connects and answers for every student that is due, and returns when the
+// next one will be (UINT64_MAX if none is waiting).
+static uint64_t run_due(Driver *d, uint64_t now) {
+    while (d->next_connect < d->num_students && d->students[d->next_connect].due_ns <= now) {
+        start_connect(d, &d->students[d->next_connect++]);
+    }
+    while (d->due_count > 0 && d->due[d->due_head]->due_ns <= now) {
+        Student *s = d->due[d->due_head];
+        d->due_head = (d->due_head + 1) % d->num_students;
+        d->due_count--;
+        if (s->state == STUDENT_THINKING) { // not disconnected meanwhile
+            answer_question(d, s);
+        }
+    }
+
+    uint64_t next = UINT64_MAX;
+    if (d->next_connect < d->num_students) {
+        next = d->students[d->next_connect].due_ns;
+    }
+    if (d->due_count > 0 && d->due[d->due_head]->due_ns < next) {
+        next = d->due[d->due_head]->due_ns;
+    }
+    return next;
+}
+
+static void handle_message(Driver *d, Student *s, const Message *msg, uint64_t now) {
+    switch (msg->type) {
+    case AUTH_SUCCESS:
+        histogram_record(&d->auth_latency, now - s->sent_ns);
+        s->state = STUDENT_THINKING; // until the first question arrives
+        break;
+    case AUTH_FAILURE:
+        histogram_record(&d->auth_latency, now - s->sent_ns);
+        d->counters.auth_failures++;
+        finish(d, s);
+        break;
+    case FEEDBACK_CORRECT:
+    case FEEDBACK_INCORRECT:
+        histogram_record(&d->answer_latency, now - s->sent_ns);
+        s->state = STUDENT_THINKING;
+        break;
+    case QUESTION_DELIVERY:
+        schedule(d, s, now + think_ns);
+        break;
+    case ACTIVE_STUDENTS_UPDATE:
+    case ACTIVE_STUDENTS_DELTA:
+        d->counters.broadcasts++;
+        break;
+    case EXAM_ENDED:
+        if (s->state == STUDENT_AUTHENTICATING) {
+            d->counters.rejected++;
+        } else {
+            d->counters.finished++;
+        }
+        finish(d, s);
+        break;
+    default:
+        break;
+    }
+}
+
+static void handle_event(Driver *d, Student *s, uint32_t events) {
+    if (s->state == STUDENT_CONNECTING) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(s->socket, SOL_SOCKET, SO_ERROR, &error, &len);
+        if (error != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+            d->counters.connect_errors++;
+            finish(d, s);
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        s->state = STUDENT_AUTHENTICATING;
+        if (!send_request(s, AUTH_REQUEST, s->username)) {
+            d->counters.connect_errors++;
+            finish(d, s);
+        }
+        return;
+    }
+
+    if ((events & EPOLLOUT) && !flush_request(s)) {
+        d->counters.disconnects++;
+        finish(d, s);
+        return;
+    }
+
+    // Edge-triggered: read until the socket is drained
+    while (s->state != STUDENT_DONE) {
+        ssize_t received = frame_reader_recv(&s->reader, s->socket);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            d->counters.disconnects++;
+            finish(d, s);
+            return;
+        }
+
+        uint64_t now = now_ns();
+        Message msg;
+        int status = 0;
+        while (s->state != STUDENT_DONE && (status = frame_reader_next(&s->reader, &msg)) > 0) {
+            handle_message(d, s, &msg, now);
+        }
+        if (s->state != STUDENT_DONE && status < 0) {
+            d->counters.disconnects++;
+            finish(d, s);
+        }
+    }
+}
+
+static void *run_driver(void *arg) {
+    Driver *d = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (d->remaining > 0) {
+        uint64_t now = now_ns();
+        if (deadline_ns != 0 && now >= deadline_ns) {
+            break;
+        }
+        uint64_t next = run_due(d, now);
+
+        int timeout_ms = 100;
+        if (next - now < 100000000ULL) {
+            timeout_ms = (int)((next - now + 999999) / 1000000);
+        }
+        int n = epoll_wait(d->epoll_fd, events, MAX_EVENTS, timeout_ms);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            handle_event(d, events[i].data.ptr, events[i].events);
+        }
+    }
+
+    for (size_t i = 0; i < d->num_students; i++) {
+        if (d->students[i].socket >= 0) {
+            close(d->students[i].socket);
+            d->students[i].socket = -1;
+        }
+    }
+    return NULL;
+}
+
+// Students are dealt to the threads round-robin, and the ramp-up spreads their
+// connection times evenly in order, so each thread connects its students in turn.
+static int init_drivers(Driver *drivers, uint64_t start) {
+    for (int t = 0; t < num_threads; t++) {
+        Driver *d = &drivers[t];
+        d->num_students = (size_t)(num_students / num_threads + (t < num_students % num_threads));
+        d->remaining = d->num_students;
+        d->students = calloc(d->num_students ? d->num_students : 1, sizeof(Student));
+        d->due = calloc(d->num_students ? d->num_students : 1, sizeof(Student *));
+        d->seed = (unsigned int)t;
+        d->epoll_fd = epoll_create1(0);
+        if (d->students == NULL || d->due == NULL || d->epoll_fd < 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < num_students; i++) {
+        Driver *d = &drivers[i % num_threads];
+        Student *s = &d->students[i / num_threads];
+        s->socket = -1;
+        s->state = STUDENT_WAITING;
+        snprintf(s->username, USERNAME_SIZE, "%s%d", username_prefix, first_index + i);
+        s->due_ns = start + ramp_ns * (uint64_t)i / (uint64_t)num_students;
+    }
+    return 0;
+}
+
+static void print_latency(const char *name, Histogram *h, double seconds) {
+    uint64_t total = atomic_load(&h->total);
+    if (total == 0) {
+        printf("%-8s %10d\n", name, 0);
+        return;
+    }
+    printf("%-8s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, (unsigned long long)total, total / seconds,
+           histogram_percentile(h, 0.50) / 1e3, histogram_percentile(h, 0.99) / 1e3,
+           histogram_percentile(h, 0.999) / 1e3, atomic_load(&h->max) / 1e3);
+}
+
+static void raise_file_limit(void) {
+    rlim_t needed = (rlim_t)num_students + num_threads + 64;
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur >= needed) {
+        return;
+    }
+    limit.rlim_cur = needed < limit.rlim_max ? needed : limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur < needed) {
+        fprintf(stderr, "Warning: open file limit is %llu, so fewer than %d students may be able to connect\n",
+                (unsigned long long)limit.rlim_cur, num_students);
+    }
+}
+
+static int parse_count(const char *arg, int min, int max, int *out) {
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || *end != '\0' || value < min || value > max) {
+        return -1;
+    }
+    *out = (int)value;
+    return 0;
+}
+
+static int parse_seconds(const char *arg, uint64_t *out) {
+    char *end;
+    errno = 0;
+    double value = strtod(arg, &end);
+    if (errno != 0 || *end != '\0' || !(value >= 0) || value > 1e6) {
+        return -1;
+    }
+    *out = (uint64_t)(value * 1e9);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-a address] [-p port] [-n students] [-t threads] [-u prefix] [-f first]\n"
+            "          [-r answers_per_second] [-R ramp_seconds] [-d max_seconds]\n"
+            "  -a  server address (default 127.0.0.1)\n"
+            "  -p  server port (default %d)\n"
+            "  -n  number of simulated students (default %d)\n"
+            "  -t  number of threads driving them (default %d)\n"
+            "  -u  usernames are this prefix followed by a number (default %s)\n"
+            "  -f  number of the first username (default 1)\n"
+            "  -r  answers per second per student, 0 for no think time (default %g)\n"
+            "  -R  spread the connections over this many seconds (default 0)\n"
+            "  -d  stop after this many seconds even if exams are still running\n"
+            "Each student answers every question it is sent until the exam ends, so the\n"
+            "server's roster must list the usernames and its answer log must not already\n"
+            "hold their answers.\n",
+            prog, PORT, DEFAULT_STUDENTS, DEFAULT_THREADS, DEFAULT_PREFIX, DEFAULT_RATE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *address = "127.0.0.1";
+    int port = PORT;
+    double rate = DEFAULT_RATE;
+    uint64_t duration_ns = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:n:t:u:f:r:R:d:h")) != -1) {
+        int ok = 0;
+        char *end;
+        switch (opt) {
+        case 'a':
+            address = optarg;
+            break;
+        case 'p':
+            ok = parse_count(optarg, 1, 65535, &port);
+            break;
+        case 'n':
+            ok = parse_count(optarg, 1, 10000000, &num_students);
+            break;
+        case 't':
+            ok = parse_count(optarg, 1, 1024, &num_threads);
+            break;
+        case 'u':
+            username_prefix = optarg;
+            ok = strlen(optarg) < USERNAME_SIZE - 12 ? 0 : -1;
+            break;
+        case 'f':
+            ok = parse_count(optarg, 0, 1000000000, &first_index);
+            break;
+        case 'r':
+            errno = 0;
+            rate = strtod(optarg, &end);
+            ok = errno == 0 && *end == '\0' && rate >= 0 ? 0 : -1;
+            break;
+        case 'R':
+            ok = parse_seconds(optarg, &ramp_ns);
+            break;
+        case 'd':
+            ok = parse_seconds(optarg, &duration_ns);
+            break;
+        default:
+            ok = -1;
+            break;
+        }
+        if (ok < 0) {
+            usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (num_threads > num_students) {
+        num_threads = num_students;
+    }
+    think_ns = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &server_addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    raise_file_limit();
+
+    Driver *drivers = calloc(num_threads, sizeof(Driver));
+    uint64_t start = now_ns();
+    if (drivers == NULL || init_drivers(drivers, start) < 0) {
+        perror("setup failed");
+        exit(EXIT_FAILURE);
+    }
+    deadline_ns = duration_ns ? start + duration_ns : 0;
+
+    printf("Running %d students on %d threads against %s:%d (%g answers/s each)\n", num_students, num_threads,
+           address, port, rate);
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&drivers[i].thread_id, NULL, run_driver, &drivers[i]) != 0) {
+            perror("pthread_create failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    static Histogram auth_latency, answer_latency;
+    Counters total = {0};
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(drivers[i].thread_id, NULL);
+        histogram_merge(&auth_latency, &drivers[i].auth_latency);
+        histogram_merge(&answer_latency, &drivers[i].answer_latency);
+        total.connect_errors += drivers[i].counters.connect_errors;
+        total.auth_failures += drivers[i].counters.auth_failures;
+        total.rejected += drivers[i].counters.rejected;
+        total.disconnects += drivers[i].counters.disconnects;
+        total.finished += drivers[i].counters.finished;
+        total.broadcasts += drivers[i].counters.broadcasts;
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    printf("Finished %llu of %d exams in %.2f s: %llu connect errors, %llu auth failures, "
+           "%llu rejected (server full), %llu disconnects, %llu roster broadcasts received\n",
+           (unsigned long long)total.finished, num_students, seconds, (unsigned long long)total.connect_errors,
+           (unsigned long long)total.auth_failures, (unsigned long long)total.rejected,
+           (unsigned long long)total.disconnects, (unsigned long long)total.broadcasts);
+    printf("%-8s %10s %10s %10s %10s %10s %10s  (latencies in microseconds)\n", "", "count", "per sec", "p50",
+           "p99", "p999", "max");
+    print_latency("auth", &auth_latency, seconds);
+    print_latency("answer", &answer_latency, seconds);
+    return total.finished == (uint64_t)num_students ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+// Ring slots; a power of two. At 256 bytes a line that is 1 MB of backlog.
+#define RING_SIZE 4096
+#define LINE_SIZE 256
+#define WRITE_BUFFER_SIZE (64 * 1024)
+// Room for the "YYYY-MM-DD HH:MM:SS.mmm LEVEL " prefix and the newline
+#define MAX_OUTPUT_LINE (LINE_SIZE + 40)
+
+// A slot of the bounded multi-producer ring (Vyukov). `sequence` says whose turn
+// it is: equal to the position a producer is about to claim when the slot is
+// free, that position + 1 once the line in it is complete.
+typedef struct {
+    atomic_size_t sequence;
+    LogLevel level;
+    struct timespec time;
+    char text[LINE_SIZE];
+} LogSlot;
+
+LogLevel log_level = LOG_LEVEL_INFO;
+
+static const char *const level_names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+static struct {
+    LogSlot slots[RING_SIZE];
+    atomic_size_t enqueue_pos;
+    size_t dequeue_pos; // only the writer thread moves this
+    atomic_ullong dropped;
+    unsigned long long dropped_reported;
+
+    int fd;
+    atomic_bool running;
+    atomic_bool stopping;
+    // Set by the writer before it sleeps; the producer that clears it wakes it up
+    atomic_bool writer_idle;
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_cond;
+    pthread_t writer;
+
+    char buffer[WRITE_BUFFER_SIZE];
+    size_t buffered;
+    time_t prefix_second; // the second the cached date and time below are for
+    char prefix_time[24];
+} logger = {.fd = STDOUT_FILENO,
+            .wake_mutex = PTHREAD_MUTEX_INITIALIZER,
+            .wake_cond = PTHREAD_COND_INITIALIZER};
+
+static void write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // nowhere left to report it
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static size_t format_line(char *out, LogLevel level, const struct timespec *time, const char *text) {
+    if (time->tv_sec != logger.prefix_second || logger.prefix_time[0] == '\0') {
+        struct tm tm;
+        localtime_r(&time->tv_sec, &tm);
+        strftime(logger.prefix_time, sizeof(logger.prefix_time), "%Y-%m-%d %H:%M:%S", &tm);
+        logger.prefix_second = time->tv_sec;
+    }
+    return (size_t)snprintf(out, MAX_OUTPUT_LINE, "%s.%03ld %-5s %s\n", logger.prefix_time,
+                            time->tv_nsec / 1000000, level_names[level], text);
+}
+
+static void flush_buffer(void) {
+    write_all(logger.fd, logger.buffer, logger.buffered);
+    logger.buffered = 0;
+}
+
+// Formats every complete line in the ring into the write buffer. Returns how many
+// were taken.
+static size_t drain_ring(void) {
+    size_t taken = 0;
+
+    while (true) {
+        LogSlot *slot = &logger.slots[logger.dequeue_pos & (RING_SIZE - 1)];
+        if (atomic_load(&slot->sequence) != logger.dequeue_pos + 1) {
+            break; // empty, or the next line is still being written
+        }
+        if (logger.buffered + MAX_OUTPUT_LINE > WRITE_BUFFER_SIZE) {
+            flush_buffer();
+        }
+        logger.buffered += format_line(logger.buffer + logger.buffered, slot->level, &slot->time, slot->text);
+        atomic_store_explicit(&slot->sequence, logger.dequeue_pos + RING_SIZE, memory_order_release);
+        logger.dequeue_pos++;
+        taken++;
+    }
+
+    unsigned long long dropped = atomic_load_explicit(&logger.dropped, memory_order_relaxed);
+    if (dropped != logger.dropped_reported) {
+        struct timespec now;
+        char text[LINE_SIZE];
+        clock_gettime(CLOCK_REALTIME, &now);
+        snprintf(text, sizeof(text), "Log ring full: %llu lines dropped", dropped - logger.dropped_reported);
+        if (logger.buffered + MAX_OUTPUT_LINE > WRITE_BUFFER_SIZE) {
+            flush_buffer();
+        }
+        logger.buffered += format_line(logger.buffer + logger.buffered, LOG_LEVEL_WARN, &now, text);
+        logger.dropped_reported = dropped;
+    }
+    return taken;
+}
+
+static bool ring_empty(void) {
+    LogSlot *slot = &logger.slots[logger.dequeue_pos & (RING_SIZE - 1)];
+    return atomic_load(&slot->sequence) != logger.dequeue_pos + 1;
+}
+
+// Sleeps until a line is logged or the logger is stopped.
+static void wait_for_lines(void) {
+    atomic_store(&logger.writer_idle, true);
+    if (!ring_empty() || atomic_load(&logger.stopping)) {
+        atomic_store(&logger.writer_idle, false);
+        return;
+    }
+
+    pthread_mutex_lock(&logger.wake_mutex);
+    while (atomic_load(&logger.writer_idle) && !atomic_load(&logger.stopping)) {
+        pthread_cond_wait(&logger.wake_cond, &logger.wake_mutex);
+    }
+    pthread_mutex_unlock(&logger.wake_mutex);
+    atomic_store(&logger.writer_idle, false);
+}
+
+// Writer thread
+static void *run_writer(void *arg) {
+    (void)arg;
+    while (true) {
+        bool stopping = atomic_load(&logger.stopping);
+        drain_ring();
+        flush_buffer();
+        if (stopping) {
+            return NULL; // everything logged before the stop request is out
+        }
+        wait_for_lines();
+    }
+}
+
+int logger_start(int fd) {
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        atomic_init(&logger.slots[i].sequence, i);
+    }
+    atomic_init(&logger.enqueue_pos, 0);
+    logger.dequeue_pos = 0;
+    logger.fd = fd;
+    atomic_store(&logger.stopping, false);
+    if (pthread_create(&logger.writer, NULL, run_writer, NULL) != 0) {
+        return -1;
+    }
+    atomic_store(&logger.running, true);
+    return 0;
+}
+
+void logger_stop(void) {
+    if (!atomic_exchange(&logger.running, false)) {
+        return;
+    }
+    atomic_store(&logger.stopping, true);
+    pthread_mutex_lock(&logger.wake_mutex);
+    pthread_cond_signal(&logger.wake_cond);
+    pthread_mutex_unlock(&logger.wake_mutex);
+    pthread_join(logger.writer, NULL);
+}
+
+void log_message(LogLevel level, const char *format, ...) {
+    struct timespec now;
+    va_list args;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if (!atomic_load_explicit(&logger.running, memory_order_relaxed)) {
+        char text[LINE_SIZE];
+        char line[MAX_OUTPUT_LINE];
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        struct tm tm;
+        char stamp[24];
+        localtime_r(&now.tv_sec, &tm);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+        int len = snprintf(line, sizeof(line), "%s.%03ld %-5s %s\n", stamp, now.tv_nsec / 1000000,
+                           level_names[level], text);
+        write_all(logger.fd, line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+        return;
+    }
+
+    // Claim the next free slot; a slot still holding an unwritten line means the
+    // ring is full
+    LogSlot *slot;
+    size_t pos = atomic_load_explicit(&logger.enqueue_pos, memory_order_relaxed);
+    while (true) {
+        slot = &logger.slots[pos & (RING_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)pos;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&logger.enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&logger.enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->time = now;
+    va_start(args, format);
+    vsnprintf(slot->text, LINE_SIZE, format, args);
+    va_end(args);
+    // Sequentially consistent, like the writer's store to writer_idle before it
+    // checks the ring, so either it sees this line or this sees it idle
+    atomic_store(&slot->sequence, pos + 1);
+
+    if (atomic_load(&logger.writer_idle) && atomic_exchange(&logger.writer_idle, false)) {
+        pthread_mutex_lock(&logger.wake_mutex);
+        pthread_cond_signal(&logger.wake_cond);
+        pthread_mutex_unlock(&logger.wake_mutex);
+    }
+}
+
+bool log_level_parse(const char *name, LogLevel *level) {
+    static const char *const names[] = {"debug", "info", "warn", "error"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            *level = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned long long logger_dropped(void) {
+    return atomic_load_explicit(&logger.dropped, memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+
+// Asynchronous leveled logger
+// Threads on the request path never write to the log file themselves: a log call
+// formats its line into a slot of a fixed ring buffer and returns. A writer thread
+// drains the ring, prefixes each line with its time and level, and writes them out
+// in large batches. Claiming a slot is one compare-and-swap, so loggers never wait
+// for each other or for the disk. When the ring is full the line is dropped, not
+// waited for, and the writer reports how many were lost.
+//
+// Before logger_start() and after logger_stop() lines are written synchronously.
+
+typedef enum {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR
+} LogLevel;
+
+// Lines below this level are discarded before they are formatted.
+extern LogLevel log_level;
+
+#define log_at(level, ...)                   \
+    do {                                     \
+        if ((level) >= log_level) {          \
+            log_message(level, __VA_ARGS__); \
+        }                                    \
+    } while (0)
+
+#define log_debug(...) log_at(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define log_info(...) log_at(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_error(...) log_at(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Starts the writer thread, which writes to `fd`. Returns -1 if it cannot be started.
+int logger_start(int fd);
+
+// Writes out every line logged so far and stops the writer thread.
+void logger_stop(void);
+
+// Logs one line (without its trailing newline). Use the log_* macros instead,
+// which skip the formatting when the level is disabled.
+void log_message(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Parses "debug", "info", "warn" or "error". Returns false for anything else.
+bool log_level_parse(const char *name, LogLevel *level);
+
+// Number of lines dropped so far because the ring was full.
+unsigned long long logger_dropped(void);
+
+#endif // LOGGER_H
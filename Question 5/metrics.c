@@ -0,0 +1,163 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+static const char *const counter_names[NUM_COUNTERS] = {
+    "connections_accepted",
+    "connections_rejected",
+    "connections_closed",
+    "slow_clients_dropped",
+    "auth_succeeded",
+    "auth_failed",
+    "answers_submitted",
+    "answers_graded",
+    "answers_correct",
+    "frames_received",
+    "bytes_received",
+    "bytes_sent",
+    "messages_queued",
+    "send_calls",
+    "sends_deferred",
+};
+
+// Latencies are recorded in nanoseconds and reported in microseconds.
+static const struct {
+    const char *name;
+    double scale;
+} histogram_info[NUM_HISTOGRAMS] = {
+    {"auth_latency_us", 1e-3},
+    {"grading_latency_us", 1e-3},
+    {"grading_queue_depth", 1},
+    {"output_queue_depth", 1},
+};
+
+static _Atomic(ThreadMetrics *) all_metrics;
+static int stats_fd;
+static void (*gauges)(FILE *out);
+static struct timespec started;
+
+ThreadMetrics *metrics_register(void) {
+    ThreadMetrics *m = aligned_alloc(alignof(ThreadMetrics), sizeof(ThreadMetrics));
+    if (m == NULL) {
+        return NULL;
+    }
+    memset(m, 0, sizeof(ThreadMetrics));
+    m->next = atomic_load(&all_metrics);
+    while (!atomic_compare_exchange_weak(&all_metrics, &m->next, m)) {
+    }
+    return m;
+}
+
+uint64_t metrics_total(Counter counter) {
+    uint64_t total = 0;
+    for (ThreadMetrics *m = atomic_load(&all_metrics); m != NULL; m = m->next) {
+        total += atomic_load_explicit(&m->counters[counter], memory_order_relaxed);
+    }
+    return total;
+}
+
+static void write_report(FILE *out) {
+    static Histogram merged; // only the stats thread uses it
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(out, "uptime_seconds %.3f\n",
+            (double)(now.tv_sec - started.tv_sec) + (now.tv_nsec - started.tv_nsec) / 1e9);
+
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        fprintf(out, "%s %llu\n", counter_names[c], (unsigned long long)metrics_total((Counter)c));
+    }
+    if (gauges != NULL) {
+        gauges(out);
+    }
+
+    for (int h = 0; h < NUM_HISTOGRAMS; h++) {
+        memset(&merged, 0, sizeof(merged));
+        for (ThreadMetrics *m = atomic_load(&all_metrics); m != NULL; m = m->next) {
+            histogram_merge(&merged, &m->histograms[h]);
+        }
+        const char *name = histogram_info[h].name;
+        double scale = histogram_info[h].scale;
+        fprintf(out, "%s_count %llu\n", name, (unsigned long long)atomic_load(&merged.total));
+        fprintf(out, "%s_p50 %.1f\n", name, histogram_percentile(&merged, 0.50) * scale);
+        fprintf(out, "%s_p99 %.1f\n", name, histogram_percentile(&merged, 0.99) * scale);
+        fprintf(out, "%s_p999 %.1f\n", name, histogram_percentile(&merged, 0.999) * scale);
+        fprintf(out, "%s_max %.1f\n", name, atomic_load(&merged.max) * scale);
+    }
+}
+
+// Stats thread
+// Answers each connection with one report. Reports are built off the request path;
+// reading the other threads' blocks never makes them wait.
+static void *serve_stats(void *arg) {
+    (void)arg;
+    while (true) {
+        int client = accept4(stats_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return NULL;
+        }
+
+        char *report = NULL;
+        size_t len = 0;
+        FILE *out = open_memstream(&report, &len);
+        if (out != NULL) {
+            write_report(out);
+            fclose(out);
+            for (size_t sent = 0; sent < len;) {
+                ssize_t n = send(client, report + sent, len - sent, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    break;
+                }
+                sent += n;
+            }
+            free(report);
+        }
+        close(client);
+    }
+}
+
+int metrics_serve(const char *path, void (*add_gauges)(FILE *out)) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    stats_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (stats_fd < 0) {
+        return -1;
+    }
+    unlink(path); // left behind by a previous run
+    if (bind(stats_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(stats_fd, 16) < 0) {
+        close(stats_fd);
+        return -1;
+    }
+
+    gauges = add_gauges;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, NULL, serve_stats, NULL) != 0) {
+        close(stats_fd);
+        errno = EAGAIN;
+        return -1;
+    }
+    pthread_detach(thread_id);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "histogram.h"
+
+// Server metrics
+// Every thread that records metrics registers a ThreadMetrics block of its own and
+// is its only writer, so counting an event is a relaxed load and store on a cache
+// line no other thread writes: no locks and no locked instructions on the request
+// path. The stats endpoint sums the blocks of every thread when it is asked for a
+// report.
+
+typedef enum {
+    METRIC_CONNECTIONS_ACCEPTED,
+    METRIC_CONNECTIONS_REJECTED, // the server was full
+    METRIC_CONNECTIONS_CLOSED,
+    METRIC_SLOW_CLIENTS_DROPPED, // left too many messages unread
+    METRIC_AUTH_SUCCEEDED,
+    METRIC_AUTH_FAILED,
+    METRIC_ANSWERS_SUBMITTED,
+    METRIC_ANSWERS_GRADED,
+    METRIC_ANSWERS_CORRECT,
+    METRIC_FRAMES_RECEIVED,
+    METRIC_BYTES_RECEIVED,
+    METRIC_BYTES_SENT,
+    METRIC_MESSAGES_QUEUED, // messages and broadcasts queued for a client
+    METRIC_SEND_CALLS,      // sendmsg() calls made to deliver them
+    METRIC_SENDS_DEFERRED,  // output the socket did not take at once, left for EPOLLOUT
+    NUM_COUNTERS
+} Counter;
+
+typedef enum {
+    HISTOGRAM_AUTH_NS,             // time to handle an AUTH_REQUEST
+    HISTOGRAM_GRADING_NS,          // from receiving an answer to queueing its feedback
+    HISTOGRAM_GRADING_QUEUE_DEPTH, // answers waiting ahead of each one submitted
+    HISTOGRAM_OUTPUT_QUEUE_DEPTH,  // chunks of output queued on a connection, sampled as each is queued
+    NUM_HISTOGRAMS
+} HistogramId;
+
+typedef struct ThreadMetrics {
+    alignas(64) _Atomic uint64_t counters[NUM_COUNTERS];
+    Histogram histograms[NUM_HISTOGRAMS];
+    struct ThreadMetrics *next; // every registered block
+} ThreadMetrics;
+
+// Allocates a zeroed block for the calling thread to record into. Blocks are never
+// freed. Returns NULL if out of memory.
+ThreadMetrics *metrics_register(void);
+
+static inline void metrics_add(ThreadMetrics *m, Counter counter, uint64_t n) {
+    counter_add(&m->counters[counter], n);
+}
+
+static inline void metrics_record(ThreadMetrics *m, HistogramId histogram, uint64_t value) {
+    histogram_record(&m->histograms[histogram], value);
+}
+
+static inline uint64_t metrics_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Sum of a counter over every thread.
+uint64_t metrics_total(Counter counter);
+
+// Starts a thread serving reports on a Unix stream socket at `path`: each client
+// that connects is sent the current report as text, one "name value" per line,
+// and the connection is closed, so `nc -U path` prints it. `add_gauges` is called
+// to append values the metrics don't track themselves, like queue lengths.
+// Returns -1 with errno set if the socket cannot be created.
+int metrics_serve(const char *path, void (*add_gauges)(FILE *out));
+
+#endif // METRICS_H
@@ -0,0 +1,143 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "protocol.h"
+
+// A 32-bit value never needs more than 5 varint bytes.
+#define MAX_VARINT_SIZE 5
+
+static size_t put_varint(uint8_t *out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Reads a varint from the first `len` bytes of `data`. Returns the number of bytes
+// it occupies, 0 if it is cut short, or -1 if it is longer than MAX_VARINT_SIZE.
+static int get_varint(const uint8_t *data, size_t len, uint32_t *value) {
+    uint32_t result = 0;
+    for (size_t i = 0; i < MAX_VARINT_SIZE; i++) {
+        if (i == len) {
+            return 0;
+        }
+        result |= (uint32_t)(data[i] & 0x7f) << (7 * i);
+        if (!(data[i] & 0x80)) {
+            *value = result;
+            return (int)i + 1;
+        }
+    }
+    return -1;
+}
+
+size_t encode_frame(uint8_t *out, MessageType type, const char *payload, size_t payload_len) {
+    uint8_t type_bytes[MAX_VARINT_SIZE];
+
+    if (payload_len > BUFFER_SIZE - 1) {
+        return 0;
+    }
+    size_t type_len = put_varint(type_bytes, (uint32_t)type);
+    size_t n = put_varint(out, (uint32_t)(1 + type_len + payload_len));
+    out[n++] = PROTOCOL_VERSION;
+    memcpy(out + n, type_bytes, type_len);
+    n += type_len;
+    memcpy(out + n, payload, payload_len);
+    return n + payload_len;
+}
+
+size_t encode_message(uint8_t *out, const Message *msg) {
+    return encode_frame(out, msg->type, msg->payload, strnlen(msg->payload, BUFFER_SIZE - 1));
+}
+
+ssize_t frame_reader_recv(FrameReader *reader, int socket) {
+    if (reader->start > 0) {
+        memmove(reader->data, reader->data + reader->start, reader->len - reader->start);
+        reader->len -= reader->start;
+        reader->start = 0;
+    }
+    ssize_t received = recv(socket, reader->data + reader->len, MAX_FRAME_SIZE - reader->len, 0);
+    if (received > 0) {
+        reader->len += received;
+    }
+    return received;
+}
+
+int frame_reader_next(FrameReader *reader, Message *msg) {
+    const uint8_t *frame = reader->data + reader->start;
+    size_t available = reader->len - reader->start;
+    uint32_t body_len, type;
+
+    int prefix_len = get_varint(frame, available, &body_len);
+    if (prefix_len <= 0) {
+        return prefix_len;
+    }
+    // The body holds at least the version and type, and the frame must fit the reader
+    if (body_len < 2 || body_len > MAX_FRAME_SIZE - (size_t)prefix_len) {
+        return -1;
+    }
+    if (available < prefix_len + body_len) {
+        return 0;
+    }
+
+    const uint8_t *body = frame + prefix_len;
+    if (body[0] != PROTOCOL_VERSION) {
+        return -1;
+    }
+    int type_len = get_varint(body + 1, body_len - 1, &type);
+    if (type_len <= 0) {
+        return -1;
+    }
+    size_t payload_len = body_len - 1 - type_len;
+    if (payload_len > BUFFER_SIZE - 1) {
+        return -1;
+    }
+
+    msg->type = (MessageType)type;
+    memcpy(msg->payload, body + 1 + type_len, payload_len);
+    msg->payload[payload_len] = '\0';
+
+    reader->start += prefix_len + body_len;
+    if (reader->start == reader->len) {
+        reader->start = reader->len = 0;
+    }
+    return 1;
+}
+
+int send_message(int socket, MessageType type, const char *payload) {
+    uint8_t frame[MAX_FRAME_SIZE];
+    size_t len = encode_frame(frame, type, payload, strlen(payload));
+    if (len == 0) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    // A blocking send may still be interrupted after writing part of the frame
+    for (size_t sent = 0; sent < len;) {
+        ssize_t n = send(socket, frame + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+int recv_message(int socket, FrameReader *reader, Message *msg) {
+    while (true) {
+        int status = frame_reader_next(reader, msg);
+        if (status != 0) {
+            return status > 0 ? 0 : -1;
+        }
+        ssize_t received = frame_reader_recv(reader, socket);
+        if (received == 0 || (received < 0 && errno != EINTR)) {
+            return -1;
+        }
+    }
+}
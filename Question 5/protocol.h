@@ -0,0 +1,61 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "common.h"
+
+// Wire format
+// Every message travels as one length-prefixed frame:
+//
+//     frame = length:varint  version:u8  type:varint  payload
+//
+// `length` counts the bytes after itself, `type` is a MessageType and the payload
+// is the message text without its terminating NUL. Varints are unsigned LEB128:
+// 7 bits per byte, least significant group first, high bit set on all but the
+// last byte. A one-letter answer is a 4-byte frame instead of a 1028-byte Message.
+//
+// Frames are decoded into a Message, whose payload is always NUL-terminated, so a
+// payload may be at most BUFFER_SIZE - 1 bytes long.
+#define PROTOCOL_VERSION 1
+
+// Largest valid frame: the payload plus a worst-case header.
+#define MAX_FRAME_SIZE (BUFFER_SIZE + 16)
+
+// Encodes a frame carrying `payload_len` bytes of `payload` into `out`, which must
+// have room for MAX_FRAME_SIZE bytes. Returns the frame's size in bytes, or 0 if
+// the payload is longer than BUFFER_SIZE - 1 bytes.
+size_t encode_frame(uint8_t *out, MessageType type, const char *payload, size_t payload_len);
+
+// Encodes a message, whose payload is a NUL-terminated string.
+size_t encode_message(uint8_t *out, const Message *msg);
+
+// Reassembles frames from a byte stream that may deliver them in any number of
+// pieces: bytes are received into the buffer and complete frames taken off the
+// front. Since a valid frame always fits, a full buffer without a complete frame
+// in it means the peer is not speaking this protocol.
+typedef struct {
+    uint8_t data[MAX_FRAME_SIZE];
+    size_t start; // first byte not consumed yet
+    size_t len;   // end of the received bytes
+} FrameReader;
+
+// Receives whatever fits into the reader's free space with a single recv() call
+// and returns its result (0 at end of stream, -1 with errno set on error).
+ssize_t frame_reader_recv(FrameReader *reader, int socket);
+
+// Takes the next complete frame off the reader, decoding it into `msg`.
+// Returns 1 if a message was decoded, 0 if more bytes are needed, or -1 if the
+// stream is malformed or uses another protocol version.
+int frame_reader_next(FrameReader *reader, Message *msg);
+
+// Blocking helpers for the client: send a whole frame, or receive bytes until a
+// whole frame has arrived. Both return 0 on success and -1 on error or if the
+// connection was closed.
+int send_message(int socket, MessageType type, const char *payload);
+int recv_message(int socket, FrameReader *reader, Message *msg);
+
+#endif // PROTOCOL_H
@@ -1,260 +1,1211 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 
+#include "answer_log.h"
+#include "broadcast.h"
 #include "common.h"
+#include "exam_bank.h"
+#include "logger.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "session_registry.h"
 
-// Structure to hold client information
+#define DEFAULT_MAX_CLIENTS 10000
+#define DEFAULT_GRADING_WORKERS 2
+#define DEFAULT_QUESTIONS_FILE "questions.txt"
+#define DEFAULT_ROSTER_FILE "roster.txt"
+#define DEFAULT_ANSWER_LOG "answers.log"
+#define DEFAULT_SYNC_INTERVAL_MS 100
+#define DEFAULT_SYNC_KB 1024
+#define DEFAULT_STATS_SOCKET "server_stats.sock"
+#define MAX_EVENTS 256
+// A client that leaves this many messages or broadcasts unread is disconnected
+// instead of being buffered for without bound.
+#define MAX_QUEUED_BUFFERS 64
+// Frames addressed to single clients during one batch of events are encoded here
+// until the batch is flushed.
+#define FRAME_ARENA_SIZE (256 * 1024)
+
+typedef struct Reactor Reactor;
+
+// A piece of a connection's pending output. Broadcasts are queued by reference to
+// their SharedBuffer. A message to this client alone is encoded into the reactor's
+// frame arena (`buf` is NULL) and only copied into a buffer of its own if it is
+// still unsent when the batch of events that produced it is flushed.
 typedef struct {
+    SharedBuffer *buf;
+    const uint8_t *data;
+    size_t len;
+} OutChunk;
+
+// Where a connection is in the exam: it must authenticate before it is sent the
+// questions and may submit answers, and is done once it has answered them all.
+typedef enum {
+    CONN_AUTHENTICATING,
+    CONN_IN_EXAM,
+    CONN_FINISHED
+} ConnectionState;
+
+// Per-connection state machine. A connection belongs to the reactor that accepted
+// it, and only that reactor's thread reads or writes its fields.
+typedef struct Connection {
     int socket;
+    SessionHandle session; // this client's entry in the session registry
+    ConnectionState state;
     char username[USERNAME_SIZE];
-    bool authenticated;
+    Reactor *reactor;
+
+    // The bank the client sits the exam from, kept for the whole exam even if the
+    // server reloads its files meanwhile
+    ExamBank *bank;
+    size_t next_question; // the question the next answer is for
+    size_t graded;
+    size_t score;
+
+    // Sockets are non-blocking, so frames may arrive in any number of pieces.
+    FrameReader in;
+
+    // Output not sent yet: a ring of chunks, the first `out_offset` bytes of the
+    // oldest already sent. Everything queued during a batch of events goes out
+    // together with one sendmsg() when the batch is done, or when the socket
+    // becomes writable again if it did not take it all.
+    OutChunk out[MAX_QUEUED_BUFFERS];
+    unsigned out_head;
+    unsigned out_count;
+    size_t out_offset;
+    bool dirty; // on the reactor's list of connections to flush
+    struct Connection *next_dirty;
+
+    bool awaiting_roster; // authenticated, waiting for its first roster snapshot
+    bool failed; // a send failed or the client stopped reading
+    bool closed; // closed, freed once the current batch of events is handled
+    struct Connection *prev, *next; // the reactor's list of open connections, or of closed ones
+} Connection;
+
+// An answer waiting to be graded, or graded and waiting to be sent back. The job
+// names its connection by session handle, so if the client leaves before the
+// answer is graded the feedback is simply dropped.
+typedef struct GradingJob {
+    SessionHandle session;
+    Reactor *owner;
+    size_t question;
+    char username[USERNAME_SIZE]; // for the answer log, which outlives the connection
+    char expected[ANSWER_SIZE]; // normalized, copied so workers never touch the bank
+    char answer[ANSWER_SIZE];
+    bool correct;
+    uint64_t received_ns; // when the answer arrived, for the grading latency
+    struct GradingJob *next;
+} GradingJob;
+
+// One tick's change to the active students roster, queued on every reactor.
+typedef struct RosterUpdate {
+    SharedBuffer *delta;    // may be NULL
+    SharedBuffer *snapshot; // may be NULL
+    struct RosterUpdate *next;
+} RosterUpdate;
+
+// One event loop thread. Each reactor has its own listening socket bound to the
+// same port with SO_REUSEPORT, so the kernel spreads new connections across them,
+// and its own epoll instance watching the connections it accepted.
+struct Reactor {
+    int id;
+    int epoll_fd;
+    int listen_fd;
+    int wakeup_fd; // eventfd other threads write to when they have work for this reactor
     pthread_t thread_id;
-} ClientSession;
+    Connection *connections;
+    Connection *closed; // closed during the current batch of events
+    Connection *dirty;  // given output during the current batch of events
+    uint8_t *arena;     // FRAME_ARENA_SIZE bytes of frames queued this batch
+    size_t arena_used;
+    ExamBank *bank; // the bank new logins are checked against and examined on
+    GradingJob *spare_jobs; // recycled, so grading an answer doesn't allocate
+    ThreadMetrics *metrics; // written only by this reactor's thread
+
+    // Work handed over by other threads, announced through wakeup_fd
+    pthread_mutex_t inbox_mutex;
+    GradingJob *completed; // graded answers to send back, newest first
+    RosterUpdate *roster_head, *roster_tail;
+    ExamBank *reloaded_bank; // replaces `bank` when the files are reloaded
+};
+
+// Runtime settings, from the command line.
+int port = PORT;
+int max_clients = DEFAULT_MAX_CLIENTS;
+int num_reactors;
+int num_grading_workers = DEFAULT_GRADING_WORKERS;
+const char *questions_path = DEFAULT_QUESTIONS_FILE;
+const char *roster_path = DEFAULT_ROSTER_FILE;
+const char *answer_log_path = DEFAULT_ANSWER_LOG;
+int sync_interval_ms = DEFAULT_SYNC_INTERVAL_MS;
+int sync_kb = DEFAULT_SYNC_KB;
+const char *stats_path = DEFAULT_STATS_SOCKET;
+
+AnswerLog *answer_log;
+
+// Every connected client, whichever reactor serves it. Joins, leaves and roster
+// walks don't take a lock (see session_registry.h).
+SessionRegistry registry;
+
+Reactor *reactors;
+
+// Grading queue shared by the reactors (producers) and the grading workers.
+GradingJob *grading_head, *grading_tail;
+size_t grading_queue_length;
+pthread_mutex_t grading_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t grading_cond = PTHREAD_COND_INITIALIZER;
+bool grading_stopping; // set under grading_mutex at shutdown
+pthread_t *grading_workers;
+
+// Set at shutdown once the grading workers have stopped
+atomic_bool reactors_stopping;
 
-ClientSession clients[MAX_CLIENTS];
-pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER; // Mutex to protect access to the clients array and active_clients count
-int active_clients = 0;
+static void close_connection(Connection *conn);
 
-// Function to broadcast active students list to all connected clients
-// This function is responsible for informing all currently authenticated clients
-// about the list of other active and authenticated students. It acquires a mutex
-// to ensure thread-safe access to the shared `clients` array and `active_clients` count.
-void broadcast_active_students() {
-    char active_students_list[BUFFER_SIZE];
-    strcpy(active_students_list, "Active Students: ");
+// Wakes a reactor blocked in epoll_wait so it picks up work posted by another thread.
+static void wake_reactor(Reactor *r) {
+    uint64_t one = 1;
+    if (write(r->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        log_error("eventfd write: %s", strerror(errno));
+    }
+}
+
+// Sends queued output, gathering every pending chunk into a single sendmsg(),
+// until the queue is empty or the socket stops taking it. Returns false if the
+// connection has failed.
+static bool flush_output(Connection *conn) {
+    ThreadMetrics *metrics = conn->reactor->metrics;
 
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].socket != 0 && clients[i].authenticated) {
-            strcat(active_students_list, clients[i].username);
-            strcat(active_students_list, " ");
+    while (conn->out_count > 0) {
+        struct iovec iov[MAX_QUEUED_BUFFERS];
+        size_t total = 0;
+        for (unsigned i = 0; i < conn->out_count; i++) {
+            const OutChunk *chunk = &conn->out[(conn->out_head + i) % MAX_QUEUED_BUFFERS];
+            size_t skip = i == 0 ? conn->out_offset : 0;
+            iov[i].iov_base = (void *)(chunk->data + skip);
+            iov[i].iov_len = chunk->len - skip;
+            total += chunk->len - skip;
+        }
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = conn->out_count};
+        ssize_t sent = sendmsg(conn->socket, &msg, MSG_NOSIGNAL);
+        metrics_add(metrics, METRIC_SEND_CALLS, 1);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true; // EPOLLOUT will tell us when to carry on
+            }
+            conn->failed = true;
+            return false;
+        }
+        metrics_add(metrics, METRIC_BYTES_SENT, sent);
+
+        // Retire the chunks that went out completely
+        for (size_t left = (size_t)sent; left > 0;) {
+            OutChunk *chunk = &conn->out[conn->out_head];
+            size_t remaining = chunk->len - conn->out_offset;
+            if (left < remaining) {
+                conn->out_offset += left;
+                break;
+            }
+            left -= remaining;
+            shared_buffer_unref(chunk->buf);
+            conn->out_head = (conn->out_head + 1) % MAX_QUEUED_BUFFERS;
+            conn->out_count--;
+            conn->out_offset = 0;
+        }
+        if ((size_t)sent < total) {
+            return true; // the socket buffer is full; EPOLLOUT will say when it drains
         }
     }
-    pthread_mutex_unlock(&clients_mutex);
+    return true;
+}
 
-    Message msg;
-    msg.type = ACTIVE_STUDENTS_UPDATE;
-    strncpy(msg.payload, active_students_list, BUFFER_SIZE);
+// Copies the chunks still pointing into the frame arena into buffers of their
+// own, so the arena can be reused.
+static void keep_unsent(Connection *conn) {
+    for (unsigned i = 0; i < conn->out_count; i++) {
+        OutChunk *chunk = &conn->out[(conn->out_head + i) % MAX_QUEUED_BUFFERS];
+        if (chunk->buf != NULL) {
+            continue;
+        }
+        SharedBuffer *buf = shared_buffer_new(chunk->len);
+        if (buf == NULL) {
+            conn->failed = true;
+            return;
+        }
+        memcpy(buf->data, chunk->data, chunk->len);
+        chunk->buf = buf;
+        chunk->data = buf->data;
+    }
+}
 
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].socket != 0 && clients[i].authenticated) {
-            send(clients[i].socket, &msg, sizeof(Message), 0);
+// Sends the output queued on every connection during this batch of events, one
+// sendmsg() per connection however many messages and broadcasts it was given,
+// and empties the frame arena. Connections that fail are closed if
+// `close_failed`, and otherwise left on the list for the end of the batch.
+static void flush_connections(Reactor *r, bool close_failed) {
+    Connection *conn = r->dirty;
+    r->dirty = NULL;
+
+    while (conn != NULL) {
+        Connection *next = conn->next_dirty;
+        conn->dirty = false;
+        if (!conn->closed) {
+            if (!conn->failed && flush_output(conn) && conn->out_count > 0) {
+                metrics_add(r->metrics, METRIC_SENDS_DEFERRED, 1);
+                keep_unsent(conn);
+            }
+            if (conn->failed) {
+                if (close_failed) {
+                    close_connection(conn);
+                } else {
+                    conn->dirty = true;
+                    conn->next_dirty = r->dirty;
+                    r->dirty = conn;
+                }
+            }
         }
+        conn = next;
     }
-    pthread_mutex_unlock(&clients_mutex);
+    r->arena_used = 0;
 }
 
-// Function to handle each client connection
-void *handle_client(void *arg) {
-    ClientSession *client = (ClientSession *)arg;
-    Message msg;
-    ssize_t bytes_received;
-
-    printf("Client connected: Socket %d\n", client->socket);
-
-    // Authentication Loop
-    // This loop handles the initial authentication of a connecting client.
-    // It continuously receives messages until the client is successfully authenticated
-    // or disconnects. Unauthenticated clients are prevented from proceeding to the exam.
-    while (!client->authenticated) {
-        bytes_received = recv(client->socket, &msg, sizeof(Message), 0);
-        if (bytes_received <= 0) {
-            printf("Client disconnected during authentication: Socket %d\n", client->socket);
-            goto cleanup;
-        }
-
-        if (msg.type == AUTH_REQUEST) {
-            // Authentication check: In a real-world scenario, this would involve
-            // validating credentials against a secure database. For this simulation,
-            // we have hardcoded a few valid usernames (student1 to student4).
-            if (strcmp(msg.payload, "student1") == 0 || strcmp(msg.payload, "student2") == 0 ||
-                strcmp(msg.payload, "student3") == 0 || strcmp(msg.payload, "student4") == 0) {
-                client->authenticated = true;
-                strncpy(client->username, msg.payload, USERNAME_SIZE);
-                msg.type = AUTH_SUCCESS;
-                send(client->socket, &msg, sizeof(Message), 0);
-                printf("Client %s authenticated. Socket %d\n", client->username, client->socket);
-
-                // Concurrency: After successful authentication, the server increments
-                // the `active_clients` count and broadcasts the updated list to all clients.
-                // A mutex (`clients_mutex`) is used to protect `active_clients` and the
-                // `clients` array from race conditions during concurrent access.
-                pthread_mutex_lock(&clients_mutex);
-                active_clients++;
-                pthread_mutex_unlock(&clients_mutex);
-                broadcast_active_students();
+// Appends a chunk to a connection's output queue and marks the connection for
+// the end-of-batch flush. Adjacent frames in the arena share one chunk. A client
+// that lets more than MAX_QUEUED_BUFFERS chunks pile up is marked as failed.
+static void push_chunk(Connection *conn, SharedBuffer *buf, const uint8_t *data, size_t len) {
+    Reactor *r = conn->reactor;
 
-            } else {
-                msg.type = AUTH_FAILURE;
-                send(client->socket, &msg, sizeof(Message), 0);
-                printf("Authentication failed for user: %s. Socket %d\n", msg.payload, client->socket);
+    if (conn->out_count > 0 && buf == NULL) {
+        OutChunk *last = &conn->out[(conn->out_head + conn->out_count - 1) % MAX_QUEUED_BUFFERS];
+        if (last->buf == NULL && last->data + last->len == data) {
+            last->len += len;
+            return;
+        }
+    }
+    if (conn->out_count == MAX_QUEUED_BUFFERS) {
+        log_warn("Client %s is not reading its messages; disconnecting. Socket %d", conn->username, conn->socket);
+        metrics_add(r->metrics, METRIC_SLOW_CLIENTS_DROPPED, 1);
+        conn->failed = true;
+    } else {
+        if (conn->out_count == 0) {
+            conn->out_offset = 0;
+        }
+        conn->out[(conn->out_head + conn->out_count) % MAX_QUEUED_BUFFERS] =
+            (OutChunk){.buf = buf != NULL ? shared_buffer_ref(buf) : NULL, .data = data, .len = len};
+        conn->out_count++;
+        metrics_record(r->metrics, HISTOGRAM_OUTPUT_QUEUE_DEPTH, conn->out_count);
+    }
+    if (!conn->dirty) {
+        conn->dirty = true;
+        conn->next_dirty = r->dirty;
+        r->dirty = conn;
+    }
+}
+
+// Queues a shared buffer of frames on a connection by reference, without copying it.
+static void queue_buffer(Connection *conn, SharedBuffer *buf) {
+    if (conn->failed) {
+        return;
+    }
+    metrics_add(conn->reactor->metrics, METRIC_MESSAGES_QUEUED, 1);
+    push_chunk(conn, buf, buf->data, buf->len);
+}
+
+// Queues a message to a connection. It is encoded straight into the reactor's
+// frame arena and goes out with the rest of the connection's output when the
+// batch of events is flushed.
+static void queue_message(Connection *conn, const Message *msg) {
+    Reactor *r = conn->reactor;
+
+    if (conn->failed) {
+        return;
+    }
+    if (r->arena_used + MAX_FRAME_SIZE > FRAME_ARENA_SIZE) {
+        flush_connections(r, false); // callers may be walking the connection list
+    }
+    uint8_t *frame = r->arena + r->arena_used;
+    size_t len = encode_message(frame, msg);
+    r->arena_used += len;
+    metrics_add(r->metrics, METRIC_MESSAGES_QUEUED, 1);
+    push_chunk(conn, NULL, frame, len);
+}
+
+// Called on the broadcaster thread once per tick in which the roster changed:
+// queues the update on every reactor. The buffers are shared, not copied.
+static void post_roster_update(SharedBuffer *delta, SharedBuffer *snapshot) {
+    for (int i = 0; i < num_reactors; i++) {
+        Reactor *r = &reactors[i];
+        RosterUpdate *update = malloc(sizeof(RosterUpdate));
+        if (update == NULL) {
+            log_error("Out of memory: roster update lost");
+            continue;
+        }
+        update->delta = delta != NULL ? shared_buffer_ref(delta) : NULL;
+        update->snapshot = snapshot != NULL ? shared_buffer_ref(snapshot) : NULL;
+        update->next = NULL;
+
+        pthread_mutex_lock(&r->inbox_mutex);
+        if (r->roster_tail != NULL) {
+            r->roster_tail->next = update;
+        } else {
+            r->roster_head = update;
+        }
+        r->roster_tail = update;
+        pthread_mutex_unlock(&r->inbox_mutex);
+        wake_reactor(r);
+    }
+}
+
+// Fans the roster updates posted to a reactor out to its authenticated clients.
+// Each update is queued on every client by reference to the same buffer, and a
+// client that is slow to read only grows its own queue.
+static void send_roster_updates(Reactor *r) {
+    pthread_mutex_lock(&r->inbox_mutex);
+    RosterUpdate *update = r->roster_head;
+    r->roster_head = r->roster_tail = NULL;
+    pthread_mutex_unlock(&r->inbox_mutex);
+
+    while (update != NULL) {
+        Connection *next;
+        for (Connection *conn = r->connections; conn != NULL; conn = next) {
+            next = conn->next;
+            if (conn->state == CONN_AUTHENTICATING) {
+                continue;
             }
+            if (conn->awaiting_roster) {
+                // The snapshot covers every event up to this update; later ones
+                // arrive as deltas
+                if (update->snapshot == NULL) {
+                    continue;
+                }
+                queue_buffer(conn, update->snapshot);
+                conn->awaiting_roster = false;
+            } else if (update->delta != NULL) {
+                queue_buffer(conn, update->delta);
+            }
+            if (conn->failed) {
+                close_connection(conn);
+            }
+        }
+
+        RosterUpdate *done = update;
+        update = update->next;
+        shared_buffer_unref(done->delta);
+        shared_buffer_unref(done->snapshot);
+        free(done);
+    }
+}
+
+static void send_question(Connection *conn, size_t index) {
+    Message question_msg = {.type = QUESTION_DELIVERY};
+    strcpy(question_msg.payload, conn->bank->questions[index].text);
+    queue_message(conn, &question_msg);
+}
+
+// Authentication phase
+// Unauthenticated clients are prevented from proceeding to the exam: anything
+// but a valid AUTH_REQUEST is answered with AUTH_FAILURE.
+static void authenticate(Connection *conn, Message *msg) {
+    ThreadMetrics *metrics = conn->reactor->metrics;
+    if (msg->type != AUTH_REQUEST) {
+        msg->type = AUTH_FAILURE; // Deny access if not an auth request
+        metrics_add(metrics, METRIC_AUTH_FAILED, 1);
+        queue_message(conn, msg);
+        return;
+    }
+    // Authentication check: In a real-world scenario, this would involve
+    // validating credentials against a secure database. For this simulation,
+    // usernames are checked against the roster file.
+    if (!exam_bank_has_user(conn->reactor->bank, msg->payload)) {
+        log_warn("Authentication failed for user: %s. Socket %d", msg->payload, conn->socket);
+        metrics_add(metrics, METRIC_AUTH_FAILED, 1);
+        msg->type = AUTH_FAILURE;
+        queue_message(conn, msg);
+        return;
+    }
+
+    strncpy(conn->username, msg->payload, USERNAME_SIZE - 1);
+    conn->state = CONN_IN_EXAM;
+    conn->bank = exam_bank_ref(conn->reactor->bank);
+    registry_authenticate(&registry, conn->session, conn->username);
+
+    msg->type = AUTH_SUCCESS;
+    queue_message(conn, msg);
+    metrics_add(metrics, METRIC_AUTH_SUCCEEDED, 1);
+    log_info("Client %s authenticated. Socket %d", conn->username, conn->socket);
+    conn->awaiting_roster = true;
+    roster_joined(conn->username);
+
+    // Exam phase
+    // The server sends the questions of the bank one QUESTION_DELIVERY at a time,
+    // each once the answer to the previous one has been graded. A student who
+    // answered some questions before (even before a server restart, thanks to the
+    // answer log) carries on from the first one they have not answered.
+    size_t answered, score;
+    if (answer_log_progress(answer_log, conn->username, &answered, &score)) {
+        conn->next_question = conn->graded = answered;
+        conn->score = score;
+    }
+    if (conn->next_question < conn->bank->num_questions) {
+        send_question(conn, conn->next_question);
+    } else {
+        conn->state = CONN_FINISHED;
+        Message ended = {.type = EXAM_ENDED};
+        snprintf(ended.payload, BUFFER_SIZE, "Exam complete. Score: %zu/%zu", conn->score, conn->graded);
+        queue_message(conn, &ended);
+    }
+}
+
+// Hands an answer to the grading workers. The feedback, and the next question,
+// are sent once the owning reactor gets the graded job back.
+static void submit_answer(Connection *conn, const Message *msg, uint64_t received_ns) {
+    Reactor *r = conn->reactor;
+    log_debug("Answer received from %s: %s", conn->username, msg->payload);
+    metrics_add(r->metrics, METRIC_ANSWERS_SUBMITTED, 1);
+
+    GradingJob *job = r->spare_jobs;
+    if (job != NULL) {
+        r->spare_jobs = job->next;
+    } else if ((job = malloc(sizeof(GradingJob))) == NULL) {
+        conn->failed = true;
+        return;
+    }
+    job->session = conn->session;
+    job->owner = r;
+    job->question = conn->next_question;
+    strcpy(job->username, conn->username);
+    strcpy(job->expected, conn->bank->questions[conn->next_question].answer);
+    if (++conn->next_question == conn->bank->num_questions) {
+        conn->state = CONN_FINISHED; // every question answered
+    }
+    strncpy(job->answer, msg->payload, ANSWER_SIZE - 1);
+    job->answer[ANSWER_SIZE - 1] = '\0';
+    job->received_ns = received_ns;
+    job->next = NULL;
+
+    pthread_mutex_lock(&grading_mutex);
+    if (grading_tail != NULL) {
+        grading_tail->next = job;
+    } else {
+        grading_head = job;
+    }
+    grading_tail = job;
+    size_t waiting = grading_queue_length++;
+    pthread_cond_signal(&grading_cond);
+    pthread_mutex_unlock(&grading_mutex);
+    metrics_record(r->metrics, HISTOGRAM_GRADING_QUEUE_DEPTH, waiting);
+}
+
+// Dispatches one complete frame received from a client according to its state.
+static void handle_message(Connection *conn, Message *msg) {
+    ThreadMetrics *metrics = conn->reactor->metrics;
+    uint64_t received_ns = metrics_now_ns();
+    metrics_add(metrics, METRIC_FRAMES_RECEIVED, 1);
+
+    switch (conn->state) {
+    case CONN_AUTHENTICATING:
+        authenticate(conn, msg);
+        metrics_record(metrics, HISTOGRAM_AUTH_NS, metrics_now_ns() - received_ns);
+        break;
+    case CONN_IN_EXAM:
+        if (msg->type == ANSWER_SUBMISSION) {
+            submit_answer(conn, msg, received_ns);
         } else {
-            msg.type = AUTH_FAILURE; // Deny access if not an auth request
-            send(client->socket, &msg, sizeof(Message), 0);
+            // If authenticated but sending wrong message type, ignore it
+            log_warn("Invalid message type from authenticated client %s: %d", conn->username, msg->type);
         }
+        break;
+    case CONN_FINISHED:
+        log_warn("Message from %s after finishing the exam ignored: %d", conn->username, msg->type);
+        break;
     }
+}
 
-    // Exam Loop
-    // After successful authentication, the client enters the exam session.
-    // The server sends a question and then enters a loop to receive answers
-    // and provide real-time feedback.
-    // Message Exchange: The server sends a QUESTION_DELIVERY message with the
-    // exam question. It then waits for an ANSWER_SUBMISSION message from the client.
-    // Upon receiving an answer, it checks for correctness and sends back
-    // FEEDBACK_CORRECT or FEEDBACK_INCORRECT messages.
-    // For simplicity, a single question is used in this example.
-    Message question_msg;
-    question_msg.type = QUESTION_DELIVERY;
-    strncpy(question_msg.payload, "What is 2+2? (a)3 (b)4 (c)5", QUESTION_SIZE);
-    send(client->socket, &question_msg, sizeof(Message), 0);
+// Reads everything available on a connection, handling each frame as soon as it
+// is complete. Edge-triggered epoll only reports new data once, so this reads
+// until the socket would block. Returns false if the connection should be closed.
+static bool read_messages(Connection *conn) {
+    Message msg;
 
     while (true) {
-        bytes_received = recv(client->socket, &msg, sizeof(Message), 0);
-        if (bytes_received <= 0) {
-            printf("Client disconnected: %s (Socket %d)\n", client->username, client->socket);
-            goto cleanup;
-        }
-
-        if (client->authenticated) {
-            if (msg.type == ANSWER_SUBMISSION) {
-                printf("Answer received from %s: %s\n", client->username, msg.payload);
-                if (strcmp(msg.payload, "b") == 0) { // Correct answer
-                    msg.type = FEEDBACK_CORRECT;
-                    strncpy(msg.payload, "Server: Correct!", BUFFER_SIZE);
-                } else {
-                    msg.type = FEEDBACK_INCORRECT;
-                    strncpy(msg.payload, "Server: Incorrect.", BUFFER_SIZE);
-                }
-                send(client->socket, &msg, sizeof(Message), 0);
+        int status;
+        while ((status = frame_reader_next(&conn->in, &msg)) > 0) {
+            handle_message(conn, &msg);
+            if (conn->failed) {
+                return false;
+            }
+        }
+        if (status < 0) {
+            log_warn("Malformed frame or unsupported protocol version from socket %d", conn->socket);
+            return false;
+        }
+
+        ssize_t received = frame_reader_recv(&conn->in, conn->socket);
+        if (received > 0) {
+            metrics_add(conn->reactor->metrics, METRIC_BYTES_RECEIVED, received);
+            continue;
+        } else if (received == 0) {
+            return false; // orderly shutdown by the client
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+// Closes a connection and releases its session. Grading jobs still in flight for
+// it hold the now stale session handle, so they no longer resolve to it. Later
+// events of the same epoll batch may still point at the connection, so it is only
+// freed once the batch has been handled.
+static void close_connection(Connection *conn) {
+    Reactor *r = conn->reactor;
+
+    if (conn->state != CONN_AUTHENTICATING) {
+        log_info("Client disconnected: %s (Socket %d)", conn->username, conn->socket);
+    } else {
+        log_info("Client disconnected during authentication: Socket %d", conn->socket);
+    }
+    metrics_add(r->metrics, METRIC_CONNECTIONS_CLOSED, 1);
+    close(conn->socket); // also removes it from the epoll set
+
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        r->connections = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+
+    if (registry_release(&registry, conn->session) == SESSION_AUTHENTICATED) {
+        roster_left(conn->username);
+    }
+
+    for (; conn->out_count > 0; conn->out_count--) {
+        shared_buffer_unref(conn->out[conn->out_head].buf);
+        conn->out_head = (conn->out_head + 1) % MAX_QUEUED_BUFFERS;
+    }
+    exam_bank_unref(conn->bank);
+    conn->bank = NULL;
+    conn->closed = true;
+    conn->next = r->closed;
+    r->closed = conn;
+}
+
+// Accepts every pending connection on a reactor's listening socket.
+static void accept_connections(Reactor *r) {
+    while (true) {
+        int new_socket = accept4(r->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (new_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_error("accept: %s", strerror(errno));
+            }
+            return;
+        }
+
+        Connection *conn = calloc(1, sizeof(Connection));
+        if (conn == NULL) {
+            log_error("Out of memory: connection refused");
+            close(new_socket);
+            continue;
+        }
+
+        conn->session = registry_claim(&registry, conn);
+        if (conn->session == SESSION_NONE) {
+            log_warn("Max clients reached. Rejecting new connection.");
+            metrics_add(r->metrics, METRIC_CONNECTIONS_REJECTED, 1);
+            // Using EXAM_ENDED to signify server full
+            static const char busy[] = "Server is full. Please try again later.";
+            uint8_t frame[MAX_FRAME_SIZE];
+            send(new_socket, frame, encode_frame(frame, EXAM_ENDED, busy, sizeof(busy) - 1), MSG_NOSIGNAL);
+            close(new_socket);
+            free(conn);
+            continue;
+        }
+        conn->socket = new_socket;
+        conn->state = CONN_AUTHENTICATING;
+        conn->reactor = r;
+
+        // Answers and feedback are tiny and latency-sensitive, so don't let Nagle hold them back
+        int one = 1;
+        setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = conn};
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, new_socket, &ev) < 0) {
+            log_error("epoll_ctl: %s", strerror(errno));
+            registry_release(&registry, conn->session);
+            close(new_socket);
+            free(conn);
+            continue;
+        }
+
+        conn->next = r->connections;
+        if (r->connections != NULL) {
+            r->connections->prev = conn;
+        }
+        r->connections = conn;
+        metrics_add(r->metrics, METRIC_CONNECTIONS_ACCEPTED, 1);
+        log_info("Client connected: Socket %d", new_socket);
+    }
+}
+
+// Sends back the answers graded by the workers since the reactor last looked,
+// followed by the next question, or by the score once every answer is graded.
+static void finish_grading(Reactor *r) {
+    pthread_mutex_lock(&r->inbox_mutex);
+    GradingJob *newest = r->completed;
+    r->completed = NULL;
+    pthread_mutex_unlock(&r->inbox_mutex);
+
+    // Reverse the list so feedback goes out in the order the answers were submitted
+    GradingJob *job = NULL;
+    while (newest != NULL) {
+        GradingJob *next = newest->next;
+        newest->next = job;
+        job = newest;
+        newest = next;
+    }
+
+    while (job != NULL) {
+        GradingJob *next = job->next;
+        answer_log_record(answer_log, job->username, job->question, job->answer, job->correct);
+        metrics_add(r->metrics, METRIC_ANSWERS_GRADED, 1);
+        metrics_add(r->metrics, METRIC_ANSWERS_CORRECT, job->correct);
+
+        // Only this thread releases the sessions of its connections, so a handle
+        // that still resolves here refers to a connection that is still open
+        Connection *conn = (Connection *)registry_owner(&registry, job->session);
+        if (conn != NULL) {
+            Message msg;
+            memset(&msg, 0, sizeof(msg));
+            if (job->correct) {
+                msg.type = FEEDBACK_CORRECT;
+                strncpy(msg.payload, "Server: Correct!", BUFFER_SIZE);
+                conn->score++;
             } else {
-                // If authenticated but sending wrong message type, ignore or send error
-                printf("Invalid message type from authenticated client %s: %d\n", client->username, msg.type);
+                msg.type = FEEDBACK_INCORRECT;
+                strncpy(msg.payload, "Server: Incorrect.", BUFFER_SIZE);
             }
-        } else {
-            // Should not happen if authentication loop works, but for safety
-            msg.type = AUTH_FAILURE;
-            strncpy(msg.payload, "You are not authenticated.", BUFFER_SIZE);
-            send(client->socket, &msg, sizeof(Message), 0);
-        }
-    }
-
-cleanup:
-    close(client->socket);
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].socket == client->socket) {
-            clients[i].socket = 0;
-            clients[i].authenticated = false;
-            memset(clients[i].username, 0, USERNAME_SIZE);
-            active_clients--;
+            queue_message(conn, &msg);
+            metrics_record(r->metrics, HISTOGRAM_GRADING_NS, metrics_now_ns() - job->received_ns);
+
+            conn->graded++;
+            if (job->question + 1 < conn->bank->num_questions) {
+                send_question(conn, job->question + 1);
+            } else if (conn->graded == conn->bank->num_questions) {
+                msg.type = EXAM_ENDED;
+                snprintf(msg.payload, BUFFER_SIZE, "Exam complete. Score: %zu/%zu", conn->score, conn->graded);
+                queue_message(conn, &msg);
+                log_info("Client %s finished the exam. Score: %zu/%zu", conn->username, conn->score, conn->graded);
+            }
+            if (conn->failed) {
+                close_connection(conn);
+            }
+        }
+        job->next = r->spare_jobs;
+        r->spare_jobs = job;
+        job = next;
+    }
+}
+
+// Starts examining new logins on a reloaded bank, if one has been posted.
+// Clients already in the exam keep the bank they started on.
+static void switch_bank(Reactor *r) {
+    pthread_mutex_lock(&r->inbox_mutex);
+    ExamBank *bank = r->reloaded_bank;
+    r->reloaded_bank = NULL;
+    pthread_mutex_unlock(&r->inbox_mutex);
+
+    if (bank != NULL) {
+        exam_bank_unref(r->bank);
+        r->bank = bank;
+    }
+}
+
+// Reloads the question bank and roster from their files and hands the new bank
+// to every reactor. A bank that fails to load leaves the current one in place.
+static void reload_exam(void) {
+    char error[256];
+    ExamBank *bank = exam_bank_load(questions_path, roster_path, error, sizeof(error));
+    if (bank == NULL) {
+        log_error("Reload failed, keeping the current exam: %s", error);
+        return;
+    }
+    log_info("Reloaded exam: %zu questions, %zu students", bank->num_questions, bank->num_users);
+
+    for (int i = 0; i < num_reactors; i++) {
+        Reactor *r = &reactors[i];
+        pthread_mutex_lock(&r->inbox_mutex);
+        ExamBank *superseded = r->reloaded_bank;
+        r->reloaded_bank = exam_bank_ref(bank);
+        pthread_mutex_unlock(&r->inbox_mutex);
+        exam_bank_unref(superseded);
+        wake_reactor(r);
+    }
+    exam_bank_unref(bank);
+}
+
+// Stops the grading workers, then the reactors. Answers still waiting to be
+// graded are dropped without feedback; every answer a worker graded reaches its
+// reactor, which records and acknowledges it before leaving its event loop.
+static void stop_server(void) {
+    pthread_mutex_lock(&grading_mutex);
+    grading_stopping = true;
+    pthread_cond_broadcast(&grading_cond);
+    pthread_mutex_unlock(&grading_mutex);
+    for (int i = 0; i < num_grading_workers; i++) {
+        pthread_join(grading_workers[i], NULL);
+    }
+
+    atomic_store(&reactors_stopping, true);
+    for (int i = 0; i < num_reactors; i++) {
+        wake_reactor(&reactors[i]);
+    }
+}
+
+// Signal thread
+// SIGHUP reloads the exam files, off the event loops. SIGINT and SIGTERM shut the
+// server down; main() commits every answer graded so far to the answer log once
+// the event loops have stopped.
+static void *handle_signals(void *arg) {
+    sigset_t *signals = (sigset_t *)arg;
+    int sig;
+
+    while (sigwait(signals, &sig) == 0) {
+        if (sig == SIGHUP) {
+            reload_exam();
+            continue;
+        }
+        log_info("Shutting down");
+        stop_server();
+        break;
+    }
+    return NULL;
+}
+
+// Grading worker
+// Takes answers off the grading queue, grades them and hands them back to the
+// reactor that owns the connection, which sends the feedback.
+static void *grading_worker(void *arg) {
+    (void)arg;
+    while (true) {
+        pthread_mutex_lock(&grading_mutex);
+        while (grading_head == NULL && !grading_stopping) {
+            pthread_cond_wait(&grading_cond, &grading_mutex);
+        }
+        if (grading_stopping) {
+            pthread_mutex_unlock(&grading_mutex);
             break;
         }
+        GradingJob *job = grading_head;
+        grading_head = job->next;
+        if (grading_head == NULL) {
+            grading_tail = NULL;
+        }
+        grading_queue_length--;
+        pthread_mutex_unlock(&grading_mutex);
+
+        job->correct = answer_is_correct(job->expected, job->answer);
+
+        Reactor *owner = job->owner;
+        pthread_mutex_lock(&owner->inbox_mutex);
+        job->next = owner->completed;
+        owner->completed = job;
+        pthread_mutex_unlock(&owner->inbox_mutex);
+        wake_reactor(owner);
     }
-    pthread_mutex_unlock(&clients_mutex);
-    broadcast_active_students();
-    free(client); // Free the dynamically allocated client session
-    pthread_exit(NULL);
+    return NULL;
 }
 
+// Event loop
+// Concurrency: each reactor thread waits on its own epoll instance and drives every
+// connection it accepted through the authentication and exam phases without
+// blocking. Sockets are edge-triggered, so each readiness event is handled by
+// reading or writing until the socket would block.
+static void *run_reactor(void *arg) {
+    Reactor *r = (Reactor *)arg;
+    struct epoll_event events[MAX_EVENTS];
 
-int main() {
-    int server_fd, new_socket;
-    struct sockaddr_in address;
-    int addrlen = sizeof(address);
+    while (true) {
+        int n = epoll_wait(r->epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("epoll_wait: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
 
-    // Initialize client sessions
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        clients[i].socket = 0;
-        clients[i].authenticated = false;
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            uint32_t flags = events[i].events;
+
+            if (ptr == &r->listen_fd) {
+                accept_connections(r);
+            } else if (ptr == &r->wakeup_fd) {
+                uint64_t count;
+                if (read(r->wakeup_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    log_error("eventfd read: %s", strerror(errno));
+                }
+                finish_grading(r);
+                send_roster_updates(r);
+                switch_bank(r);
+            } else {
+                Connection *conn = (Connection *)ptr;
+                if (conn->closed) {
+                    continue;
+                }
+                if ((flags & (EPOLLERR | EPOLLHUP)) || conn->failed) {
+                    close_connection(conn);
+                    continue;
+                }
+                if ((flags & EPOLLOUT) && !flush_output(conn)) {
+                    close_connection(conn);
+                    continue;
+                }
+                if ((flags & (EPOLLIN | EPOLLRDHUP)) && !read_messages(conn)) {
+                    close_connection(conn);
+                }
+            }
+        }
+
+        // At shutdown, send back whatever the grading workers finished before
+        // they stopped, then leave the loop
+        bool stopping = atomic_load(&reactors_stopping);
+        if (stopping) {
+            close(r->listen_fd);
+            finish_grading(r);
+        }
+
+        flush_connections(r, true);
+        while (r->closed != NULL) {
+            Connection *conn = r->closed;
+            r->closed = conn->next;
+            free(conn);
+        }
+        if (stopping) {
+            break;
+        }
     }
+    return NULL;
+}
 
-    // Create socket file descriptor
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+// Creates one reactor's listening socket. With SO_REUSEPORT every reactor binds
+// its own socket to the same port and the kernel load-balances incoming
+// connections between them, so there is no shared accept queue to contend on.
+static int open_listener(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
         perror("socket failed");
-        exit(EXIT_FAILURE);
+        return -1;
+    }
+
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("setsockopt");
+        close(fd);
+        return -1;
     }
 
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(port);
 
     // Bind the socket to the specified port
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         perror("bind failed");
-        exit(EXIT_FAILURE);
+        close(fd);
+        return -1;
     }
 
     // Listen for incoming connections
-    if (listen(server_fd, MAX_CLIENTS) < 0) {
+    if (listen(fd, SOMAXCONN) < 0) {
         perror("listen");
-        exit(EXIT_FAILURE);
+        close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    printf("Server listening on port %d\n", PORT);
+static int init_reactor(Reactor *r, int id, ExamBank *bank) {
+    r->id = id;
+    r->connections = NULL;
+    r->closed = NULL;
+    r->dirty = NULL;
+    r->arena = malloc(FRAME_ARENA_SIZE);
+    r->arena_used = 0;
+    r->bank = exam_bank_ref(bank);
+    r->spare_jobs = NULL;
+    r->reloaded_bank = NULL;
+    r->completed = NULL;
+    r->roster_head = r->roster_tail = NULL;
+    pthread_mutex_init(&r->inbox_mutex, NULL);
+    r->metrics = metrics_register();
 
-    // Main server loop to accept new client connections
-    // Concurrency: Each new client connection is handled in a separate thread.
-    // This allows the server to manage multiple students simultaneously without
-    // blocking the main thread from accepting new connections.
-    // A mutex is used to protect the `clients` array when adding new clients.
-    while (true) {
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-            perror("accept");
-            continue;
-        }
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    r->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    r->listen_fd = open_listener();
+    if (r->metrics == NULL || r->arena == NULL || r->epoll_fd < 0 || r->wakeup_fd < 0 || r->listen_fd < 0) {
+        return -1;
+    }
 
-        pthread_mutex_lock(&clients_mutex);
-        int client_idx = -1;
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].socket == 0) {
-                client_idx = i;
-                break;
-            }
+    // The listener and the wakeup eventfd are told apart from connections by
+    // pointing their epoll data at the reactor's own fields.
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.ptr = &r->listen_fd};
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->listen_fd, &ev) < 0) {
+        return -1;
+    }
+    ev.data.ptr = &r->wakeup_fd;
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wakeup_fd, &ev) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Makes sure the process may open a descriptor for every client it admits, plus
+// the listeners, epoll instances and eventfds.
+static void raise_file_limit(void) {
+    rlim_t needed = (rlim_t)max_clients + 3 * num_reactors + 64;
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur >= needed) {
+        return;
+    }
+    limit.rlim_cur = needed < limit.rlim_max ? needed : limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur < needed) {
+        fprintf(stderr, "Warning: open file limit is %llu, so fewer than %d clients may be able to connect\n",
+                (unsigned long long)limit.rlim_cur, max_clients);
+    }
+}
+
+// Values for the stats report that are not per-thread counters.
+static void add_gauges(FILE *out) {
+    pthread_mutex_lock(&grading_mutex);
+    size_t waiting = grading_queue_length;
+    pthread_mutex_unlock(&grading_mutex);
+
+    fprintf(out, "connections_open %llu\n", (unsigned long long)(metrics_total(METRIC_CONNECTIONS_ACCEPTED) -
+                                                                 metrics_total(METRIC_CONNECTIONS_CLOSED)));
+    fprintf(out, "students_authenticated %u\n", atomic_load(&registry.authenticated));
+    fprintf(out, "grading_queue_length %zu\n", waiting);
+    fprintf(out, "log_lines_dropped %llu\n", logger_dropped());
+}
+
+static int parse_count(const char *arg, int min, int max, int *out) {
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || *end != '\0' || value < min || value > max) {
+        return -1;
+    }
+    *out = (int)value;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-c max_clients] [-t reactor_threads] [-w grading_workers]\n"
+            "          [-q questions_file] [-r roster_file] [-l answer_log] [-i sync_ms] [-s sync_kb]\n"
+            "          [-m stats_socket] [-v log_level]\n"
+            "  -p  TCP port to listen on (default %d)\n"
+            "  -c  maximum number of connected clients (default %d)\n"
+            "  -t  number of event loop threads (default: one per CPU)\n"
+            "  -w  number of grading worker threads (default %d)\n"
+            "  -q  question bank, one \"question | answer\" per line (default %s)\n"
+            "  -r  roster, one username per line (default %s)\n"
+            "  -l  append-only log of graded answers, replayed at startup (default %s)\n"
+            "  -i  commit the answer log at least every this many milliseconds (default %d)\n"
+            "  -s  or as soon as this many KiB are waiting (default %d)\n"
+            "  -m  Unix socket serving a stats report to each connection, \"\" for none (default %s)\n"
+            "  -v  least severe messages logged: debug, info, warn or error (default info)\n"
+            "Send SIGHUP to reload the question bank and roster without dropping connections.\n",
+            prog, PORT, DEFAULT_MAX_CLIENTS, DEFAULT_GRADING_WORKERS, DEFAULT_QUESTIONS_FILE, DEFAULT_ROSTER_FILE,
+            DEFAULT_ANSWER_LOG, DEFAULT_SYNC_INTERVAL_MS, DEFAULT_SYNC_KB, DEFAULT_STATS_SOCKET);
+}
+
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_reactors = cpus > 0 ? (int)cpus : 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:t:w:q:r:l:i:s:m:v:h")) != -1) {
+        int ok = 0;
+        switch (opt) {
+        case 'q':
+            questions_path = optarg;
+            break;
+        case 'r':
+            roster_path = optarg;
+            break;
+        case 'l':
+            answer_log_path = optarg;
+            break;
+        case 'm':
+            stats_path = optarg;
+            break;
+        case 'v':
+            ok = log_level_parse(optarg, &log_level) ? 0 : -1;
+            break;
+        case 'i':
+            ok = parse_count(optarg, 1, 60000, &sync_interval_ms);
+            break;
+        case 's':
+            ok = parse_count(optarg, 1, 1024 * 1024, &sync_kb);
+            break;
+        case 'p':
+            ok = parse_count(optarg, 1, 65535, &port);
+            break;
+        case 'c':
+            ok = parse_count(optarg, 1, 10000000, &max_clients);
+            break;
+        case 't':
+            ok = parse_count(optarg, 1, 1024, &num_reactors);
+            break;
+        case 'w':
+            ok = parse_count(optarg, 1, 1024, &num_grading_workers);
+            break;
+        default:
+            ok = -1;
+            break;
+        }
+        if (ok < 0) {
+            usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
         }
+    }
 
-        if (client_idx == -1) {
-            printf("Max clients reached. Rejecting new connection.\n");
-            Message busy_msg;
-            busy_msg.type = EXAM_ENDED; // Using EXAM_ENDED to signify server full
-            strncpy(busy_msg.payload, "Server is full. Please try again later.", BUFFER_SIZE);
-            send(new_socket, &busy_msg, sizeof(Message), 0);
-            close(new_socket);
-            pthread_mutex_unlock(&clients_mutex);
-            continue;
+    signal(SIGPIPE, SIG_IGN); // a client vanishing mid-send must not kill the server
+    raise_file_limit();
+
+    char error[256];
+    ExamBank *bank = exam_bank_load(questions_path, roster_path, error, sizeof(error));
+    if (bank == NULL) {
+        fprintf(stderr, "Cannot load the exam: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    // SIGHUP, SIGINT and SIGTERM are blocked in every thread (they inherit this
+    // mask, so this comes before any thread is started) and taken synchronously by
+    // the signal thread instead
+    static sigset_t handled_signals;
+    sigemptyset(&handled_signals);
+    sigaddset(&handled_signals, SIGHUP);
+    sigaddset(&handled_signals, SIGINT);
+    sigaddset(&handled_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &handled_signals, NULL);
+
+    // From here on nothing but startup failures writes to stdout synchronously
+    if (logger_start(STDOUT_FILENO) < 0) {
+        perror("logger setup failed");
+        exit(EXIT_FAILURE);
+    }
+    atexit(logger_stop);
+
+    answer_log = answer_log_open(answer_log_path, sync_interval_ms, (size_t)sync_kb * 1024, error, sizeof(error));
+    if (answer_log == NULL) {
+        fprintf(stderr, "Cannot open the answer log: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+
+    // Initialize client sessions
+    reactors = calloc(num_reactors, sizeof(Reactor));
+    if (registry_init(&registry, (uint32_t)max_clients) < 0 || reactors == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < num_reactors; i++) {
+        if (init_reactor(&reactors[i], i, bank) < 0) {
+            perror("reactor setup failed");
+            exit(EXIT_FAILURE);
         }
+    }
+
+    if (stats_path[0] != '\0' && metrics_serve(stats_path, add_gauges) < 0) {
+        perror("stats socket setup failed");
+        exit(EXIT_FAILURE);
+    }
 
-        // Concurrency: Dynamically allocate a ClientSession for the new client
-        // and pass it to the `handle_client` thread. The thread is detached
-        // so its resources are automatically reclaimed upon termination.
-        ClientSession *new_client = (ClientSession *)malloc(sizeof(ClientSession));
-        new_client->socket = new_socket;
-        new_client->authenticated = false;
-        memset(new_client->username, 0, USERNAME_SIZE);
-        clients[client_idx] = *new_client; // Copy the new_client data into the array
+    log_info("Loaded exam: %zu questions, %zu students", bank->num_questions, bank->num_users);
+    exam_bank_unref(bank); // the reactors hold their own references
 
-        if (pthread_create(&clients[client_idx].thread_id, NULL, handle_client, (void *)&clients[client_idx]) != 0) {
+    if (roster_start(post_roster_update) < 0) {
+        perror("broadcaster setup failed");
+        exit(EXIT_FAILURE);
+    }
+
+    grading_workers = calloc(num_grading_workers, sizeof(pthread_t));
+    if (grading_workers == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < num_grading_workers; i++) {
+        if (pthread_create(&grading_workers[i], NULL, grading_worker, NULL) != 0) {
             perror("pthread_create failed");
-            // If thread creation fails, clean up the client slot
-            clients[client_idx].socket = 0;
-            free(new_client);
-            close(new_socket);
-        } else {
-            // Detach the thread so its resources are automatically released when it terminates
-            pthread_detach(clients[client_idx].thread_id);
+            exit(EXIT_FAILURE);
         }
+    }
 
-        pthread_mutex_unlock(&clients_mutex);
+    // Started once the grading workers exist, since shutting down joins them.
+    // Signals that arrive before then stay pending.
+    pthread_t signal_thread;
+    if (pthread_create(&signal_thread, NULL, handle_signals, &handled_signals) != 0) {
+        perror("pthread_create failed");
+        exit(EXIT_FAILURE);
     }
+    pthread_detach(signal_thread);
 
-    close(server_fd);
-    return 0;
+    log_info("Server listening on port %d (%d event loops, %d grading workers, up to %d clients)", port,
+             num_reactors, num_grading_workers, max_clients);
+
+    // Concurrency: a fixed number of event loop threads serve every client between
+    // them, instead of one thread per client, so the number of students is limited
+    // by max_clients and file descriptors rather than by threads.
+    for (int i = 1; i < num_reactors; i++) {
+        if (pthread_create(&reactors[i].thread_id, NULL, run_reactor, &reactors[i]) != 0) {
+            perror("pthread_create failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    reactors[0].thread_id = pthread_self();
+    run_reactor(&reactors[0]);
+
+    // Shutting down: once every event loop has stopped nothing records answers,
+    // so closing the log commits every one that was acknowledged
+    for (int i = 1; i < num_reactors; i++) {
+        pthread_join(reactors[i].thread_id, NULL);
+    }
+    answer_log_close(answer_log);
+    if (stats_path[0] != '\0') {
+        unlink(stats_path);
+    }
+    return 0; // the logger is flushed at exit
 }
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "session_registry.h"
+
+#define NO_SLOT UINT32_MAX
+
+static uint32_t slot_of(SessionHandle handle) {
+    return (uint32_t)handle;
+}
+
+static uint32_t generation_of(SessionHandle handle) {
+    return (uint32_t)(handle >> 32);
+}
+
+// Seqlock writer side: readers that see an odd sequence, or a different sequence
+// after copying the slot, know they raced with the write and retry.
+static void begin_write(Session *s) {
+    uint32_t sequence = atomic_load_explicit(&s->sequence, memory_order_relaxed);
+    atomic_store_explicit(&s->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void end_write(Session *s) {
+    uint32_t sequence = atomic_load_explicit(&s->sequence, memory_order_relaxed);
+    atomic_store_explicit(&s->sequence, sequence + 1, memory_order_release);
+}
+
+static void push_free(SessionRegistry *reg, uint32_t slot) {
+    uint64_t head = atomic_load_explicit(&reg->free_head, memory_order_relaxed);
+    uint64_t new_head;
+    do {
+        atomic_store_explicit(&reg->slots[slot].next_free, (uint32_t)head, memory_order_relaxed);
+        new_head = ((head >> 32) + 1) << 32 | slot;
+    } while (!atomic_compare_exchange_weak_explicit(&reg->free_head, &head, new_head, memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+static uint32_t pop_free(SessionRegistry *reg) {
+    uint64_t head = atomic_load_explicit(&reg->free_head, memory_order_acquire);
+    uint64_t new_head;
+    do {
+        uint32_t slot = (uint32_t)head;
+        if (slot == NO_SLOT) {
+            return NO_SLOT;
+        }
+        // May read a stale link if another thread pops `slot` first, but then the
+        // tag has moved on and the compare-and-swap fails
+        uint32_t next = atomic_load_explicit(&reg->slots[slot].next_free, memory_order_relaxed);
+        new_head = ((head >> 32) + 1) << 32 | next;
+    } while (!atomic_compare_exchange_weak_explicit(&reg->free_head, &head, new_head, memory_order_acquire,
+                                                    memory_order_acquire));
+    return (uint32_t)head;
+}
+
+int registry_init(SessionRegistry *reg, uint32_t capacity) {
+    reg->slots = aligned_alloc(alignof(Session), (size_t)capacity * sizeof(Session));
+    if (reg->slots == NULL) {
+        return -1;
+    }
+    memset(reg->slots, 0, (size_t)capacity * sizeof(Session));
+    reg->capacity = capacity;
+
+    // Link every slot in index order, so the lowest free slot is handed out first
+    // and the sessions in use stay packed below the high-water mark
+    for (uint32_t i = 0; i < capacity; i++) {
+        Session *s = &reg->slots[i];
+        atomic_init(&s->sequence, 0);
+        atomic_init(&s->generation, 1);
+        atomic_init(&s->next_free, i + 1 < capacity ? i + 1 : NO_SLOT);
+        atomic_init(&s->state, SESSION_FREE);
+    }
+    atomic_init(&reg->free_head, capacity > 0 ? 0 : NO_SLOT);
+    atomic_init(&reg->high_water, 0);
+    atomic_init(&reg->authenticated, 0);
+    return 0;
+}
+
+SessionHandle registry_claim(SessionRegistry *reg, void *owner) {
+    uint32_t slot = pop_free(reg);
+    if (slot == NO_SLOT) {
+        return SESSION_NONE;
+    }
+    Session *s = &reg->slots[slot];
+
+    begin_write(s);
+    s->owner = owner;
+    s->username[0] = '\0';
+    atomic_store_explicit(&s->state, SESSION_CONNECTED, memory_order_relaxed);
+    end_write(s);
+
+    uint32_t high_water = atomic_load_explicit(&reg->high_water, memory_order_relaxed);
+    while (high_water <= slot && !atomic_compare_exchange_weak_explicit(&reg->high_water, &high_water, slot + 1,
+                                                                       memory_order_release, memory_order_relaxed)) {
+    }
+
+    uint32_t generation = atomic_load_explicit(&s->generation, memory_order_relaxed);
+    return (SessionHandle)generation << 32 | slot;
+}
+
+void registry_authenticate(SessionRegistry *reg, SessionHandle handle, const char *username) {
+    Session *s = &reg->slots[slot_of(handle)];
+
+    begin_write(s);
+    strncpy(s->username, username, USERNAME_SIZE - 1);
+    s->username[USERNAME_SIZE - 1] = '\0';
+    atomic_store_explicit(&s->state, SESSION_AUTHENTICATED, memory_order_relaxed);
+    end_write(s);
+    atomic_fetch_add_explicit(&reg->authenticated, 1, memory_order_relaxed);
+}
+
+SessionState registry_release(SessionRegistry *reg, SessionHandle handle) {
+    uint32_t slot = slot_of(handle);
+    if (handle == SESSION_NONE || slot >= reg->capacity) {
+        return SESSION_FREE;
+    }
+    Session *s = &reg->slots[slot];
+    if (atomic_load_explicit(&s->generation, memory_order_relaxed) != generation_of(handle)) {
+        return SESSION_FREE;
+    }
+    SessionState state = (SessionState)atomic_load_explicit(&s->state, memory_order_relaxed);
+
+    begin_write(s);
+    s->owner = NULL;
+    memset(s->username, 0, USERNAME_SIZE);
+    atomic_store_explicit(&s->state, SESSION_FREE, memory_order_relaxed);
+    uint32_t generation = generation_of(handle) + 1;
+    atomic_store_explicit(&s->generation, generation != 0 ? generation : 1, memory_order_relaxed);
+    end_write(s);
+
+    if (state == SESSION_AUTHENTICATED) {
+        atomic_fetch_sub_explicit(&reg->authenticated, 1, memory_order_relaxed);
+    }
+    push_free(reg, slot);
+    return state;
+}
+
+void *registry_owner(SessionRegistry *reg, SessionHandle handle) {
+    uint32_t slot = slot_of(handle);
+    if (handle == SESSION_NONE || slot >= reg->capacity) {
+        return NULL;
+    }
+    Session *s = &reg->slots[slot];
+    if (atomic_load_explicit(&s->generation, memory_order_acquire) != generation_of(handle) ||
+        atomic_load_explicit(&s->state, memory_order_relaxed) == SESSION_FREE) {
+        return NULL;
+    }
+    return s->owner;
+}
+
+bool registry_for_each_authenticated(SessionRegistry *reg, bool (*visit)(const char *username, void *ctx), void *ctx) {
+    uint32_t high_water = atomic_load_explicit(&reg->high_water, memory_order_acquire);
+
+    for (uint32_t i = 0; i < high_water; i++) {
+        Session *s = &reg->slots[i];
+        char username[USERNAME_SIZE];
+        uint32_t before, after;
+        int state;
+
+        // Seqlock reader side: copy, then check that no write overlapped the copy
+        do {
+            before = atomic_load_explicit(&s->sequence, memory_order_acquire);
+            if (before & 1) {
+                continue; // a write is in progress
+            }
+            state = atomic_load_explicit(&s->state, memory_order_relaxed);
+            if (state == SESSION_AUTHENTICATED) {
+                memcpy(username, s->username, USERNAME_SIZE);
+            }
+            atomic_thread_fence(memory_order_acquire);
+            after = atomic_load_explicit(&s->sequence, memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        if (state == SESSION_AUTHENTICATED) {
+            username[USERNAME_SIZE - 1] = '\0';
+            if (!visit(username, ctx)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef SESSION_REGISTRY_H
+#define SESSION_REGISTRY_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Concurrent table of client sessions, shared by every event loop thread without
+// a lock:
+// - Slots are allocated in O(1) from a lock-free free-list (a Treiber stack whose
+//   head carries a tag, so a slot freed and reused between a thread's load and its
+//   compare-and-swap cannot corrupt the list).
+// - A session is named by a handle holding its slot index and the slot's
+//   generation. The generation changes every time the slot is released, so a
+//   handle kept after its client left never refers to the slot's next occupant.
+// - Only the thread that claimed a slot writes it. Readers iterate the table
+//   concurrently through a per-slot sequence counter (a seqlock): they copy a slot
+//   and retry if a write overlapped, so they never block writers or each other.
+
+typedef uint64_t SessionHandle;
+#define SESSION_NONE ((SessionHandle)0) // generations start at 1, so no live session has this handle
+
+typedef enum {
+    SESSION_FREE,
+    SESSION_CONNECTED,    // connected, not authenticated yet
+    SESSION_AUTHENTICATED
+} SessionState;
+
+// Own cache line per slot, so threads updating neighbouring sessions don't contend
+typedef struct {
+    alignas(64) _Atomic uint32_t sequence; // odd while the slot is being written
+    _Atomic uint32_t generation;
+    _Atomic uint32_t next_free;
+    _Atomic int state;
+    void *owner;
+    char username[USERNAME_SIZE];
+} Session;
+
+typedef struct {
+    Session *slots;
+    uint32_t capacity;
+    _Atomic uint64_t free_head;     // tag << 32 | index of the first free slot
+    _Atomic uint32_t high_water;    // no slot at or above this index has ever been used
+    _Atomic uint32_t authenticated; // number of authenticated sessions
+} SessionRegistry;
+
+// Allocates a registry for `capacity` sessions. Returns -1 if out of memory, 0 otherwise.
+int registry_init(SessionRegistry *reg, uint32_t capacity);
+
+// Claims a free slot for a new connection, recording `owner` (the caller's
+// connection object) in it. Returns SESSION_NONE if every slot is in use.
+SessionHandle registry_claim(SessionRegistry *reg, void *owner);
+
+// Marks a session authenticated as `username`. Only the claiming thread may call this.
+void registry_authenticate(SessionRegistry *reg, SessionHandle handle, const char *username);
+
+// Frees a session's slot for reuse and invalidates its handle. Only the claiming
+// thread may call this. Returns the state the session was in, or SESSION_FREE if
+// the handle was already stale.
+SessionState registry_release(SessionRegistry *reg, SessionHandle handle);
+
+// Returns the owner recorded by registry_claim() if the handle is still live, or
+// NULL if the session has been released. Only reliable on the claiming thread,
+// since it is the only one that can release the session.
+void *registry_owner(SessionRegistry *reg, SessionHandle handle);
+
+// Calls `visit` with the username of every authenticated session, from any thread
+// and without blocking writers. Sessions that authenticate or leave during the
+// walk may or may not be visited. Stops early, returning false, if `visit` does.
+bool registry_for_each_authenticated(SessionRegistry *reg, bool (*visit)(const char *username, void *ctx), void *ctx);
+
+#endif // SESSION_REGISTRY_H